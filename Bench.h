@@ -0,0 +1,744 @@
+/*
+ * Microbenchmarks, run with the "bench" console command.
+ *
+ * The portable cases (math, heap, range filter, motion detector, ULP echo
+ * loops) also build on the host with tools/bench_host.cpp, so the numbers of
+ * both can be tracked side by side.
+ * The device cases (NVS, LCD, ultrasonic, camera, TLS) are only built for
+ * the board. Results are printed as one JSON object.
+ *
+ * Needs JsonWriter.h, GeoMath.h, RangeFilter.h, MotionDetect.h and
+ * UlpRanging.h to be included first. Benchmarks block the main loop while
+ * they run.
+ */
+
+#include <stdlib.h>
+
+#ifdef ARDUINO
+  #include <Preferences.h>
+  #include <WiFiClientSecure.h>
+  #include "esp_timer.h"
+  static inline uint64_t bench_now_ns() { return (uint64_t)esp_timer_get_time() * 1000; }
+#else
+  #include <chrono>
+  static inline uint64_t bench_now_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch()).count();
+  }
+#endif
+
+#define BENCH_CASES_MAX  32
+#define BENCH_COUNTS_MAX 4
+
+// A benchmark: fn runs the operation n times; it is timed in reps batches of batch operations
+struct BenchCase {
+  const char* name;
+  bool (*setup)(void* ctx);     // Optional, not timed; false skips the case
+  void (*fn)(void* ctx, uint32_t n);
+  void (*teardown)(void* ctx);  // Optional, not timed
+  void*    ctx;
+  uint32_t batch;
+  uint32_t reps;
+};
+
+static BenchCase benchCases[BENCH_CASES_MAX];
+static int       benchCaseCount = 0;
+static uint32_t  benchBytes     = 0;     // Set by a case to report the bytes handled per operation
+static const char* benchError   = NULL;  // Set by setup() to explain a skipped case
+static const char* benchCountNames[BENCH_COUNTS_MAX];  // Extra results of a case, e.g. how well it did
+static uint32_t    benchCounts[BENCH_COUNTS_MAX];
+static int         benchCountCount = 0;
+
+// Function to report an extra result of the running case, from setup() or teardown()
+void bench_count(const char* name, uint32_t value) {
+  if (benchCountCount < BENCH_COUNTS_MAX) {
+    benchCountNames[benchCountCount] = name;
+    benchCounts[benchCountCount++]   = value;
+  }
+}
+
+// Function to add a benchmark
+void bench_add(const char* name, void (*fn)(void*, uint32_t), uint32_t batch, uint32_t reps,
+               void* ctx = NULL, bool (*setup)(void*) = NULL, void (*teardown)(void*) = NULL)
+{
+  if (benchCaseCount < BENCH_CASES_MAX) {
+    BenchCase& bc = benchCases[benchCaseCount++];
+    bc.name     = name;
+    bc.setup    = setup;
+    bc.fn       = fn;
+    bc.teardown = teardown;
+    bc.ctx      = ctx;
+    bc.batch    = batch;
+    bc.reps     = reps;
+  }
+}
+
+// Function to run one benchmark and write its result
+static
+void bench_run_case(const BenchCase& bc, JsonWriter& json) {
+  json.beginObject().field("name", bc.name);
+
+  benchBytes = 0;
+  benchError = NULL;
+  benchCountCount = 0;
+  if (bc.setup && !bc.setup(bc.ctx)) {
+    json.field("error", benchError ? benchError : "setup failed").endObject();
+    return;
+  }
+
+  bc.fn(bc.ctx, 1);  // Warm up caches and lazy initialization
+
+  uint64_t total = 0, best = UINT64_MAX, worst = 0;
+  for (uint32_t r = 0; r < bc.reps; r++) {
+    const uint64_t t = bench_now_ns();
+    bc.fn(bc.ctx, bc.batch);
+    const uint64_t dt = bench_now_ns() - t;
+    total += dt;
+    if (dt < best)  { best = dt; }
+    if (dt > worst) { worst = dt; }
+  }
+
+  if (bc.teardown) {
+    bc.teardown(bc.ctx);
+  }
+
+  json.field("n",       (unsigned long)(bc.batch * bc.reps))
+      .field("mean_ns", (unsigned long long)(total / ((uint64_t)bc.batch * bc.reps)))
+      .field("min_ns",  (unsigned long long)(best / bc.batch))
+      .field("max_ns",  (unsigned long long)(worst / bc.batch));
+  if (benchBytes) {
+    json.field("bytes", (unsigned long)benchBytes);
+  }
+  for (int i = 0; i < benchCountCount; i++) {
+    json.field(benchCountNames[i], (unsigned long)benchCounts[i]);
+  }
+  json.endObject();
+}
+
+// Function to run the benchmarks whose name starts with the filter (all if NULL)
+void bench_run(const char* filter, const char* target, JsonWriter& json) {
+  json.beginObject()
+    .field("target", target)
+    .key("results").beginArray();
+  for (int i = 0; i < benchCaseCount; i++) {
+    if (!filter || 0 == strncmp(benchCases[i].name, filter, strlen(filter))) {
+      bench_run_case(benchCases[i], json);
+    }
+  }
+  json.endArray().endObject().raw("\n");
+}
+
+/*
+ * Portable cases
+ */
+
+static volatile double benchSink;  // Keeps results alive so the work is not optimized away
+
+static
+void bench_distance(void*, uint32_t n) {
+  for (uint32_t i = 0; i < n; i++) {
+    benchSink = calculateDistance(43.657426, -79.737513, 43.657426 + i * 1e-6, -79.737600);
+  }
+}
+
+static
+void bench_alloc(void* ctx, uint32_t n) {
+  const size_t size = (size_t)ctx;
+  for (uint32_t i = 0; i < n; i++) {
+    void* volatile p = malloc(size);
+    free(p);
+  }
+}
+
+// Allocate a mix of sizes, then free every other block before the rest (fragments the heap)
+static
+void bench_alloc_churn(void*, uint32_t n) {
+  static const size_t sizes[] = { 24, 256, 48, 1024, 96, 512, 16, 2048 };
+  const int count = sizeof(sizes) / sizeof(sizes[0]);
+  void* blocks[count];
+  for (uint32_t i = 0; i < n; i++) {
+    for (int b = 0; b < count; b++) {
+      blocks[b] = malloc(sizes[b]);
+    }
+    for (int b = 0; b < count; b += 2) {
+      free(blocks[b]);
+    }
+    for (int b = 1; b < count; b += 2) {
+      free(blocks[b]);
+    }
+  }
+}
+
+/*
+ * Range filter: replays a trace of raw echoes (us, 0 for no echo) through it.
+ *
+ * The built-in trace models what the sensor gives in a box: the far wall at
+ * ~35 cm with jitter, dropped echoes, stray short echoes (the false unlocks
+ * the filter is for), and a parcel held at ~6 cm for 40 pings in the middle.
+ * A trace recorded on the board with "range trace" can be replayed instead,
+ * on the host (tools/bench_host.cpp) or with bench_set_range_trace().
+ */
+
+#define BENCH_RANGE_TRACE   400
+#define BENCH_PARCEL_FROM   200  // Pings of the built-in trace with the parcel in front
+#define BENCH_PARCEL_TO     240
+
+static uint16_t        benchRangeModel[BENCH_RANGE_TRACE];
+static const uint16_t* benchRangeTrace = NULL;
+static size_t          benchRangeLen   = 0;
+static RangeFilter     benchRange;
+
+// Function to replay a recorded trace instead of the built-in one
+void bench_set_range_trace(const uint16_t* us, size_t len) {
+  benchRangeTrace = us;
+  benchRangeLen   = len;
+}
+
+// Function to build the built-in trace, the same every time
+static
+void bench_range_build() {
+  uint32_t r = 2463534242;
+  for (int i = 0; i < BENCH_RANGE_TRACE; i++) {
+    r ^= r << 13;  // xorshift32
+    r ^= r >> 17;
+    r ^= r << 5;
+    const bool parcel = (i >= BENCH_PARCEL_FROM && i < BENCH_PARCEL_TO);
+    float cm = (parcel ? 6 : 35) + ((int)(r % 21) - 10) / 10.0f;  // +-1 cm of jitter
+    if (r % 100 < 4) {
+      cm = 0;                   // Dropped echo
+    } else if (r % 100 < 7) {
+      cm = 3 + r % 5;           // Stray echo, close enough to unlock
+    }
+    benchRangeModel[i] = cm * 2 / 0.0343f;
+  }
+}
+
+// Function to replay the trace once, scoring the unlock decisions with and without the filter
+static
+bool bench_range_setup(void*) {
+  if (!benchRangeTrace) {
+    bench_range_build();
+    bench_set_range_trace(benchRangeModel, BENCH_RANGE_TRACE);
+  }
+  if (!benchRangeLen) {
+    benchError = "empty trace";
+    return false;
+  }
+  RangeFilter f = {};
+  uint32_t rawNear = 0, near = 0, wrong = 0, first = 0;
+  for (size_t i = 0; i < benchRangeLen; i++) {
+    const RangeSample s = range_filter_add(f, benchRangeTrace[i]);
+    if (benchRangeTrace[i] && s.rawCm < 10) {
+      rawNear++;
+    }
+    if (range_sample_closer(s, 10)) {
+      near++;
+      // With the parcel gone, the median lets go after half the window
+      if (benchRangeTrace == benchRangeModel &&
+          (i < BENCH_PARCEL_FROM || i >= BENCH_PARCEL_TO + RANGE_WINDOW / 2)) {
+        wrong++;
+      }
+      if (!first) {
+        first = i + 1;
+      }
+    }
+  }
+  bench_count("raw_near", rawNear);  // Readings that would have unlocked before
+  bench_count("near",     near);     // Samples that unlock now
+  if (benchRangeTrace == benchRangeModel) {
+    bench_count("false_near", wrong);
+    bench_count("latency", first > BENCH_PARCEL_FROM ? first - BENCH_PARCEL_FROM : 0);  // Pings to the first unlock
+  }
+  benchRange = {};
+  return true;
+}
+
+static
+void bench_range_filter(void*, uint32_t n) {
+  static size_t pos = 0;
+  for (uint32_t i = 0; i < n; i++) {
+    benchSink = range_filter_add(benchRange, benchRangeTrace[pos]).cm;
+    pos = (pos + 1 < benchRangeLen) ? pos + 1 : 0;
+  }
+}
+
+/*
+ * Motion detector: runs a frame sequence through it, one frame per operation.
+ *
+ * The built-in sequence models the view from the box at QQVGA: a textured
+ * wall with sensor noise and a slow brightness drift, a person walking
+ * across it, then a light switched on. A sequence recorded from the camera
+ * can be replayed instead, on the host (tools/bench_host.cpp) or with
+ * bench_set_motion_frames(). "motion_scalar" is the same detector one pixel
+ * at a time, to compare the kernel with, and to check it against.
+ */
+
+#define BENCH_MOTION_W       160
+#define BENCH_MOTION_H       120
+#define BENCH_MOTION_FRAMES  60
+#define BENCH_WALK_FROM      20   // Frames of the built-in sequence with the person in view
+#define BENCH_WALK_TO        40
+#define BENCH_LIGHT_AT       50   // Frame the light comes on
+
+static const uint8_t* benchMotionFrames   = NULL;
+static bool           benchMotionRecorded = false;
+static size_t         benchMotionCount    = 0;
+static uint16_t       benchMotionW        = BENCH_MOTION_W;
+static uint16_t       benchMotionH        = BENCH_MOTION_H;
+static uint8_t*       benchMotionBuf      = NULL;  // Frames of the built-in sequence, and the backgrounds
+static MotionDetector benchMotion;
+
+// Function to replay a recorded sequence (frames of width * height gray pixels) instead of the built-in one
+void bench_set_motion_frames(const uint8_t* frames, size_t count, uint16_t width, uint16_t height) {
+  benchMotionFrames   = frames;
+  benchMotionRecorded = true;
+  benchMotionCount    = count;
+  benchMotionW        = width;
+  benchMotionH        = height;
+}
+
+// Function to draw a frame of the built-in sequence, the same every time
+static
+void bench_motion_draw(uint8_t* out, int i) {
+  uint32_t r = 2463534242u + i * 7919;
+  const int drift = i / 4;  // Slow brightness change
+  const int light = (i >= BENCH_LIGHT_AT) ? 40 : 0;
+  for (int y = 0; y < BENCH_MOTION_H; y++) {
+    for (int x = 0; x < BENCH_MOTION_W; x++) {
+      r ^= r << 13;  // xorshift32
+      r ^= r >> 17;
+      r ^= r << 5;
+      int v = 60 + ((x * 7 + y * 13) & 63) + drift + light + (int)(r % 7) - 3;  // +-3 of noise
+      const int px = 10 + (i - BENCH_WALK_FROM) * 6;
+      if (i >= BENCH_WALK_FROM && i < BENCH_WALK_TO && x >= px && x < px + 24 && y >= 40 && y < 88) {
+        v = 20 + (int)(r % 7);  // The person, in dark clothes
+      }
+      out[y * BENCH_MOTION_W + x] = v;
+    }
+  }
+}
+
+// The detector one pixel at a time: the reference for the SWAR kernel
+static
+MotionResult bench_motion_scalar_detect(MotionDetector& m, const uint8_t* frame) {
+  MotionResult r = { 0, 0, 0 };
+  const int blocks = m.cols * m.rows;
+  if (m.frames++ == 0) {
+    memcpy(m.background, frame, (size_t)m.width * m.height);
+    r.flags = MOTION_WARMING;
+    return r;
+  }
+  for (int b = 0; b < blocks; b++) {
+    const int x0 = (b % m.cols) * MOTION_BLOCK, y0 = (b / m.cols) * MOTION_BLOCK;
+    uint32_t sad = 0;
+    for (int y = y0; y < y0 + MOTION_BLOCK; y++) {
+      for (int x = x0; x < x0 + MOTION_BLOCK; x++) {
+        sad += abs((int)frame[y * m.width + x] - (int)m.background[y * m.width + x]);
+      }
+    }
+    m.diff[b] = sad / (MOTION_BLOCK * MOTION_BLOCK);
+    r.changed += (m.diff[b] >= MOTION_BLOCK_DIFF);
+    r.peak = m.diff[b] > r.peak ? m.diff[b] : r.peak;
+  }
+  if (m.frames <= MOTION_WARMUP) {
+    r.flags = MOTION_WARMING;
+  } else if (r.changed * 100 > blocks * MOTION_GLOBAL_PCT) {
+    memcpy(m.background, frame, (size_t)m.width * m.height);
+    r.flags = MOTION_LIGHTING;
+    return r;
+  } else if (r.changed >= MOTION_MIN_BLOCKS) {
+    r.flags = MOTION_SEEN;
+  }
+  for (int b = 0; b < blocks; b++) {
+    const int x0 = (b % m.cols) * MOTION_BLOCK, y0 = (b / m.cols) * MOTION_BLOCK;
+    const int shift = (r.flags & MOTION_WARMING) ? 1 :
+                      m.diff[b] >= MOTION_BLOCK_DIFF ? 0 : MOTION_LEARN;
+    for (int y = y0; y < y0 + MOTION_BLOCK; y++) {
+      for (int x = x0; x < x0 + MOTION_BLOCK; x++) {
+        uint8_t& bg = m.background[y * m.width + x];
+        const int d = frame[y * m.width + x] - bg;
+        if (!shift) {
+          bg += (d > 0) - (d < 0);
+        } else {
+          bg += ((256 + d + (1 << shift >> 1)) >> shift) - (256 >> shift);  // Rounded, as floor of a positive
+        }
+      }
+    }
+  }
+  return r;
+}
+
+// Function to get frame i of the sequence; the built-in one is drawn into scratch
+static
+const uint8_t* bench_motion_frame(size_t i, uint8_t* scratch) {
+  if (benchMotionRecorded) {
+    return benchMotionFrames + (i % benchMotionCount) * benchMotionW * benchMotionH;
+  }
+  bench_motion_draw(scratch, i % BENCH_MOTION_FRAMES);
+  return scratch;
+}
+
+// Function to run the sequence once through both detectors, scoring the built-in one
+static
+bool bench_motion_setup(void*) {
+  const size_t pixels = (size_t)benchMotionW * benchMotionH;
+  if (!benchMotionRecorded) {
+    benchMotionCount = BENCH_MOTION_FRAMES;
+  }
+  if (!benchMotionCount) {
+    benchError = "empty sequence";
+    return false;
+  }
+  benchMotionBuf = (uint8_t*)malloc(pixels * 4);  // Two frames, two backgrounds
+  if (!benchMotionBuf) {
+    benchError = "out of memory";
+    return false;
+  }
+
+  MotionDetector scalar;
+  if (!motion_detector_init(benchMotion, benchMotionBuf + 2 * pixels, benchMotionW, benchMotionH) ||
+      !motion_detector_init(scalar, benchMotionBuf + 3 * pixels, benchMotionW, benchMotionH))
+  {
+    free(benchMotionBuf);
+    benchMotionBuf = NULL;
+    benchError = "frame size not supported";
+    return false;
+  }
+  uint32_t seen = 0, wrong = 0, missed = 0, mismatch = 0;
+  for (size_t i = 0; i < benchMotionCount; i++) {
+    const uint8_t* frame = bench_motion_frame(i, benchMotionBuf);
+    const MotionResult r = motion_detect(benchMotion, frame);
+    const MotionResult s = bench_motion_scalar_detect(scalar, frame);
+    if (r.changed != s.changed || r.flags != s.flags || memcmp(benchMotion.background, scalar.background, pixels)) {
+      mismatch++;
+    }
+    seen += (r.flags & MOTION_SEEN) ? 1 : 0;
+    // The frame the person leaves in still differs from the background
+    const bool walking = (i >= BENCH_WALK_FROM && i <= BENCH_WALK_TO);
+    if (!benchMotionRecorded && (r.flags & MOTION_SEEN) && !walking) {
+      wrong++;
+    }
+    if (!benchMotionRecorded && !(r.flags & MOTION_SEEN) && walking && i < BENCH_WALK_TO) {
+      missed++;
+    }
+  }
+  bench_count("motion", seen);        // Frames with motion
+  bench_count("mismatch", mismatch);  // Frames the kernel and the reference disagree on
+  if (!benchMotionRecorded) {
+    bench_count("false_motion", wrong);
+    bench_count("missed", missed);
+  } else {
+    bench_count("light_changes", benchMotion.lightingFrames);
+  }
+
+  // The timed runs go through two frames, with and without the person
+  if (!benchMotionRecorded) {
+    bench_motion_draw(benchMotionBuf, 0);
+    bench_motion_draw(benchMotionBuf + pixels, (BENCH_WALK_FROM + BENCH_WALK_TO) / 2);
+  }
+  motion_detector_init(benchMotion, benchMotionBuf + 2 * pixels, benchMotionW, benchMotionH);
+  benchBytes = pixels;
+  return true;
+}
+
+static
+void bench_motion_teardown(void*) {
+  free(benchMotionBuf);
+  benchMotionBuf = NULL;
+}
+
+static
+void bench_motion(void* ctx, uint32_t n) {
+  static size_t pos = 0;
+  const size_t pixels = (size_t)benchMotionW * benchMotionH;
+  for (uint32_t i = 0; i < n; i++, pos++) {
+    const uint8_t* frame = benchMotionRecorded ? bench_motion_frame(pos, NULL) : benchMotionBuf + (pos & 1) * pixels;
+    benchSink = ctx ? bench_motion_scalar_detect(benchMotion, frame).changed
+                    : motion_detect(benchMotion, frame).changed;
+  }
+}
+
+/*
+ * ULP echo loops: runs the model of the ranging program (UlpRanging.h) over
+ * echoes of known widths, one echo per operation.
+ *
+ * Setup checks that the unlock distance round-trips through
+ * ulp_echo_loops() and ulp_echo_distance(), that echoes clearly shorter than
+ * the threshold wake the main cores and longer ones do not, that a wake
+ * reports the distance to within BENCH_ULP_SLACK loops (the ULP sees the
+ * rise up to a loop late), and that a late or missing echo times out.
+ */
+
+#define BENCH_ULP_RISE_US  500  // Trigger to echo rise of the sensor
+#define BENCH_ULP_SLACK    2    // Loops a reading can be off by
+
+static uint16_t benchUlpThreshold;
+
+static inline
+uint32_t bench_ulp_cycles(float us) {
+  return us * (ULP_CLOCK_HZ / 1000000.0f);
+}
+
+static
+bool bench_ulp_setup(void*) {
+  benchUlpThreshold = ulp_echo_loops(RANGE_UNLOCK_CM);
+  const float slackCm = ulp_echo_distance(BENCH_ULP_SLACK);
+  const float backCm  = ulp_echo_distance(benchUlpThreshold);
+  uint32_t wrong = 0, checked = 0, worstUm = 0;
+  wrong += (backCm > RANGE_UNLOCK_CM || RANGE_UNLOCK_CM - backCm >= ulp_echo_distance(1));
+  wrong += (ulp_echo_loops(RANGE_MAX_CM) > 0xFFFF);  // The threshold must fit R2
+
+  // Threshold path: every mm up to three times the unlock distance, at several phases against the loop
+  for (int mm = RANGE_MIN_CM * 10; mm <= RANGE_UNLOCK_CM * 30; mm++) {
+    const float cm = mm / 10.0f;
+    for (uint32_t phase = 0; phase < ULP_LOOP_CYCLES; phase += 5) {
+      const UlpEcho e = ulp_echo_model(benchUlpThreshold, bench_ulp_cycles(BENCH_ULP_RISE_US) + phase,
+                                       bench_ulp_cycles(cm * 2 / 0.0343f));
+      checked++;
+      if (!e.rose) {
+        wrong++;
+      } else if (e.wake) {
+        const float seenCm = ulp_echo_distance(benchUlpThreshold - e.remain);  // As ulp_ranging_wake() reports it
+        const uint32_t um = fabsf(seenCm - cm) * 10000;
+        worstUm = um > worstUm ? um : worstUm;
+        wrong += (cm > RANGE_UNLOCK_CM + slackCm || seenCm + slackCm < cm);
+      } else {
+        wrong += (cm < RANGE_UNLOCK_CM - slackCm);
+      }
+    }
+  }
+
+  // Rise timeout path: an echo just in time, one too late, and none
+  const uint32_t riseCycles = ULP_RISE_LOOPS * ULP_LOOP_CYCLES;
+  wrong += !ulp_echo_model(benchUlpThreshold, riseCycles - 2 * ULP_LOOP_CYCLES, bench_ulp_cycles(200)).rose;
+  wrong +=  ulp_echo_model(benchUlpThreshold, riseCycles + ULP_LOOP_CYCLES, bench_ulp_cycles(200)).rose;
+  wrong +=  ulp_echo_model(benchUlpThreshold, 0, 0).rose;
+  checked += 3;
+
+  bench_count("loops",    benchUlpThreshold);  // Threshold the ULP counts down from
+  bench_count("error_um", worstUm);            // Worst distance a wake reports, against the echo
+  bench_count("checked",  checked);
+  bench_count("wrong",    wrong);
+  return true;
+}
+
+static
+void bench_ulp(void*, uint32_t n) {
+  static uint32_t mm = RANGE_MIN_CM * 10;
+  for (uint32_t i = 0; i < n; i++) {
+    benchSink = ulp_echo_model(benchUlpThreshold, bench_ulp_cycles(BENCH_ULP_RISE_US),
+                               bench_ulp_cycles(mm * 2 / 0.343f)).remain;
+    mm = (mm < RANGE_UNLOCK_CM * 20) ? mm + 1 : RANGE_MIN_CM * 10;
+  }
+}
+
+// Function to register the cases that build everywhere
+void bench_add_portable() {
+  bench_add("distance",    bench_distance,    100, 20);
+  bench_add("heap_32",     bench_alloc,       100, 20, (void*)32);
+  bench_add("heap_4k",     bench_alloc,       100, 20, (void*)4096);
+  bench_add("heap_churn",  bench_alloc_churn, 10,  20);
+  bench_add("range",       bench_range_filter, 100, 20, NULL, bench_range_setup);
+  bench_add("motion",        bench_motion, 5, 10, NULL,     bench_motion_setup, bench_motion_teardown);
+  bench_add("motion_scalar", bench_motion, 5, 10, (void*)1, bench_motion_setup, bench_motion_teardown);
+  bench_add("ulp",         bench_ulp,         100, 20, NULL, bench_ulp_setup);
+}
+
+#ifdef ARDUINO
+
+/*
+ * Device cases
+ */
+
+static Preferences benchPrefs;
+
+static
+bool bench_nvs_open(void*) {
+  return benchPrefs.begin("bench", false);
+}
+
+// Function to open the namespace with the key in it, so the lookups hit
+static
+bool bench_nvs_open_key(void*) {
+  if (!bench_nvs_open(NULL)) {
+    return false;
+  }
+  if (benchPrefs.putDouble("lat", 43.657426) != sizeof(double)) {
+    benchPrefs.end();
+    benchError = "NVS write failed";
+    return false;
+  }
+  return true;
+}
+
+static
+void bench_nvs_close(void*) {
+  benchPrefs.clear();
+  benchPrefs.end();
+}
+
+static
+void bench_nvs_put(void*, uint32_t n) {
+  for (uint32_t i = 0; i < n; i++) {
+    benchPrefs.putDouble("lat", 43.657426 + i);
+  }
+}
+
+static
+void bench_nvs_get(void*, uint32_t n) {
+  for (uint32_t i = 0; i < n; i++) {
+    benchSink = benchPrefs.getDouble("lat", 0);
+  }
+}
+
+static
+void bench_lcd_line(void*, uint32_t n) {
+  for (uint32_t i = 0; i < n; i++) {
+    lcd.setCursor(0, 1);
+    lcd.print(i & 1 ? "Unlocked        " : "Locked          ");
+  }
+}
+
+// Whole screen: both lines, as after a state change
+static
+void bench_lcd_screen(void*, uint32_t n) {
+  for (uint32_t i = 0; i < n; i++) {
+    lcd.setCursor(0, 0);
+    lcd.print("Lock State:     ");
+    lcd.setCursor(0, 1);
+    lcd.print(i & 1 ? "Unlocked        " : "Locked          ");
+  }
+}
+
+// One cell, e.g. a compartment of the locker bank
+static
+void bench_lcd_cell(void*, uint32_t n) {
+  for (uint32_t i = 0; i < n; i++) {
+    lcd.setCursor(i & 15, 1);
+    lcd.write(i & 1 ? 'U' : 'L');
+  }
+}
+
+static
+void bench_ultrasonic(void*, uint32_t n) {
+  for (uint32_t i = 0; i < n; i++) {
+    digitalWrite(trigPin, LOW);
+    delayMicroseconds(2);
+    digitalWrite(trigPin, HIGH);
+    delayMicroseconds(10);
+    digitalWrite(trigPin, LOW);
+    benchSink = pulseIn(echoPin, HIGH, 30000);  // Give up beyond ~5 m
+  }
+}
+
+static framesize_t benchFrameRestore = FRAMESIZE_INVALID;
+
+static const char* const benchFrameNames[] = {
+  "camera_96x96", "camera_qqvga", "camera_qcif", "camera_hqvga", "camera_240x240",
+  "camera_qvga", "camera_cif", "camera_hvga", "camera_vga", "camera_svga",
+  "camera_xga", "camera_hd", "camera_sxga", "camera_uxga",
+};
+
+static
+bool bench_camera_setup(void* ctx) {
+  sensor_t* s = esp_camera_sensor_get();
+  if (!s) {
+    benchError = "no camera";
+    return false;
+  }
+  benchFrameRestore = s->status.framesize;
+  if (s->set_framesize(s, (framesize_t)(intptr_t)ctx)) {
+    benchError = "frame size not supported";
+    return false;
+  }
+  // Drop the frames captured at the old size
+  for (int i = 0; i < 2; i++) {
+    if (camera_fb_t* fb = esp_camera_fb_get()) {
+      esp_camera_fb_return(fb);
+    }
+  }
+  return true;
+}
+
+static
+void bench_camera_restore(void*) {
+  if (sensor_t* s = esp_camera_sensor_get()) {
+    s->set_framesize(s, benchFrameRestore);
+  }
+}
+
+static
+void bench_camera(void* ctx, uint32_t n) {
+  for (uint32_t i = 0; i < n; i++) {
+    PROFILE_SCOPE(PROF_CAMERA);
+    TRACE_SCOPE(TRACE_CAMERA, (intptr_t)ctx);
+    if (camera_fb_t* fb = esp_camera_fb_get()) {
+      benchBytes = fb->len;
+      esp_camera_fb_return(fb);
+    }
+  }
+}
+
+static WiFiClientSecure* benchTls = NULL;
+
+static
+bool bench_tls_connect(void*) {
+  benchTls = new WiFiClientSecure();
+  benchTls->setInsecure();  // Only the write path is measured
+  if (!benchTls->connect(configStore.cloudHost, 443)) {
+    delete benchTls;
+    benchTls = NULL;
+    benchError = "connect failed";
+    return false;
+  }
+  return true;
+}
+
+static
+void bench_tls_close(void*) {
+  benchTls->stop();
+  delete benchTls;
+  benchTls = NULL;
+}
+
+static
+void bench_tls_write(void*, uint32_t n) {
+  static uint8_t buff[BENCH_TLS_BYTES];
+  for (uint32_t i = 0; i < n; i++) {
+    benchBytes = benchTls->write(buff, sizeof(buff));
+  }
+}
+
+// Function to register the cases that need the board
+void bench_add_device() {
+  bench_add("nvs_put",    bench_nvs_put,    10, 5, NULL, bench_nvs_open, bench_nvs_close);
+  bench_add("nvs_get",    bench_nvs_get,    10, 5, NULL, bench_nvs_open_key, bench_nvs_close);
+  bench_add("lcd_line",   bench_lcd_line,   10, 5);
+  bench_add("lcd_screen", bench_lcd_screen, 10, 5);
+  bench_add("lcd_cell",   bench_lcd_cell,   100, 5);
+  bench_add("ultrasonic", bench_ultrasonic, 1,  5);
+  for (int fs = FRAMESIZE_96X96; fs <= FRAMESIZE_UXGA; fs++) {
+    bench_add(benchFrameNames[fs], bench_camera, 1, 5, (void*)(intptr_t)fs,
+              bench_camera_setup, bench_camera_restore);
+  }
+  bench_add("tls_write",  bench_tls_write,  1,  4, NULL, bench_tls_connect, bench_tls_close);
+}
+
+// Function to handle the "bench" console command: bench [list | <name prefix>]
+void bench_command(int argc, const char** argv) {
+  if (!benchCaseCount) {
+    bench_add_portable();
+    bench_add_device();
+  }
+  if (argc >= 1 && 0 == strcmp(argv[0], "list")) {
+    for (int i = 0; i < benchCaseCount; i++) {
+      edgentConsole.printf(" %s\n", benchCases[i].name);
+    }
+    return;
+  }
+  char buff[128];
+  JsonWriter json(buff, sizeof(buff), console_json_sink);
+  bench_run(argc >= 1 ? argv[0] : NULL, BLYNK_INFO_DEVICE " " BLYNK_FIRMWARE_VERSION, json);
+}
+
+#endif
@@ -2,6 +2,13 @@
 extern "C" {
   void app_loop();
   void restartMCU();  // Restarts the microcontroller unit.
+  void bench_command(int argc, const char** argv);  // Runs the microbenchmarks (Bench.h).
+  void power_command(int argc, const char** argv);  // Shows the power profile residency (PowerGovernor.h).
+  void lock_command(int argc, const char** argv);  // Shows the lock state and its last transitions (ElectronicComponents.h).
+  void range_command(int argc, const char** argv);  // Shows the ultrasonic filter counters or raw echoes (ElectronicComponents.h).
+  void bank_command(int argc, const char** argv);  // Shows every compartment and the scan rates (LockerBank.h).
+  void telemetry_command(int argc, const char** argv);  // Shows the telemetry counters (Telemetry.h).
+  void motion_command(int argc, const char** argv);  // Shows the motion detector counters or its block map (MotionDetect.h).
 }
 
 #include "Settings.h"  // Stores user settings.
@@ -40,23 +47,39 @@ extern "C" {
 #error "BLYNK_AUTH_TOKEN is assigned automatically when using Blynk.Edgent, please remove it from the configuration"
 #endif
 
-// Initialize a Blynk timer
-BlynkTimer edgentTimer;
-
 // Include additional Blynk and device-specific headers
 #include "BlynkState.h"  // Manages the different states the device can be in.
+#include "FixedString.h"  // Builds short strings in place, without heap allocations.
+#include "Log.h"  // Logs in the background, formatting off the hot path.
+#include "TimerWheel.h"  // One-shot and periodic timers for Edgent and the application.
 #include "ConfigStore.h"  // Stores configuration settings.
+#include "WiFiNetworks.h"  // Keeps the list of known networks and picks the best AP.
+#include "GpioEvents.h"  // Queues GPIO edges from interrupts for handling in the main loop.
 #include "ResetButton.h"  // Manages a physical reset button on the device.
+#include "JsonWriter.h"  // Streams JSON responses without heap allocation.
+#include "Profiler.h"  // Times the main loop and subsystems.
+#include "Trace.h"  // Records timestamped events for ordering and overlap analysis.
+#include "LoopWatchdog.h"  // Detects main loop stalls and records where they happen.
+#include "HeapProfiler.h"  // Tracks heap fragmentation and attributes allocations to call sites.
+#include "Boot.h"  // Runs independent init steps in parallel and reports the boot phases.
 #include "ConfigMode.h"  // Handles entering and managing configuration mode.
 #include "Indicator.h"  // Manages LED indicators or other UI elements to show status.
+#include "OTADecoder.h"  // Decodes compressed and delta OTA images while streaming.
 #include "OTA.h"  // Manages over-the-air firmware updates.
 #include "Console.h"  // Provides logging and console output.
 
 // Set the current state in the Blynk state machine
 inline void BlynkState::set(State m) {
   if (state != m && m < MODE_MAX_VALUE) {
-    DEBUG_PRINT(String(StateStr[state]) + " => " + StateStr[m]);
+    DEBUG_PRINTF("%s => %s", StateStr[state], StateStr[m]);
+    TRACE_INSTANT(TRACE_STATE, m);
     state = m;
+    if (m == MODE_CONNECTING_CLOUD) {
+      boot_mark("wifi");   // First association, for the boot report
+    } else if (m == MODE_RUNNING) {
+      boot_mark("cloud");
+    }
+    indicator_notify();  // Show the new state without waiting for the current animation step
 
     // Custom state handling can be implemented here,
     // such as custom LED indications
@@ -72,14 +95,12 @@ void printDeviceBanner()
   BLYNK_PRINT.print(" Device:    "); BLYNK_PRINT.println(getWiFiName());
   BLYNK_PRINT.print(" Firmware:  "); BLYNK_PRINT.println(BLYNK_FIRMWARE_VERSION " (build " __DATE__ " " __TIME__ ")");
   if (configStore.getFlag(CONFIG_FLAG_VALID)) {
-    BLYNK_PRINT.print(" Token:     ");
-    BLYNK_PRINT.println(String(configStore.cloudToken).substring(0,4) +
-                " - •••• - •••• - ••••");
+    BLYNK_PRINT.printf(" Token:     %.4s - •••• - •••• - ••••\n", configStore.cloudToken);
   }
-  BLYNK_PRINT.print(" Platform:  "); BLYNK_PRINT.println(String(BLYNK_INFO_DEVICE) + " @ " + ESP.getCpuFreqMHz() + "MHz");
+  BLYNK_PRINT.printf(" Platform:  %s @ %uMHz\n", BLYNK_INFO_DEVICE, ESP.getCpuFreqMHz());
   BLYNK_PRINT.print(" Chip rev:  "); BLYNK_PRINT.println(ESP.getChipRevision());
   BLYNK_PRINT.print(" SDK:       "); BLYNK_PRINT.println(ESP.getSdkVersion());
-  BLYNK_PRINT.print(" Flash:     "); BLYNK_PRINT.println(String(ESP.getFlashChipSize() / 1024) + "K");
+  BLYNK_PRINT.print(" Flash:     "); BLYNK_PRINT.printf("%uK\n", ESP.getFlashChipSize() / 1024);
   BLYNK_PRINT.print(" Free mem:  "); BLYNK_PRINT.println(ESP.getFreeHeap());
   BLYNK_PRINT.println("----------------------------------------------------");
 #endif
@@ -119,9 +140,13 @@ public:
 #endif
 
     // Initialize various components
+    log_init();
     indicator_init();
     button_init();
     config_init();
+    wifi_roam_init();
+    ota_init();
+    loop_watchdog_init();
     printDeviceBanner();
     console_init();
 
@@ -136,7 +161,7 @@ public:
     }
 
     // Check for valid template ID and name
-    if (!String(BLYNK_TEMPLATE_ID).startsWith("TMPL") || !strlen(BLYNK_TEMPLATE_NAME)) {
+    if (strncmp(BLYNK_TEMPLATE_ID, "TMPL", 4) || !strlen(BLYNK_TEMPLATE_NAME)) {
       DEBUG_PRINT("Invalid configuration of TEMPLATE_ID / TEMPLATE_NAME");
       while (true) { delay(100); }
     }
@@ -144,7 +169,11 @@ public:
 
   // Main run loop to handle different states
   void run() {
+    loop_watchdog_feed(); // Start of a loop pass
     app_loop(); // Run application-specific loop
+    if (!BlynkState::is(MODE_WAIT_CONFIG) && !BlynkState::is(MODE_CONFIGURING)) {
+      config_portal_stop(); // Shut the portal down once configuration mode is left
+    }
     switch (BlynkState::get()) {
       case MODE_WAIT_CONFIG:       // Enter configuration mode
       case MODE_CONFIGURING:       enterConfigMode();    break;  // Puts the device into configuration mode for setting up Wi-Fi credentials.
@@ -162,6 +191,10 @@ public:
 
 // Application-specific loop function
 void app_loop() {
-    edgentTimer.run();   // Run the Blynk timer
+    gpio_events_run();   // Handle the queued button and sensor edges
+    {
+      PROFILE_SCOPE(PROF_TIMER);
+      timer_run();       // Run the timers that are due
+    }
     edgentConsole.run(); // Run the console
 }
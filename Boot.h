@@ -0,0 +1,142 @@
+#include "freertos/event_groups.h"
+
+/*
+ * Boot sequencer and report.
+ *
+ * setup() times its steps with BOOT_PHASE(name). Steps that do not depend on
+ * the others (e.g. probing the camera) run as boot jobs: boot_spawn() starts
+ * them in a task on the given core, so they overlap with the rest of setup()
+ * and with Wi-Fi association, and boot_wait() blocks only the code that needs
+ * the result. Milestones (box usable, Wi-Fi up, cloud connected) are recorded
+ * with boot_mark(), once each.
+ *
+ * The "boot" console command prints every phase with its start, duration
+ * and core, in ms since the application started.
+ */
+
+struct BootPhase {
+  const char* name;
+  uint32_t    startUs;
+  uint32_t    endUs;    // 0 while running; equal to startUs for a milestone
+  uint8_t     core;
+};
+
+struct BootJob {
+  const char* name;
+  void      (*fn)();
+};
+
+static BootPhase          bootPhases[BOOT_PHASES_MAX];
+static int                bootPhaseCount = 0;
+static BootJob            bootJobs[BOOT_JOBS_MAX];
+static int                bootJobCount   = 0;
+static EventGroupHandle_t bootDone       = NULL;  // One bit per job, set when it returns
+static portMUX_TYPE       bootMux        = portMUX_INITIALIZER_UNLOCKED;
+
+// Function to start timing a phase, returns its id or -1 if the table is full
+int boot_phase_begin(const char* name) {
+  const uint32_t now = micros();
+  int id = -1;
+  portENTER_CRITICAL(&bootMux);
+  if (bootPhaseCount < BOOT_PHASES_MAX) {
+    id = bootPhaseCount++;
+    bootPhases[id].name    = name;
+    bootPhases[id].startUs = now;
+    bootPhases[id].endUs   = 0;
+    bootPhases[id].core    = xPortGetCoreID();
+  }
+  portEXIT_CRITICAL(&bootMux);
+  return id;
+}
+
+// Function to stop timing a phase
+void boot_phase_end(int id) {
+  if (id >= 0) {
+    bootPhases[id].endUs = micros() | 1;  // Never 0, which means still running
+  }
+}
+
+// Function to record a milestone, the first time it is reached
+void boot_mark(const char* name) {
+  for (int i = 0; i < bootPhaseCount; i++) {
+    if (bootPhases[i].name == name) {
+      return;
+    }
+  }
+  const int id = boot_phase_begin(name);
+  if (id >= 0) {
+    bootPhases[id].endUs = bootPhases[id].startUs;
+  }
+}
+
+// Times the enclosing scope as a boot phase
+class BootScope {
+public:
+  BootScope(const char* name) : m_Id(boot_phase_begin(name)) {}
+  ~BootScope() { boot_phase_end(m_Id); }
+private:
+  int m_Id;
+};
+
+#define BOOT_CONCAT2(a, b)  a##b
+#define BOOT_CONCAT(a, b)   BOOT_CONCAT2(a, b)
+#define BOOT_PHASE(name)    BootScope BOOT_CONCAT(bootScope, __LINE__)(name)
+
+// Task running one boot job
+static
+void boot_job_task(void* arg) {
+  const int job = (intptr_t)arg;
+  {
+    BootScope scope(bootJobs[job].name);
+    bootJobs[job].fn();
+  }
+  xEventGroupSetBits(bootDone, 1 << job);
+  vTaskDelete(NULL);
+}
+
+// Function to run an init step in the background on a core, returns a job id for boot_wait()
+int boot_spawn(const char* name, void (*fn)(), BaseType_t core) {
+  if (!bootDone) {
+    bootDone = xEventGroupCreate();
+  }
+  if (bootJobCount >= BOOT_JOBS_MAX) {
+    fn();  // No room: run it in place
+    return -1;
+  }
+  const int job = bootJobCount++;
+  bootJobs[job].name = name;
+  bootJobs[job].fn   = fn;
+  if (pdPASS != xTaskCreatePinnedToCore(boot_job_task, name, BOOT_TASK_STACK, (void*)(intptr_t)job,
+                                        BOOT_TASK_PRIORITY, NULL, core))
+  {
+    BootScope scope(name);
+    fn();
+    xEventGroupSetBits(bootDone, 1 << job);
+  }
+  return job;
+}
+
+// Function to wait for a boot job to finish, returns false on timeout
+bool boot_wait(int job, uint32_t timeoutMs) {
+  if (job < 0) {
+    return true;  // Ran in place
+  }
+  const EventBits_t bit = 1 << job;
+  return bit & xEventGroupWaitBits(bootDone, bit, pdFALSE, pdTRUE, pdMS_TO_TICKS(timeoutMs));
+}
+
+// Function to print the boot phases in the order they started
+template <typename Out>
+void boot_report(Out& out) {
+  out.printf("%-14s %9s %9s  core\n", "phase", "start ms", "took ms");
+  for (int i = 0; i < bootPhaseCount; i++) {
+    const BootPhase& p = bootPhases[i];
+    if (p.endUs == p.startUs) {
+      out.printf("%-14s %9.1f %9s  %u\n", p.name, p.startUs / 1000.0, "-", p.core);
+    } else if (!p.endUs) {
+      out.printf("%-14s %9.1f %9s  %u\n", p.name, p.startUs / 1000.0, "running", p.core);
+    } else {
+      out.printf("%-14s %9.1f %9.1f  %u\n", p.name, p.startUs / 1000.0, (p.endUs - p.startUs) / 1000.0, p.core);
+    }
+  }
+}
@@ -5,6 +5,7 @@
   Modification: 2024/07/01
 **********************************************************************/
 #include "esp_camera.h"
+#include "lwip/sockets.h"
 
 // ===================
 // Select camera model
@@ -26,15 +27,41 @@
 
 #include "camera_pins.h"
 
+// Function to tell whether a pin is taken by the camera (camera_pins.h) or the PSRAM (GPIO16, GPIO17),
+// for static_asserts on the pins of the other peripherals
+static constexpr bool camera_pin(int pin) {
+  return pin == PWDN_GPIO_NUM || pin == RESET_GPIO_NUM || pin == XCLK_GPIO_NUM ||
+         pin == SIOD_GPIO_NUM || pin == SIOC_GPIO_NUM || pin == Y9_GPIO_NUM || pin == Y8_GPIO_NUM ||
+         pin == Y7_GPIO_NUM || pin == Y6_GPIO_NUM || pin == Y5_GPIO_NUM || pin == Y4_GPIO_NUM ||
+         pin == Y3_GPIO_NUM || pin == Y2_GPIO_NUM || pin == VSYNC_GPIO_NUM || pin == HREF_GPIO_NUM ||
+         pin == PCLK_GPIO_NUM || pin == 16 || pin == 17;
+}
+
 // Function to start the camera server
 void startCameraServer();
 
-void initializeCameraWeb() {
-  // Initialize serial communication at a baud rate of 115200
-  Serial.begin(115200);
-  Serial.setDebugOutput(true);
-  Serial.println();
+// Function to tell whether a client holds a stream: a connected socket on the stream port of
+// startCameraServer(), which only serves /stream. Looks at the sockets instead of hooking the
+// stream handler, which is in app_httpd.cpp of the CameraWebServer example
+bool camera_streaming() {
+  for (int fd = LWIP_SOCKET_OFFSET; fd < LWIP_SOCKET_OFFSET + CONFIG_LWIP_MAX_SOCKETS; fd++) {
+    struct sockaddr_storage addr;
+    socklen_t len = sizeof(addr);
+    if (getsockname(fd, (struct sockaddr*)&addr, &len) != 0 || addr.ss_family != AF_INET ||
+        ntohs(((struct sockaddr_in*)&addr)->sin_port) != CAMERA_STREAM_PORT)
+    {
+      continue;
+    }
+    len = sizeof(addr);
+    if (getpeername(fd, (struct sockaddr*)&addr, &len) == 0) {
+      return true;  // The listening socket has no peer
+    }
+  }
+  return false;
+}
 
+// Function to probe the camera and allocate its frame buffers; runs as a boot job (see setup())
+void initializeCameraWeb() {
   // Camera configuration setup
   camera_config_t config;
   config.ledc_channel = LEDC_CHANNEL_0;
@@ -78,7 +105,7 @@ void initializeCameraWeb() {
   esp_err_t err = esp_camera_init(&config);
   if (err != ESP_OK) {
     // If camera initialization fails, print the error code
-    Serial.printf("Camera init failed with error 0x%x", err);
+    LOG_E("Camera init failed with error 0x%x", err);
     return;
   }
 
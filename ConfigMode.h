@@ -6,54 +6,8 @@
 // Check if BLYNK_FS is not defined
 #ifndef BLYNK_FS
 
-// HTML form for configuring WiFi and Blynk settings
-const char* config_form = R"html(
-<!DOCTYPE HTML>
-<html>
-<head>
-  <title>WiFi setup</title>
-  <style>
-  body {
-    background-color: #fcfcfc;
-    box-sizing: border-box;
-  }
-  body, input {
-    font-family: Roboto, sans-serif;
-    font-weight: 400;
-    font-size: 16px;
-  }
-  .centered {
-    position: fixed;
-    top: 50%;
-    left: 50%;
-    transform: translate(-50%, -50%);
-    padding: 20px;
-    background-color: #ccc;
-    border-radius: 4px;
-  }
-  td { padding:0 0 0 5px; }
-  label { white-space:nowrap; }
-  input { width: 20em; }
-  input[name="port"] { width: 5em; }
-  input[type="submit"], img { margin: auto; display: block; width: 30%; }
-  </style>
-</head> 
-<body>
-<div class="centered">
-  <form method="get" action="config">
-    <table>
-    <tr><td><label for="ssid">WiFi SSID:</label></td>  <td><input type="text" name="ssid" length=64 required="required"></td></tr>
-    <tr><td><label for="pass">Password:</label></td>   <td><input type="text" name="pass" length=64></td></tr>
-    <tr><td><label for="blynk">Auth token:</label></td><td><input type="text" name="blynk" placeholder="a0b1c2d..." pattern="[-_a-zA-Z0-9]{32}" maxlength="32" required="required"></td></tr>
-    <tr><td><label for="host">Host:</label></td>       <td><input type="text" name="host" value="blynk.cloud" length=64></td></tr>
-    <tr><td><label for="port_ssl">Port:</label></td>   <td><input type="number" name="port_ssl" value="443" min="1" max="65535"></td></tr>
-    </table><br/>
-    <input type="submit" value="Apply">
-  </form>
-</div>
-</body>
-</html>
-)html";
+// Gzip-compressed HTML form for configuring WiFi and Blynk settings
+#include "config_form.h"
 
 #endif
 
@@ -83,53 +37,55 @@ void restartMCU() {
 }
 
 // Function to encode a unique part for device identification
-static
-String encodeUniquePart(uint32_t n, unsigned len)
+template <size_t N>
+void encodeUniquePart(uint32_t n, unsigned len, FixedString<N>& out)
 {
   static constexpr char alphabet[] = { "0W8N4Y1HP5DF9K6JM3C2UA7R" };
   static constexpr int base = sizeof(alphabet)-1;
 
-  char buf[16] = { 0, };
   char prev = 0;
-  for (unsigned i = 0; i < len; n /= base) {
+  for (unsigned i = 0; i < len; i++, n /= base) {
     char c = alphabet[n % base];
     if (c == prev) {
       c = alphabet[(n+1) % base];
     }
-    prev = buf[i++] = c;
+    out.append(prev = c);
   }
-  return String(buf);
 }
 
-// Function to get the WiFi name (SSID) with optional prefix
+// Function to get the WiFi name (SSID) with optional prefix, built once and cached
 static
-String getWiFiName(bool withPrefix = true)
+const char* getWiFiName(bool withPrefix = true)
 {
-  const uint64_t chipId = ESP.getEfuseMac();
+  static FixedString<33> wifiName;  // Longest SSID + terminator
+  static size_t prefixLen = 0;
 
-  uint32_t unique = 0;
-  for (int i=0; i<4; i++) {
-    unique = BlynkCRC32(&chipId, sizeof(chipId), unique);
-  }
-  String devUnique = encodeUniquePart(unique, 4);
+  if (wifiName.isEmpty()) {
+    const uint64_t chipId = ESP.getEfuseMac();
 
-  String devPrefix = CONFIG_DEVICE_PREFIX;
-  String devName = String(BLYNK_TEMPLATE_NAME).substring(0, 31-6-devPrefix.length());
+    uint32_t unique = 0;
+    for (int i=0; i<4; i++) {
+      unique = BlynkCRC32(&chipId, sizeof(chipId), unique);
+    }
 
-  if (withPrefix) {
-    return devPrefix + " " + devName + "-" + devUnique;
-  } else {
-    return devName + "-" + devUnique;
+    const size_t nameLen = 31-6-strlen(CONFIG_DEVICE_PREFIX);
+    wifiName.append(CONFIG_DEVICE_PREFIX " ");
+    prefixLen = wifiName.length();
+    wifiName.append(BLYNK_TEMPLATE_NAME, BlynkMin(strlen(BLYNK_TEMPLATE_NAME), nameLen));
+    wifiName.append('-');
+    encodeUniquePart(unique, 4, wifiName);
   }
+
+  return withPrefix ? wifiName.c_str() : wifiName.c_str() + prefixLen;
 }
 
 // Function to convert MAC address to string
 static inline
-String macToString(byte mac[6]) {
-  char buff[20];
-  snprintf(buff, sizeof(buff), "%02x:%02x:%02x:%02x:%02x:%02x",
-           mac[0], mac[1], mac[2], mac[3], mac[4], mac[5]);
-  return String(buff);
+FixedString<18> macToString(byte mac[6]) {
+  FixedString<18> str;
+  str.appendf("%02x:%02x:%02x:%02x:%02x:%02x",
+              mac[0], mac[1], mac[2], mac[3], mac[4], mac[5]);
+  return str;
 }
 
 // Function to convert WiFi security type to string
@@ -175,34 +131,158 @@ String getWiFiNetworkBSSID() {
   return WiFi.BSSIDstr();
 }
 
-// Function to enter configuration mode
-void enterConfigMode()
+// Per-endpoint time to first byte (us), measured from the poll that picked up the request
+struct PortalStat {
+  const char* uri;
+  uint32_t    count;
+  uint32_t    lastUs;
+  uint32_t    maxUs;
+  uint32_t    totalUs;
+};
+
+static PortalStat  portalStats[PORTAL_STATS_MAX];
+static int         portalStatCount = 0;
+static PortalStat* portalCurrent   = NULL;  // Endpoint being served, until its first byte is out
+static uint32_t    portalPollStart = 0;
+
+// Function to record the first byte of the current response
+static
+void portal_first_byte() {
+  if (PortalStat* st = portalCurrent) {
+    const uint32_t us = micros() - portalPollStart;
+    st->count++;
+    st->lastUs   = us;
+    st->maxUs    = BlynkMax(st->maxUs, us);
+    st->totalUs += us;
+    portalCurrent = NULL;
+  }
+}
+
+// Function to register a portal endpoint with time-to-first-byte accounting
+static
+void portal_on(const char* uri, HTTPMethod method, WebServer::THandlerFunction fn,
+               WebServer::THandlerFunction upload = nullptr)
 {
-  WiFi.mode(WIFI_OFF);
-  delay(100);
-  WiFi.mode(WIFI_AP);
-  delay(2000);
-  WiFi.softAPConfig(WIFI_AP_IP, WIFI_AP_IP, WIFI_AP_Subnet);
-  WiFi.softAP(getWiFiName().c_str());
-  delay(500);
+  PortalStat* st = NULL;
+  if (portalStatCount < PORTAL_STATS_MAX) {
+    st = &portalStats[portalStatCount++];
+    st->uri = uri;
+  }
+  auto handler = [st, fn]() {
+    portalCurrent = st;
+    fn();
+    portal_first_byte();  // For responses sent in one piece
+  };
+  if (upload) {
+    server.on(uri, method, handler, upload);
+  } else {
+    server.on(uri, method, handler);
+  }
+}
 
-  // Set up DNS Server
-  dnsServer.setTTL(300); // Time-to-live 300s
-  dnsServer.setErrorReplyCode(DNSReplyCode::ServerFailure); // Return code for non-accessible domains
-#ifdef WIFI_CAPTIVE_PORTAL_ENABLE
-  dnsServer.start(DNS_PORT, "*", WiFi.softAPIP()); // Point all to our IP
-  server.onNotFound(handleRoot);
-#else
-  dnsServer.start(DNS_PORT, CONFIG_AP_URL, WiFi.softAPIP());
-  DEBUG_PRINT(String("AP URL:  ") + CONFIG_AP_URL);
-#endif
+// Networks found by the last portal scan, strongest first
+struct PortalNet {
+  char    ssid[33];
+  uint8_t bssid[6];
+  int8_t  rssi;
+  uint8_t sec;
+  uint8_t ch;
+};
+
+static PortalNet portalNets[PORTAL_SCAN_MAX];
+static int       portalNetCount   = 0;
+static uint32_t  portalScanTime   = 0;      // millis() when the scan completed, 0 = no results
+static bool      portalScanActive = false;
+
+// Function to start a background scan for the portal
+static
+void portal_scan_start() {
+  if (!portalScanActive && WiFi.scanNetworks(true, true) == WIFI_SCAN_RUNNING) {
+    portalScanActive = true;
+  }
+}
 
+// Function to pick up finished scan results: sorted once, hidden networks skipped
+static
+void portal_scan_poll() {
+  if (!portalScanActive) {
+    return;
+  }
+  int found = WiFi.scanComplete();
+  if (found == WIFI_SCAN_RUNNING) {
+    return;
+  }
+  portalScanActive = false;
+  if (found < 0) {
+    return;
+  }
+  DEBUG_PRINTF("Found networks: %d", found);
+
+  // Sort networks by RSSI (signal strength), reading each RSSI once
+  struct ScanEntry { int16_t rssi; uint8_t id; };
+  found = BlynkMin(found, 255);
+  ScanEntry entries[found];
+  int count = 0;
+  for (int i = 0; i < found; i++) {
+    if (WiFi.SSID(i).length()) {  // Skip hidden networks
+      entries[count].rssi = WiFi.RSSI(i);
+      entries[count].id   = i;
+      count++;
+    }
+  }
+  std::sort(entries, entries + count, [](const ScanEntry& a, const ScanEntry& b) {
+    return a.rssi > b.rssi;
+  });
+
+  portalNetCount = BlynkMin(PORTAL_SCAN_MAX, count);
+  for (int i = 0; i < portalNetCount; i++) {
+    const int id = entries[i].id;
+    PortalNet& net = portalNets[i];
+    CopyString(WiFi.SSID(id), net.ssid);
+    memcpy(net.bssid, WiFi.BSSID(id), sizeof(net.bssid));
+    net.rssi = entries[i].rssi;
+    net.sec  = WiFi.encryptionType(id);
+    net.ch   = WiFi.channel(id);
+  }
+  WiFi.scanDelete();
+  portalScanTime = millis() | 1;
+}
+
+// Function to stream a JSON chunk to the current web client
+static
+void server_json_sink(void*, const char* data, size_t len) {
+  server.sendContent(data, len);
+}
+
+// Function to start a chunked JSON response; the body is written through the returned writer
+static
+JsonWriter server_json_begin(char* buff, size_t size, int code = 200) {
+  server.setContentLength(CONTENT_LENGTH_UNKNOWN);
+  server.send(code, "application/json", "");
+  portal_first_byte();
+  return JsonWriter(buff, size, server_json_sink);
+}
+
+// Function to finish a chunked JSON response
+static
+void server_json_end(JsonWriter& json) {
+  json.flush();
+  server.sendContent("");
+}
+
+static bool portalActive = false;  // Soft AP, DNS and web server are up
+static bool portalRoutes = false;  // Web server endpoints are registered
+
+// Function to register the web server endpoints of the configuration portal
+static
+void config_portal_routes()
+{
   // Handle firmware update via HTTP GET and POST requests
-  server.on("/update", HTTP_GET, []() {
+  portal_on("/update", HTTP_GET, []() {
     server.sendHeader("Connection", "close");
     server.send(200, "text/html", serverUpdateForm);
   });
-  server.on("/update", HTTP_POST, []() {
+  portal_on("/update", HTTP_POST, []() {
     server.sendHeader("Connection", "close");
     if (!Update.hasError()) {
       server.send(200, "text/plain", "OK");
@@ -214,7 +294,7 @@ void enterConfigMode()
   }, []() {
     HTTPUpload& upload = server.upload();
     if (upload.status == UPLOAD_FILE_START) {
-      DEBUG_PRINT(String("Update: ") + upload.filename);
+      DEBUG_PRINTF("Update: %s", upload.filename.c_str());
       //WiFiUDP::stop();
 
       if (!Update.begin(UPDATE_SIZE_UNKNOWN)) { // Start with max available size
@@ -243,13 +323,14 @@ void enterConfigMode()
 
 #ifndef BLYNK_FS
   // Serve the configuration form for WiFi and Blynk settings
-  server.on("/", []() {
-    server.send(200, "text/html", config_form);
+  portal_on("/", HTTP_ANY, []() {
+    server.sendHeader("Content-Encoding", "gzip");
+    server.send_P(200, "text/html", (const char*)config_form_html_gz, config_form_html_gz_len);
   });
 #endif
 
   // Handle configuration settings via HTTP GET request
-  server.on("/config", []() {
+  portal_on("/config", HTTP_ANY, []() {
     DEBUG_PRINT("Applying configuration...");
     String ssid = server.arg("ssid");
     String ssidManual = server.arg("ssidManual");
@@ -271,8 +352,8 @@ void enterConfigMode()
 
     String content;
 
-    DEBUG_PRINT(String("WiFi SSID: ") + ssid + " Pass: " + pass);
-    DEBUG_PRINT(String("Blynk cloud: ") + token + " @ " + host + ":" + port);
+    DEBUG_PRINTF("WiFi SSID: %s Pass: %s", ssid.c_str(), pass.c_str());
+    DEBUG_PRINTF("Blynk cloud: %s @ %s:%s", token.c_str(), host.c_str(), port.c_str());
 
     if (token.length() == 32 && ssid.length() > 0) {
       configStore = configDefault;
@@ -327,91 +408,68 @@ void enterConfigMode()
   });
 
   // Handle board info request
-  server.on("/board_info.json", []() {
+  portal_on("/board_info.json", HTTP_ANY, []() {
     // Configuring starts with board info request (may impact indication)
     BlynkState::set(MODE_CONFIGURING);
 
     DEBUG_PRINT("Sending board info...");
     const char* tmpl = BLYNK_TEMPLATE_ID;
 
-    char buff[512];
-    snprintf(buff, sizeof(buff),
-      R"json({"board":"%s","tmpl_id":"%s","fw_type":"%s","fw_ver":"%s","ssid":"%s","bssid":"%s","mac":"%s","last_error":%d,"wifi_scan":true,"static_ip":true})json",
-      BLYNK_TEMPLATE_NAME,
-      tmpl ? tmpl : "Unknown",
-      BLYNK_FIRMWARE_TYPE,
-      BLYNK_FIRMWARE_VERSION,
-      getWiFiName().c_str(),
-      getWiFiApBSSID().c_str(),
-      getWiFiMacAddress().c_str(),
-      configStore.last_error
-    );
-    server.send(200, "application/json", buff);
+    char buff[256];
+    JsonWriter json = server_json_begin(buff, sizeof(buff));
+    json.beginObject()
+      .field("board",      BLYNK_TEMPLATE_NAME)
+      .field("tmpl_id",    tmpl ? tmpl : "Unknown")
+      .field("fw_type",    BLYNK_FIRMWARE_TYPE)
+      .field("fw_ver",     BLYNK_FIRMWARE_VERSION)
+      .field("ssid",       getWiFiName())
+      .field("bssid",      getWiFiApBSSID().c_str())
+      .field("mac",        getWiFiMacAddress().c_str())
+      .field("last_error", configStore.last_error)
+      .field("wifi_scan",  true)
+      .field("static_ip",  true)
+    .endObject();
+    server_json_end(json);
   });
 
-  // Handle WiFi scan request
-  server.on("/wifi_scan.json", []() {
-    DEBUG_PRINT("Scanning networks...");
-    int wifi_nets = WiFi.scanNetworks(true, true);
-    const uint32_t t = millis();
-    while (wifi_nets < 0 &&
-           millis() - t < 20000)
-    {
-      delay(20);
-      wifi_nets = WiFi.scanComplete();
+  // Handle WiFi scan request: served from the background scan, never waiting for one.
+  // Before the first scan completes the list is empty, and the app asks again
+  portal_on("/wifi_scan.json", HTTP_ANY, []() {
+    if (!portalScanTime || millis() - portalScanTime > PORTAL_SCAN_MAX_AGE) {
+      portal_scan_start();  // Refresh for the next request
     }
-    DEBUG_PRINT(String("Found networks: ") + wifi_nets);
-
-    if (wifi_nets > 0) {
-      // Sort networks by RSSI (signal strength)
-      int indices[wifi_nets];
-      for (int i = 0; i < wifi_nets; i++) {
-        indices[i] = i;
-      }
-      for (int i = 0; i < wifi_nets; i++) {
-        for (int j = i + 1; j < wifi_nets; j++) {
-          if (WiFi.RSSI(indices[j]) > WiFi.RSSI(indices[i])) {
-            std::swap(indices[i], indices[j]);
-          }
-        }
-      }
 
-      wifi_nets = BlynkMin(15, wifi_nets); // Show top 15 networks
-
-      // TODO: skip empty names
-      String result = "[\n";
-
-      char buff[256];
-      for (int i = 0; i < wifi_nets; i++){
-        int id = indices[i];
-
-        snprintf(buff, sizeof(buff),
-          R"json(  {"ssid":"%s","bssid":"%s","rssi":%i,"sec":"%s","ch":%i})json",
-          WiFi.SSID(id).c_str(),
-          WiFi.BSSIDstr(id).c_str(),
-          WiFi.RSSI(id),
-          wifiSecToStr(WiFi.encryptionType(id)),
-          WiFi.channel(id)
-        );
-
-        result += buff;
-        if (i != wifi_nets-1) result += ",\n";
-      }
-      WiFi.scanDelete();
-      server.send(200, "application/json", result + "\n]");
-    } else {
-      server.send(200, "application/json", "[]");
+    char buff[256];
+    JsonWriter json = server_json_begin(buff, sizeof(buff));
+    json.beginArray();
+    for (int i = 0; i < portalNetCount; i++) {
+      const PortalNet& net = portalNets[i];
+      char bssid[18];
+      snprintf(bssid, sizeof(bssid), "%02X:%02X:%02X:%02X:%02X:%02X",
+               net.bssid[0], net.bssid[1], net.bssid[2], net.bssid[3], net.bssid[4], net.bssid[5]);
+      json.raw("\n  ").beginObject()
+        .field("ssid",  net.ssid)
+        .field("bssid", bssid)
+        .field("rssi",  (int)net.rssi)
+        .field("sec",   wifiSecToStr((wifi_auth_mode_t)net.sec))
+        .field("ch",    (int)net.ch)
+      .endObject();
     }
+    if (portalNetCount) {
+      json.raw("\n");
+    }
+    json.endArray();
+    server_json_end(json);
   });
 
   // Handle reset configuration request
-  server.on("/reset", []() {
+  portal_on("/reset", HTTP_ANY, []() {
     BlynkState::set(MODE_RESET_CONFIG);
     server.send(200, "application/json", R"json({"status":"ok","msg":"Configuration reset"})json");
   });
 
   // Handle reboot request
-  server.on("/reboot", []() {
+  portal_on("/reboot", HTTP_ANY, []() {
     restartMCU();
   });
 
@@ -421,36 +479,128 @@ void enterConfigMode()
   server.serveStatic("/img/logo.png", BLYNK_FS, "/img/logo.png");
   server.serveStatic("/", BLYNK_FS, "/index.html");
 #endif
+}
+
+// Function to start the configuration portal: soft AP, DNS and web server
+static
+void config_portal_start()
+{
+  WiFi.mode(WIFI_OFF);
+  delay(100);
+  WiFi.mode(WIFI_AP);
+  delay(2000);
+  WiFi.softAPConfig(WIFI_AP_IP, WIFI_AP_IP, WIFI_AP_Subnet);
+  WiFi.softAP(getWiFiName());
+  delay(500);
+
+  // Set up DNS Server
+  dnsServer.setTTL(300); // Time-to-live 300s
+  dnsServer.setErrorReplyCode(DNSReplyCode::ServerFailure); // Return code for non-accessible domains
+#ifdef WIFI_CAPTIVE_PORTAL_ENABLE
+  dnsServer.start(DNS_PORT, "*", WiFi.softAPIP()); // Point all to our IP
+#else
+  dnsServer.start(DNS_PORT, CONFIG_AP_URL, WiFi.softAPIP());
+  DEBUG_PRINT("AP URL:  " CONFIG_AP_URL);
+#endif
+
+  if (!portalRoutes) {
+#ifdef WIFI_CAPTIVE_PORTAL_ENABLE
+    server.onNotFound(handleRoot);
+#endif
+    config_portal_routes();
+    portalRoutes = true;
+  }
 
   // Start the server
   server.begin();
+  portalActive = true;
 
-  // Main loop for handling configuration mode
-  while (BlynkState::is(MODE_WAIT_CONFIG) || BlynkState::is(MODE_CONFIGURING)) {
-    delay(10);
-    dnsServer.processNextRequest();
-    server.handleClient();
-    app_loop();
-    if (BlynkState::is(MODE_CONFIGURING) && WiFi.softAPgetStationNum() == 0) {
-      BlynkState::set(MODE_WAIT_CONFIG);
-    }
+  // Scan in the background, so the list is ready when the app asks for it
+  portalNetCount = 0;
+  portalScanTime = 0;
+  portal_scan_start();
+}
+
+// Function to stop the configuration portal once configuration is done
+void config_portal_stop()
+{
+  if (portalActive) {
+    server.stop();
+    dnsServer.stop();
+    portalActive = false;
+  }
+}
+
+// Function to run configuration mode. Each call serves what is pending and returns,
+// so the main loop keeps running while the portal is up.
+void enterConfigMode()
+{
+  if (!portalActive) {
+    config_portal_start();
   }
 
-  // Stop the server once configuration is done
-  server.stop();
+  portalPollStart = micros();
+  dnsServer.processNextRequest();
+  server.handleClient();
+  portal_scan_poll();
+
+  if (BlynkState::is(MODE_CONFIGURING) && WiFi.softAPgetStationNum() == 0) {
+    BlynkState::set(MODE_WAIT_CONFIG);
+  }
 }
 
+// Time from boot to the first IP address and to the first cloud connection (ms, 0 = not yet)
+static uint32_t bootTimeToIP    = 0;
+static uint32_t bootTimeToCloud = 0;
+static bool     bootFastConnect = false;  // First IP was obtained via the cached BSSID/channel
+
+// Next scanned AP to try, and the slot to try when there are no scan results
+static int connectCandidate = 0;
+static int connectSlot      = 0;
+
 // Function to handle connecting to the WiFi network
 void enterConnectNet() {
   BlynkState::set(MODE_CONNECTING_NET);
-  DEBUG_PRINT(String("Connecting to WiFi: ") + configStore.wifiSSID);
+
+  // Directed connect to the last good AP, if we have one cached
+  const bool fastConnect = configStore.getFlag(CONFIG_FLAG_NET_CACHE) &&
+                           wifi_slot_ssid(configStore.netSlot)[0];
+
+  // Otherwise with fallback networks, pick the strongest known AP from a scan
+  const int slotCount = wifi_slot_count();
+  if (!fastConnect && slotCount > 1 && !wifi_scan_fresh()) {
+    DEBUG_PRINT("Scanning for known networks...");
+    wifi_scan_now();
+    connectCandidate = 0;
+  }
+  const KnownAP* candidate = (!fastConnect && wifi_scan_fresh() && connectCandidate < knownAPCount)
+                           ? &knownAPs[connectCandidate] : NULL;
+
+  int slot;
+  if (fastConnect) {
+    slot = configStore.netSlot;
+  } else if (candidate) {
+    slot = candidate->slot;
+  } else {
+    for (int tries = 0; !wifi_slot_ssid(connectSlot)[0]; tries++) {
+      if (tries == WIFI_SLOT_COUNT) {
+        DEBUG_PRINT("No WiFi network configured");
+        BlynkState::set(MODE_WAIT_CONFIG);
+        return;
+      }
+      connectSlot = (connectSlot + 1) % WIFI_SLOT_COUNT;
+    }
+    slot = connectSlot;
+  }
+
+  DEBUG_PRINTF("Connecting to WiFi: %s", wifi_slot_ssid(slot));
 
   // Needed for setHostname to work
   WiFi.enableSTA(false);
 
   // Set the hostname for the device
-  String hostname = getWiFiName();
-  hostname.replace(" ", "-");
+  FixedString<33> hostname = getWiFiName();
+  hostname.replace(' ', '-');
   WiFi.setHostname(hostname.c_str());
 
   // Configure static IP if needed
@@ -467,11 +617,33 @@ void enterConnectNet() {
       return;
     }
   }
+#ifdef WIFI_FAST_CONNECT_LEASE
+  else if (fastConnect && configStore.netIP) {
+    // Reuse the previous lease to skip the DHCP exchange
+    WiFi.config(configStore.netIP, configStore.netGW, configStore.netMask, configStore.netDNS);
+  } else {
+    WiFi.config(IPAddress(0u), IPAddress(0u), IPAddress(0u)); // Back to DHCP
+  }
+#endif
 
   // Begin WiFi connection
-  WiFi.begin(configStore.wifiSSID, configStore.wifiPass);
-
-  unsigned long timeoutMs = millis() + WIFI_NET_CONNECT_TIMEOUT;
+  unsigned long timeoutMs = millis();
+  if (fastConnect) {
+    DEBUG_PRINTF("Fast connect: ch %d", configStore.netChannel);
+    WiFi.begin(wifi_slot_ssid(slot), wifi_slot_pass(slot),
+               configStore.netChannel, configStore.netBSSID);
+    timeoutMs += WIFI_FAST_CONNECT_TIMEOUT;
+  } else if (candidate) {
+    DEBUG_PRINTF("AP ch %d, %d dBm", candidate->channel, candidate->rssi);
+    WiFi.begin(wifi_slot_ssid(slot), wifi_slot_pass(slot),
+               candidate->channel, candidate->bssid);
+    timeoutMs += (knownAPCount > 1 || slotCount > 1) ? WIFI_NET_FAILOVER_TIMEOUT
+                                                     : WIFI_NET_CONNECT_TIMEOUT;
+  } else {
+    WiFi.begin(wifi_slot_ssid(slot), wifi_slot_pass(slot));
+    timeoutMs += (slotCount > 1) ? WIFI_NET_FAILOVER_TIMEOUT
+                                 : WIFI_NET_CONNECT_TIMEOUT;
+  }
   while ((timeoutMs > millis()) && (WiFi.status() != WL_CONNECTED))
   {
     delay(10);
@@ -492,21 +664,68 @@ void enterConnectNet() {
       BLYNK_LOG_IP("Using Dynamic IP: ", localip);
     }
 
+    if (!bootTimeToIP) {
+      bootTimeToIP = millis();
+      bootFastConnect = fastConnect;
+      DEBUG_PRINTF("Time to IP: %u ms (%s)", bootTimeToIP, fastConnect ? "fast" : "scan");
+    }
+
+    connectCandidate = 0;
+    config_save_net_cache(slot, WiFi.BSSID(), WiFi.channel(),
+                          WiFi.localIP(), WiFi.subnetMask(),
+                          WiFi.gatewayIP(), WiFi.dnsIP());
+
     connectNetRetries = WIFI_CLOUD_MAX_RETRIES;
     BlynkState::set(MODE_CONNECTING_CLOUD);
-  } else if (--connectNetRetries <= 0) {
-    config_set_last_error(BLYNK_PROV_ERR_NETWORK);
-    BlynkState::set(MODE_ERROR);
+  } else if (fastConnect) {
+    // The AP moved or went away: fall back to a full scan on the next attempt
+    DEBUG_PRINT("Fast connect failed, scanning");
+    WiFi.disconnect();
+    configStore.setFlag(CONFIG_FLAG_NET_CACHE, false);
+  } else {
+    // Fail over to the next AP; once all were tried, the next attempt rescans
+    WiFi.disconnect();
+    if (candidate) {
+      if (++connectCandidate >= knownAPCount) {
+        connectCandidate = 0;
+        knownAPTime = 0;
+      }
+    } else {
+      connectSlot = (connectSlot + 1) % WIFI_SLOT_COUNT;
+    }
+
+    if (--connectNetRetries <= 0) {
+      config_set_last_error(BLYNK_PROV_ERR_NETWORK);
+      BlynkState::set(MODE_ERROR);
+    }
   }
 }
 
+// Blynk cloud connection statistics (times in ms), shown by the console 'cloud' command
+struct CloudStats {
+  uint32_t connects;        // Successful cloud connections
+  uint32_t failures;        // Attempts that ended without a connection
+  uint32_t handshakeLast;   // DNS + TCP + TLS setup time of the last attempt: its longest Blynk.run()
+  uint32_t handshakeMin;
+  uint32_t handshakeMax;
+  uint32_t handshakeTotal;  // Sum over successful connections, for the average
+  uint32_t loginLast;       // Blynk login round-trip of the last connection
+} cloudStats;
+
 // Function to handle connecting to the Blynk cloud
 void enterConnectCloud() {
   BlynkState::set(MODE_CONNECTING_CLOUD);
 
   // Configure Blynk connection settings
   Blynk.config(configStore.cloudToken, configStore.cloudHost, configStore.cloudPort);
+
+  // Blynk.connect(0) only asks for a connection. A later Blynk.run() resolves
+  // the host, opens the socket, brings up TLS and sends the login in one
+  // blocking call; the calls after it just poll for the login reply. The
+  // longest run() is therefore the handshake, and the rest is the login.
   Blynk.connect(0);
+  uint32_t handshakeEnd = millis();
+  cloudStats.handshakeLast = 0;
 
   unsigned long timeoutMs = millis() + WIFI_CLOUD_CONNECT_TIMEOUT;
   while ((timeoutMs > millis()) &&
@@ -515,7 +734,13 @@ void enterConnectCloud() {
         (Blynk.connected() == false))
   {
     delay(10);
+    const uint32_t runStart = millis();
     Blynk.run();
+    const uint32_t runEnd = millis();
+    if (runEnd - runStart > cloudStats.handshakeLast) {
+      cloudStats.handshakeLast = runEnd - runStart;
+      handshakeEnd = runEnd;
+    }
     app_loop();
     if (!BlynkState::is(MODE_CONNECTING_CLOUD)) {
       Blynk.disconnect();
@@ -526,6 +751,9 @@ void enterConnectCloud() {
   if (millis() > timeoutMs) {
     DEBUG_PRINT("Timeout");
   }
+  if (!Blynk.connected()) {
+    cloudStats.failures++;
+  }
 
   // Check connection status
   if (Blynk.isTokenInvalid()) {
@@ -537,6 +765,22 @@ void enterConnectCloud() {
     BlynkState::set(MODE_RUNNING);
     connectBlynkRetries = WIFI_CLOUD_MAX_RETRIES;
 
+    cloudStats.connects++;
+    cloudStats.loginLast = millis() - handshakeEnd;
+    cloudStats.handshakeTotal += cloudStats.handshakeLast;
+    if (cloudStats.connects == 1 || cloudStats.handshakeLast < cloudStats.handshakeMin) {
+      cloudStats.handshakeMin = cloudStats.handshakeLast;
+    }
+    cloudStats.handshakeMax = BlynkMax(cloudStats.handshakeMax, cloudStats.handshakeLast);
+    DEBUG_PRINTF("Cloud connected: handshake %u ms, login %u ms",
+                 cloudStats.handshakeLast, cloudStats.loginLast);
+
+    if (!bootTimeToCloud) {
+      bootTimeToCloud = millis();
+      DEBUG_PRINTF("Time to cloud: %u ms", bootTimeToCloud);
+      heap_profiler_baseline();  // Steady state from here on
+    }
+
     if (!configStore.getFlag(CONFIG_FLAG_VALID)) {
       configStore.last_error = BLYNK_PROV_ERR_NONE;
       configStore.setFlag(CONFIG_FLAG_VALID, true);
@@ -1,6 +1,7 @@
 // Configuration flags for validation and static IP configuration
 #define CONFIG_FLAG_VALID       0x01
 #define CONFIG_FLAG_STATIC_IP   0x02
+#define CONFIG_FLAG_NET_CACHE   0x04   // netBSSID/netChannel/lease hold the last good connection
 
 // Provisioning error codes
 #define BLYNK_PROV_ERR_NONE     0      // No error
@@ -31,6 +32,17 @@ struct ConfigStore {
 
   int       last_error;     // Last error code
 
+  uint8_t   netBSSID[6];    // BSSID of the last AP that gave us an IP
+  uint8_t   netChannel;     // Channel of that AP
+  uint32_t  netIP;          // Last DHCP lease: address
+  uint32_t  netMask;        // Last DHCP lease: subnet mask
+  uint32_t  netGW;          // Last DHCP lease: gateway
+  uint32_t  netDNS;         // Last DHCP lease: DNS server
+
+  char      wifiAltSSID[CONFIG_WIFI_ALT_MAX][34];  // Fallback networks, in priority order
+  char      wifiAltPass[CONFIG_WIFI_ALT_MAX][64];
+  uint8_t   netSlot;        // Network slot of the cached AP (0 = wifiSSID, 1.. = wifiAltSSID)
+
   // Method to set a configuration flag
   void setFlag(uint8_t mask, bool value) {
     if (value) {
@@ -71,6 +83,13 @@ void CopyString(const String& s, T(&arr)[size]) {
   s.toCharArray(arr, size);
 }
 
+// Template function to copy a C string into a fixed-size array, without a temporary String
+template<typename T, int size>
+void CopyString(const char* s, T(&arr)[size]) {
+  strncpy(arr, s, size - 1);
+  arr[size - 1] = '\0';
+}
+
 // Function to load configuration from Blynk options
 static bool config_load_blnkopt() {
   static const char blnkopt[] = "blnkopt\0"
@@ -151,6 +170,35 @@ void enterResetConfig() {
   BlynkState::set(MODE_WAIT_CONFIG); // Set state to wait for configuration
 }
 
+// Function to remember the AP and lease of a successful connection,
+// so the next connect can skip the channel scan (see enterConnectNet)
+void config_save_net_cache(uint8_t slot, const uint8_t* bssid, uint8_t channel,
+                           uint32_t ip, uint32_t mask, uint32_t gw, uint32_t dns)
+{
+  // Only cache for a provisioned device, and only touch flash when something changed
+  if (!configStore.getFlag(CONFIG_FLAG_VALID) || !bssid) {
+    return;
+  }
+  if (configStore.getFlag(CONFIG_FLAG_NET_CACHE) &&
+      configStore.netSlot == slot &&
+      !memcmp(configStore.netBSSID, bssid, sizeof(configStore.netBSSID)) &&
+      configStore.netChannel == channel &&
+      configStore.netIP == ip && configStore.netMask == mask &&
+      configStore.netGW == gw && configStore.netDNS == dns)
+  {
+    return;
+  }
+  configStore.netSlot = slot;
+  memcpy(configStore.netBSSID, bssid, sizeof(configStore.netBSSID));
+  configStore.netChannel = channel;
+  configStore.netIP   = ip;
+  configStore.netMask = mask;
+  configStore.netGW   = gw;
+  configStore.netDNS  = dns;
+  configStore.setFlag(CONFIG_FLAG_NET_CACHE, true);
+  config_save();
+}
+
 // Function to set the last error code
 void config_set_last_error(int error) {
   // Only set error if not provisioned
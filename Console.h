@@ -9,6 +9,28 @@ extern "C" {
 // Initialize the Blynk console for debugging and command input
 BlynkConsole edgentConsole;
 
+// Function to stream a JSON chunk to the console
+static
+void console_json_sink(void*, const char* data, size_t) {
+  edgentConsole.print(data);
+}
+
+// Function to save a change to the network list and report the outcome, or why it was refused
+static
+void wifi_slot_report(int err) {
+  char buff[128];
+  JsonWriter json(buff, sizeof(buff), console_json_sink);
+  json.beginObject();
+  if (err) {
+    json.field("status", "error").field("msg", wifi_slot_error(err));
+  } else if (!config_save()) {
+    json.field("status", "error").field("msg", "config write failed");
+  } else {
+    json.field("status", "ok");
+  }
+  json.endObject().raw("\n");
+}
+
 // Function to initialize the console and set up commands
 void console_init()
 {
@@ -38,14 +60,15 @@ void console_init()
 
   // Add a command to display device information
   edgentConsole.addCommand("devinfo", []() {
-    edgentConsole.printf(
-        R"json({"name":"%s","board":"%s","tmpl_id":"%s","fw_type":"%s","fw_ver":"%s"})json" "\n",
-        getWiFiName().c_str(),  // Get Wi-Fi name
-        BLYNK_TEMPLATE_NAME,    // Template name
-        BLYNK_TEMPLATE_ID,      // Template ID
-        BLYNK_FIRMWARE_TYPE,    // Firmware type
-        BLYNK_FIRMWARE_VERSION  // Firmware version
-    );
+    char buff[128];
+    JsonWriter json(buff, sizeof(buff), console_json_sink);
+    json.beginObject()
+      .field("name",    getWiFiName())          // Wi-Fi name
+      .field("board",   BLYNK_TEMPLATE_NAME)    // Template name
+      .field("tmpl_id", BLYNK_TEMPLATE_ID)      // Template ID
+      .field("fw_type", BLYNK_FIRMWARE_TYPE)    // Firmware type
+      .field("fw_ver",  BLYNK_FIRMWARE_VERSION) // Firmware version
+    .endObject().raw("\n");
   });
 
   // Add a command to connect to Wi-Fi using provided credentials
@@ -54,11 +77,11 @@ void console_init()
       edgentConsole.print(R"json({"status":"error","msg":"invalid arguments. expected: <auth> <ssid> <pass>"})json" "\n");
       return;
     }
-    String auth = argv[0];
-    String ssid = argv[1];
-    String pass = (argc >= 3) ? argv[2] : "";
+    const char* auth = argv[0];
+    const char* ssid = argv[1];
+    const char* pass = (argc >= 3) ? argv[2] : "";
 
-    if (auth.length() != 32) {
+    if (strlen(auth) != 32) {
       edgentConsole.print(R"json({"status":"error","msg":"invalid token size"})json" "\n");
       return;
     }
@@ -98,6 +121,22 @@ void console_init()
         );
       }
       WiFi.scanDelete(); // Clear the scan results
+    } else if (0 == strcmp(argv[0], "list")) {
+      for (int slot = 0; slot < WIFI_SLOT_COUNT; slot++) {
+        if (wifi_slot_ssid(slot)[0]) {
+          edgentConsole.printf("%d %s\n", slot, wifi_slot_ssid(slot));
+        }
+      }
+      for (int i = 0; i < knownAPCount; i++) {
+        edgentConsole.printf("  [%s] ch:%d rssi:%d slot:%d\n",
+            macToString(knownAPs[i].bssid).c_str(), knownAPs[i].channel,
+            knownAPs[i].rssi, knownAPs[i].slot);
+      }
+    } else if (0 == strcmp(argv[0], "add") && argc >= 2) {
+      const int slot = wifi_slot_add(argv[1], (argc >= 3) ? argv[2] : "");
+      wifi_slot_report(slot < 0 ? slot : 0);
+    } else if (0 == strcmp(argv[0], "forget") && argc >= 2) {
+      wifi_slot_report(wifi_slot_forget(argv[1]));
     }
   });
 
@@ -117,16 +156,138 @@ void console_init()
         edgentConsole.printf(" App MD5:   %s\n", ESP.getSketchMD5().c_str());
       }
 
+      if (otaStats.magic == OTA_STATS_MAGIC) {
+        edgentConsole.printf(" Last OTA:  %s, %u bytes in, %u bytes out, %u ms, %u resumes\n",
+                             ota_encoding_str(otaStats.encoding), otaStats.bytesIn,
+                             otaStats.bytesOut, otaStats.totalMs, otaStats.resumes);
+      }
+
     } else if (0 == strcmp(argv[0], "rollback")) {
       if (Update.rollBack()) {
         edgentConsole.print(R"json({"status":"ok"})json" "\n");
-        edgentTimer.setTimeout(50, restartMCU); // Restart MCU after a short delay
+        timer_once(50, restartMCU); // Restart MCU after a short delay
       } else {
         edgentConsole.print(R"json({"status":"error"})json" "\n");
       }
     }
   });
 
+  // Add a command to start, cancel or check a background OTA update
+  edgentConsole.addCommand("ota", [](int argc, const char** argv) {
+    if (argc >= 2 && 0 == strcmp(argv[0], "start")) {
+      edgentConsole.print(ota_start(argv[1]) ? R"json({"status":"OK"})json" "\n"
+                                              : R"json({"status":"error","msg":"OTA already running"})json" "\n");
+    } else if (argc >= 1 && 0 == strcmp(argv[0], "cancel")) {
+      ota_cancel();
+    } else {
+      edgentConsole.printf(" State:     %s\n", ota_state_str(otaJob.state));
+      if (otaJob.state == OTA_DOWNLOADING) {
+        edgentConsole.printf(" Progress:  %u / %u bytes, %u B/s, %u resumes\n",
+                             otaJob.received, otaJob.total, ota_rate(), otaStats.resumes);
+      } else if (otaJob.error) {
+        edgentConsole.printf(" Error:     %s\n", otaJob.error);
+      }
+    }
+  });
+
+  // Add a command to dump (or reset) the timing histograms
+  edgentConsole.addCommand("perf", [](int argc, const char** argv) {
+    if (argc >= 1 && 0 == strcmp(argv[0], "reset")) {
+      profiler_reset();
+      return;
+    }
+    edgentConsole.printf("%-12s %8s %8s %8s %8s %8s us\n", "section", "count", "avg", "p50", "p99", "max");
+    for (int i = 0; i < PROF_SECTION_MAX; i++) {
+      const ProfHistogram& h = profHist[i];
+      if (h.count) {
+        edgentConsole.printf("%-12s %8u %8u %8u %8u %8u\n", profSectionNames[i], h.count,
+                             (uint32_t)(h.totalUs / h.count), profiler_percentile(i, 50),
+                             profiler_percentile(i, 99), h.maxUs);
+      }
+    }
+  });
+
+#ifdef TRACE_ENABLE
+  // Add a command to dump (or clear) the trace buffers
+  edgentConsole.addCommand("trace", [](int argc, const char** argv) {
+    if (argc >= 1 && 0 == strcmp(argv[0], "clear")) {
+      trace_clear();
+    } else {
+      trace_dump(edgentConsole);
+    }
+  });
+#endif
+
+  // Add a command to run the microbenchmarks
+  edgentConsole.addCommand("bench", bench_command);
+
+  // Add a command to display the power profile residency and estimated charge
+  edgentConsole.addCommand("power", power_command);
+
+  // Add a command to display the lock state and its last transitions
+  edgentConsole.addCommand("lock", lock_command);
+
+  // Add a command to display the ultrasonic filter counters, or its raw echoes with "range trace"
+  edgentConsole.addCommand("range", range_command);
+
+#ifdef TELEMETRY_ENABLE
+  // Add a command to display the telemetry counters
+  edgentConsole.addCommand("telemetry", telemetry_command);
+#endif
+
+#ifdef MOTION_ENABLE
+  // Add a command to display the motion detector counters, or the changed blocks with "motion map"
+  edgentConsole.addCommand("motion", motion_command);
+#endif
+
+#if defined(LOCKER_BANK)
+  // Add a command to display every compartment of the locker bank, with the scan rates
+  edgentConsole.addCommand("bank", bank_command);
+#endif
+
+  // Add a command to display the boot phases
+  edgentConsole.addCommand("boot", []() {
+    boot_report(edgentConsole);
+  });
+
+  // Add a command to display (or reset) the loop stall statistics
+  edgentConsole.addCommand("wdt", [](int argc, const char** argv) {
+    if (argc >= 1 && 0 == strcmp(argv[0], "reset")) {
+      loop_watchdog_reset();
+      return;
+    }
+    edgentConsole.printf(" Budget:          %u ms (longest pass since boot %u ms)\n",
+                         LOOP_WD_BUDGET, loopWdMaxPeriod / 1000);
+    edgentConsole.printf(" Stalls:          %u (%u ended in a reset)\n", loopWd.stalls, loopWd.resetsInStall);
+    for (int i = 0; i < PROF_SECTION_MAX; i++) {
+      if (loopWd.sectionStalls[i]) {
+        edgentConsole.printf("   %-14s %5u  max %u ms\n", profSectionNames[i],
+                             loopWd.sectionStalls[i], loopWd.sectionMaxUs[i] / 1000);
+      }
+    }
+    for (int i = 0; i < LOOP_WD_WORST_MAX && loopWd.worst[i].us; i++) {
+      loop_watchdog_print(edgentConsole, loopWd.worst[i]);
+    }
+  });
+
+  // Add a command to display heap fragmentation, or profile allocations by call site
+  edgentConsole.addCommand("heap", [](int argc, const char** argv) {
+    heap_profiler_command(edgentConsole, argc, argv);
+  });
+
+  // Add a command to display the state of the log buffer
+  edgentConsole.addCommand("log", []() {
+    edgentConsole.printf(" Level:           %d (%s)\n", LOG_LEVEL,
+#ifdef LOG_OUTPUT_BINARY
+                         "binary"
+#else
+                         "text"
+#endif
+                         );
+    edgentConsole.printf(" Buffered:        %u / %u bytes\n", logHead - logTail, LOG_RING_SIZE);
+    edgentConsole.printf(" Written:         %u bytes (%u records dropped)\n", logHead, logDropped);
+  });
+
   // Add a command to display system status
   edgentConsole.addCommand("status", [](int argc, const char** argv) {
     const int64_t t = esp_timer_get_time() / 1000000;
@@ -145,12 +306,41 @@ void console_init()
     if (ESP.getPsramSize()) {
       edgentConsole.printf(" PSRAM free:      %d / %d\n", ESP.getFreePsram(), ESP.getPsramSize());
     }
+    if (bootTimeToIP) {
+      edgentConsole.printf(" Time to IP:      %u ms (%s)\n", bootTimeToIP, bootFastConnect ? "fast" : "scan");
+    }
+    if (bootTimeToCloud) {
+      edgentConsole.printf(" Time to cloud:   %u ms\n",    bootTimeToCloud);
+    }
 #ifdef BLYNK_FS
     uint32_t fs_total = BLYNK_FS.totalBytes();
     edgentConsole.printf(" FS free:         %d / %d\n",   (fs_total-BLYNK_FS.usedBytes()), fs_total);
 #endif
   });
 
+  // Add a command to display cloud connection statistics
+  edgentConsole.addCommand("cloud", []() {
+    const CloudStats& cs = cloudStats;
+    edgentConsole.printf(" Host:            %s:%d\n", configStore.cloudHost, configStore.cloudPort);
+    edgentConsole.printf(" Connects:        %u (failed %u)\n", cs.connects, cs.failures);
+    if (cs.connects) {
+      edgentConsole.printf(" Handshake:       last %u, min %u, avg %u, max %u ms\n",
+                           cs.handshakeLast, cs.handshakeMin, cs.handshakeTotal / cs.connects, cs.handshakeMax);
+      edgentConsole.printf(" Login:           %u ms\n", cs.loginLast);
+    }
+  });
+
+  // Add a command to display config portal response times
+  edgentConsole.addCommand("portal", []() {
+    for (int i = 0; i < portalStatCount; i++) {
+      const PortalStat& st = portalStats[i];
+      if (st.count) {
+        edgentConsole.printf("%-18s %5u req  ttfb last %6u  avg %6u  max %6u us\n",
+                             st.uri, st.count, st.lastUs, st.totalUs / st.count, st.maxUs);
+      }
+    }
+  });
+
 #ifdef BLYNK_FS
 
   // Add a command to list files in the file system
@@ -237,6 +427,7 @@ void console_init()
 
 // Handle commands sent to the internal debug pin
 BLYNK_WRITE(InternalPinDBG) {
-  String cmd = String(param.asStr()) + "\n";
+  FixedString<128> cmd = param.asStr();
+  cmd += '\n';
   edgentConsole.runCommand((char*)cmd.c_str());
 }
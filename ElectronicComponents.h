@@ -1,5 +1,8 @@
 #include <ESP32Servo.h>  // For servo moter
-#include <LiquidCrystal.h>  // For LCD1602
+#include "FastLCD.h"  // For LCD1602
+#include "RangeFilter.h"  // Filters the ultrasonic readings
+#include "Telemetry.h"  // Binary stream of the samples, for tuning
+#include "MotionDetect.h"  // Motion in the camera frames, for when there is no GPS
 
 // Pin configuration
 const int trigPin = 2;  // Ultrasonic trig pin
@@ -16,9 +19,25 @@ extern bool lockState;   // Indicates the locked state.
 extern bool inGeofence; // Indicates whether the delivery person is within the geofence area.
 extern bool isV4On;      // Indicates whether the system is active.
 extern bool isV0On;      // Indicates whether email notifications are active.
+extern double latitude_delivery;   // Delivery person's location, 0 until their phone reports it
+extern double longitude_delivery;
 
 // Ultrasonic Sensor Variables
-float duration, distance;
+const float maxDistance = RANGE_MAX_CM;  // Beyond the range of the sensor: reported until the readings agree
+float duration, distance = maxDistance;  // Last echo (us) and filtered distance (cm)
+GpioPulse echoPulse;  // Echo pulses, timed by the GPIO event queue
+TimerId pingTimer = 0;  // Pings the sensor while the box is locked
+const long pingInterval = 60; // Time between pings, so an echo never overlaps the next ping
+bool pingSent = false;  // A ping is out, its echo is read on the next one
+int pingsLeft = RANGE_BURST;  // Pings left in the current burst
+RangeFilter rangeFilter;  // Median/EMA filter over the readings
+RangeSample rangeSample = { maxDistance, 0, 0, 0 };  // Last filtered reading
+uint16_t rangeTrace[RANGE_TRACE_MAX];  // Last raw echoes (us, 0 for none), for the "range" command
+uint32_t rangeTraceCount = 0;
+const float unlockDistance = RANGE_UNLOCK_CM;  // A parcel closer than this (cm) unlocks the box
+
+// Delivery button
+GpioButton deliveryButton;  // Debounced state of the button
 
 // Servo Motor Setup
 Servo myservo;
@@ -29,20 +48,182 @@ int maxAngle = 180;    // Maximum angle
 int minAngle = 0;      // Minimum angle
 int angleStep = 1;     // Step size for the servo movement
 
-unsigned long previousMillis = 0;
+uint64_t previousMillis = 0;  // timer_now() of the last servo step
 const long interval = 5; // Adjust this value to control the speed (smaller is faster)
-unsigned long buttonPressedTime = 0;
+TimerId servoTimer = 0;  // Steps the servo while it moves
 const long lockDelay = 10000; // 10 seconds delay
-unsigned long previousSerialMillis = 0;
+TimerId relockTimer = 0; // One-shot timer that relocks the box once it has been closed for lockDelay
+TimerId statusTimer = 0; // Logs the readings while the components are active
 const long serialInterval = 2000; // 2.0 second interval for serial output
 
 // Initialize the library with the numbers of the interface pins
-LiquidCrystal lcd(rs, en, d4, d5, d6, d7);
+#if defined(LCD_I2C_ADDR)
+FastLCD lcd(LCD_I2C_ADDR);
+#else
+FastLCD lcd(rs, en, d4, d5, d6, d7);
+#endif
+
+/*
+ * Lock state machine.
+ *
+ * The lock only changes state on typed events, and what each change does is
+ * one row of lockTable. Events come from the door button (its debounced
+ * edges), the ultrasonic sensor (a confident filtered reading closer than
+ * unlockDistance), the servo (done moving), a one-shot relock timer, and the
+ * enable condition (system on and delivery person inside the geofence, or,
+ * with no location from their phone, motion in front of the camera). Nothing
+ * is re-derived on every loop pass: with no event, the machine costs nothing.
+ *
+ * A disable while the box is open does not strand it: the delivery finishes,
+ * the box relocks, and the disable is applied once it is locked.
+ */
+
+enum LockState : uint8_t {
+  LOCK_DISABLED,         // System off or nobody nearby: locked, sensor and LCD off
+  LOCK_LOCKED,           // Locked, waiting for a parcel in front of the sensor
+  LOCK_UNLOCKING,        // Servo moving to the unlocked position
+  LOCK_UNLOCKED_CLOSED,  // Unlocked with the door closed: relocks after lockDelay
+  LOCK_OPEN,             // Unlocked with the door open
+  LOCK_RELOCKING,        // Servo moving to the locked position
+  LOCK_STATE_MAX
+};
+
+enum LockEvent : uint8_t {
+  LOCK_EV_ENABLE,        // System on and delivery person inside the geofence (or motion, without GPS)
+  LOCK_EV_DISABLE,       // System turned off remotely, or the delivery person left
+  LOCK_EV_NEAR,          // A parcel is confidently closer than unlockDistance
+  LOCK_EV_DOOR_OPEN,
+  LOCK_EV_DOOR_CLOSED,
+  LOCK_EV_TIMEOUT,       // The relock timer expired
+  LOCK_EV_SERVO_DONE,    // The servo reached its target angle
+  LOCK_EVENT_MAX
+};
+
+static const char* const lockStateNames[LOCK_STATE_MAX] = {
+  "disabled", "locked", "unlocking", "unlocked", "open", "relocking",
+};
+
+static const char* const lockEventNames[LOCK_EVENT_MAX] = {
+  "enable", "disable", "near", "door-open", "door-closed", "timeout", "servo-done",
+};
+
+typedef void (*LockAction)();
+
+struct LockTransition {
+  LockState  from;
+  LockEvent  event;
+  LockState  to;
+  LockAction action;  // Run after the state has changed, may be NULL
+};
+
+struct LockRecord {
+  uint32_t ms;         // millis() at the transition
+  uint32_t inStateMs;  // Time spent in the state that was left
+  uint8_t  from;
+  uint8_t  to;
+  uint8_t  event;
+};
+
+struct LockFsm {
+  LockState  state;
+  uint32_t   enteredMs;    // millis() when the current state was entered
+  bool       enabled;      // Last enable condition seen
+  uint32_t   transitions;
+  uint32_t   ignored;      // Events with no row for the current state
+  LockRecord history[LOCK_HISTORY];
+};
+
+static LockFsm lockFsm = { LOCK_DISABLED, 0, false, 0, 0, };
+
+static void lockEnable();
+static void lockDisable();
+static void lockUnlock();
+static void lockRelock();
+static void lockBackOff();
+static void lockRelocked();
+static void startRelockTimer();
+static void stopRelockTimer();
+
+static constexpr LockTransition lockTable[] = {
+  { LOCK_DISABLED,        LOCK_EV_ENABLE,      LOCK_LOCKED,          lockEnable       },
+  { LOCK_LOCKED,          LOCK_EV_DISABLE,     LOCK_DISABLED,        lockDisable      },
+  { LOCK_LOCKED,          LOCK_EV_NEAR,        LOCK_UNLOCKING,       lockUnlock       },
+  { LOCK_UNLOCKING,       LOCK_EV_SERVO_DONE,  LOCK_UNLOCKED_CLOSED, startRelockTimer },
+  { LOCK_UNLOCKING,       LOCK_EV_DOOR_OPEN,   LOCK_OPEN,            NULL             },
+  { LOCK_UNLOCKED_CLOSED, LOCK_EV_DOOR_OPEN,   LOCK_OPEN,            stopRelockTimer  },
+  { LOCK_UNLOCKED_CLOSED, LOCK_EV_TIMEOUT,     LOCK_RELOCKING,       lockRelock       },
+  { LOCK_OPEN,            LOCK_EV_DOOR_CLOSED, LOCK_UNLOCKED_CLOSED, startRelockTimer },
+  { LOCK_RELOCKING,       LOCK_EV_SERVO_DONE,  LOCK_LOCKED,          lockRelocked     },
+  { LOCK_RELOCKING,       LOCK_EV_DOOR_OPEN,   LOCK_OPEN,            lockBackOff      },
+};
+
+// Function to find the row of lockTable for an event in a state, NULL if the event does not apply
+const LockTransition* lock_transition(LockState from, LockEvent ev) {
+  for (const LockTransition& row : lockTable) {
+    if (row.from == from && row.event == ev) {
+      return &row;
+    }
+  }
+  return NULL;
+}
+
+// Function to feed an event to the lock state machine
+void lock_dispatch(LockEvent ev) {
+  const LockState from = lockFsm.state;
+  const LockTransition* t = lock_transition(from, ev);
+  if (!t) {
+    lockFsm.ignored++;
+    return;
+  }
+
+  const uint32_t now = millis();
+  LockRecord& rec = lockFsm.history[lockFsm.transitions++ % LOCK_HISTORY];
+  rec.ms        = now;
+  rec.inStateMs = now - lockFsm.enteredMs;
+  rec.from      = from;
+  rec.to        = t->to;
+  rec.event     = ev;
+
+  lockFsm.state     = t->to;
+  lockFsm.enteredMs = now;
+  lockState = (t->to == LOCK_LOCKED || t->to == LOCK_DISABLED);
+
+  TRACE_INSTANT(TRACE_LOCK, (ev << 8) | t->to);
+  TELEMETRY(TELEMETRY_LOCK, 0, duration, distance, rangeSample.flags, rangeSample.confidence,
+            currentAngle, t->to);
+  LOG_I("Lock: %s -> %s on %s, after %u ms", lockStateNames[from], lockStateNames[t->to],
+        lockEventNames[ev], rec.inStateMs);
+
+  if (t->action) {
+    t->action();
+  }
+}
+
+// Function to handle the "lock" console command: the current state and the last transitions
+void lock_command(int, const char**) {
+  edgentConsole.printf(" State:           %s for %u ms (%u transitions, %u events ignored)\n",
+                       lockStateNames[lockFsm.state], millis() - lockFsm.enteredMs,
+                       lockFsm.transitions, lockFsm.ignored);
+  const uint32_t first = lockFsm.transitions > LOCK_HISTORY ? lockFsm.transitions - LOCK_HISTORY : 0;
+  for (uint32_t i = first; i < lockFsm.transitions; i++) {
+    const LockRecord& rec = lockFsm.history[i % LOCK_HISTORY];
+    edgentConsole.printf(" %10u  %-9s -> %-9s on %-11s after %u ms\n", rec.ms,
+                         lockStateNames[rec.from], lockStateNames[rec.to],
+                         lockEventNames[rec.event], rec.inStateMs);
+  }
+}
+
+// Function to track the door from the debounced button edges
+static
+void doorChanged(bool pressed, uint32_t) {
+  openState = pressed;
+  lock_dispatch(pressed ? LOCK_EV_DOOR_OPEN : LOCK_EV_DOOR_CLOSED);
+}
 
 void initializeElectronicComponents() {
   // Ultrasonic Sensor
   pinMode(trigPin, OUTPUT);
-  pinMode(echoPin, INPUT);
+  gpio_pulse_init(echoPulse, echoPin);  // Times the echo from its edges instead of blocking in pulseIn()
 
   // LED
   pinMode(LEDPin, OUTPUT);
@@ -50,8 +231,9 @@ void initializeElectronicComponents() {
   // Servo Motor
   myservo.attach(servoPin);
 
-  // Button
-  pinMode(buttonPin, INPUT_PULLUP);
+  // Button (active low, with pull-up)
+  gpio_button_init(deliveryButton, buttonPin, true, doorChanged);
+  openState = deliveryButton.pressed;
 
   // Initialize Servo Position
   myservo.write(currentAngle);
@@ -61,110 +243,231 @@ void initializeElectronicComponents() {
   digitalWrite(backlightPin, LOW);  // Turn off the backlight by default
 
   // Initialize LCD
-  lcd.begin(16, 2); // Set up the LCD's number of columns and rows
-  lcd.print("Lock State:"); // Initial message
+  lcd.begin(16, 2); // Set up the LCD's number of columns and rows; the lock state shows once enabled
 }
 
-void moveToTargetAngle();
+// Function to show the lock state on the LCD
+static
+void showLockState() {
+  PROFILE_SCOPE(PROF_LCD);
+  lcd.clear(); // Clear the display before printing a new message
+  lcd.setCursor(0, 0); // Move to the beginning of the first line
+  lcd.print("Lock State:"); // Display static message on the first line
+  lcd.setCursor(0, 1); // Move to the second line
+  if (lockState) {
+    lcd.print("Locked  ");
+  } else {
+    lcd.print("Unlocked");
+  }
+}
 
-void runElectronicComponents() {
-  // If the system is deactivated by the user or if the delivery person is outside the geofence, 
-  // do not activate the electronic components.
-  if (!isV0On || !inGeofence) {
-    // If V0 is OFF, clear the LCD and turn off the backlight
-    lcd.clear();
-    digitalWrite(backlightPin, LOW);  // Power off LCD
-    return;  // Exit the function early
+// Function to move the servo a step closer to the target angle, catching up on late calls
+static
+void stepServo() {
+  PROFILE_SCOPE(PROF_SERVO);
+
+  const uint64_t currentMillis = timer_now();
+  const int steps = (currentMillis - previousMillis) / interval;
+  previousMillis += steps * interval;
+
+  if (currentAngle > targetAngle) {
+    currentAngle = BlynkMax(currentAngle - steps * angleStep, targetAngle);
+  } else if (currentAngle < targetAngle) {
+    currentAngle = BlynkMin(currentAngle + steps * angleStep, targetAngle);
   }
+  myservo.write(currentAngle);
+  TELEMETRY(TELEMETRY_SERVO, 0, duration, distance, rangeSample.flags, rangeSample.confidence,
+            currentAngle, lockFsm.state);
 
-  // Power on LCD if isV0On is true
-  digitalWrite(backlightPin, HIGH);  // Turn on the backlight
+  if (currentAngle == targetAngle) {
+    timer_cancel(servoTimer);
+    TRACE_END(TRACE_SERVO, currentAngle);
+    lock_dispatch(LOCK_EV_SERVO_DONE);
+  }
+}
 
-  // Check button state
-  openState = digitalRead(buttonPin) == LOW;  // This is correct code.
+// Function to start moving the servo to targetAngle; it steps in the background and reports LOCK_EV_SERVO_DONE
+void moveToTargetAngle() {
+  if (!servoTimer) {
+    TRACE_BEGIN(TRACE_SERVO, targetAngle);
+    previousMillis = timer_now();
+    servoTimer = timer_every(interval, stepServo);
+  }
+}
+
+// Function to tell whether the components should be active: the system is on, and the delivery
+// person is inside the geofence or, while their phone has not reported a location, the camera saw motion
+bool components_enabled() {
+  const bool located = latitude_delivery != 0 || longitude_delivery != 0;
+  return isV0On && (inGeofence || (!located && motion_recent(MOTION_HOLD)));
+}
+
+// Function to get the confidence a close reading needs to unlock: with the camera watching and no
+// motion in front of it, the whole window has to agree
+uint8_t unlock_confidence() {
+  return (motion_watching() && !motion_recent(MOTION_HOLD)) ? 100 : RANGE_CONFIDENT;
+}
+
+// Function to filter the echo of the last ping, and send the next one: back to back while something
+// is within RANGE_NEAR_CM, otherwise in bursts of RANGE_BURST pings every RANGE_BURST_GAP ms
+static
+void pingSensor() {
+  PROFILE_SCOPE(PROF_ULTRASONIC);
+  pingTimer = 0;
+  if (pingSent) {
+    uint32_t echoUs = 0;
+    gpio_pulse_take(echoPulse, echoUs);  // Stays 0 if no echo came back
+    duration = echoUs;
+    rangeTrace[rangeTraceCount++ % RANGE_TRACE_MAX] = BlynkMin(echoUs, (uint32_t)UINT16_MAX);
+    rangeSample = range_filter_add(rangeFilter, echoUs);
+    distance = rangeSample.cm;
+    TELEMETRY(TELEMETRY_RANGE, 0, echoUs, distance, rangeSample.flags, rangeSample.confidence,
+              currentAngle, lockFsm.state);
+    if (!openState && range_sample_closer(rangeSample, unlockDistance, unlock_confidence())) {
+      lock_dispatch(LOCK_EV_NEAR);
+      return;
+    }
+  }
 
-  // Ultrasonic Sensor Code
   digitalWrite(trigPin, LOW);
   delayMicroseconds(2);
   digitalWrite(trigPin, HIGH);
   delayMicroseconds(10);
   digitalWrite(trigPin, LOW);
+  pingSent = true;
 
-  duration = pulseIn(echoPin, HIGH);
-  distance = (duration * 0.0343) / 2;
+  uint32_t next = pingInterval;
+  if ((rangeSample.flags & RANGE_VALID) && rangeSample.cm < RANGE_NEAR_CM) {
+    pingsLeft = RANGE_BURST;
+  } else if (--pingsLeft <= 0) {
+    pingsLeft = RANGE_BURST;
+    next = RANGE_BURST_GAP;  // The echo waits in echoPulse until then
+  }
+  pingTimer = timer_once(next, pingSensor);
+}
 
-  // Logic to change to unlock state. 
-  // When unlock, take a camera and send image data to the server
-  if (!openState && lockState && distance < 10) {
-    lockState = false;
-    targetAngle = minAngle;  // Move to 0 degrees when unlocked
-    moveToTargetAngle();
+// Function to start pinging the sensor with no readings from before
+static
+void startPinging() {
+  uint32_t stale;
+  gpio_pulse_take(echoPulse, stale);
+  range_filter_reset(rangeFilter);
+  pingSent  = false;
+  pingsLeft = RANGE_BURST;
+  timer_cancel(pingTimer);
+  pingTimer = timer_once(0, pingSensor);
+}
 
-    // Send email notification to the user when box has been unlocked.
-    if (isV4On) {
-      Blynk.logEvent("unlock_state", "The device has unlocked.");
-      Serial.println("Notification: The box has been unlocked, and an email has been sent to the user.");
-    }
-  }
+// Function to stop pinging the sensor; the last reading goes stale
+static
+void stopPinging() {
+  timer_cancel(pingTimer);
+  distance    = maxDistance;
+  rangeSample = { maxDistance, 0, 0, 0 };
+}
 
-  if (!openState && !lockState) {
-    if (millis() - buttonPressedTime >= lockDelay) {
-      lockState = true;
-      targetAngle = maxAngle;  // Move to 180 degrees when locked
-      moveToTargetAngle();
+// Function to handle the "range" console command: the filter counters, or the raw echoes with "trace"
+void range_command(int argc, const char** argv) {
+  if (argc >= 1 && 0 == strcmp(argv[0], "trace")) {
+    const uint32_t first = rangeTraceCount > RANGE_TRACE_MAX ? rangeTraceCount - RANGE_TRACE_MAX : 0;
+    for (uint32_t i = first; i < rangeTraceCount; i++) {
+      edgentConsole.printf("%u\n", rangeTrace[i % RANGE_TRACE_MAX]);
     }
-  } else {
-    buttonPressedTime = millis();
+    return;
   }
+  edgentConsole.printf(" Distance:        %.1f cm (raw %.1f cm), confidence %u%%%s\n",
+                       rangeSample.cm, rangeSample.rawCm, rangeSample.confidence,
+                       (rangeSample.flags & RANGE_VALID) ? "" : ", not valid");
+  edgentConsole.printf(" Readings:        %u (%u no echo, %u out of range, %u outliers)\n",
+                       rangeFilter.samples, rangeFilter.noEcho, rangeFilter.outOfRange, rangeFilter.outliers);
+  edgentConsole.printf(" Pinging:         %s\n", !pingTimer ? "off" :
+                       ((rangeSample.flags & RANGE_VALID) && rangeSample.cm < RANGE_NEAR_CM) ? "fast" : "bursts");
+}
 
-  // LED is activated when box is unlocked
-  digitalWrite(LEDPin, lockState ? LOW : HIGH);  // LED is active when the pin is set to High
+// Function to log the readings, formatted for Serial Plotter
+static
+void logComponents() {
+  LOG_I("Distance: %.2f cm, Servo Angle: %d , Open State: %d , Lock State: %d",
+        distance, currentAngle, openState, lockState);
+}
 
-  // Display lock state on LCD
-  lcd.clear(); // Clear the display before printing a new message
-  lcd.setCursor(0, 0); // Move to the beginning of the first line
-  lcd.print("Lock State:"); // Display static message on the first line
-  lcd.setCursor(0, 1); // Move to the second line
-  if (lockState) {
-    lcd.print("Locked  ");
-  } else {
-    lcd.print("Unlocked");
+// Lock state machine actions
+
+static
+void lockEnable() {
+  digitalWrite(backlightPin, HIGH);  // Turn on the backlight
+  showLockState();
+  startPinging();
+  statusTimer = timer_every(serialInterval, logComponents);
+}
+
+static
+void lockDisable() {
+  lcd.clear();
+  digitalWrite(backlightPin, LOW);  // Power off LCD
+  stopPinging();
+  timer_cancel(statusTimer);
+}
+
+static
+void lockUnlock() {
+  stopPinging();  // Only a locked box needs the sensor
+  targetAngle = minAngle;  // Move to 0 degrees when unlocked
+  moveToTargetAngle();
+  digitalWrite(LEDPin, HIGH);  // LED is active when box is unlocked
+  showLockState();
+
+  // Send email notification to the user when box has been unlocked.
+  if (isV4On) {
+    Blynk.logEvent("unlock_state", "The device has unlocked.");
+    LOG_I("Notification: The box has been unlocked, and an email has been sent to the user.");
   }
+}
 
-  // Serial output formatted for Serial Plotter
-  unsigned long currentMillis = millis();
-  if (currentMillis - previousSerialMillis >= serialInterval) {
-    previousSerialMillis = currentMillis;
-    Serial.print("Distance: ");
-    Serial.print(distance);
-    Serial.print(" cm, Servo Angle: ");
-    Serial.print(currentAngle);
-    Serial.print(" , Open State: ");
-    Serial.print(openState);
-    Serial.print(" , Lock State: ");
-    Serial.println(lockState);
+static
+void lockRelock() {
+  targetAngle = maxAngle;  // Move to 180 degrees when locked
+  moveToTargetAngle();
+}
+
+static
+void lockBackOff() {
+  targetAngle = minAngle;  // The door was opened while relocking: pull the bolt back
+  moveToTargetAngle();
+}
+
+static
+void lockRelocked() {
+  digitalWrite(LEDPin, LOW);
+  showLockState();
+  startPinging();
+  if (!lockFsm.enabled) {
+    lock_dispatch(LOCK_EV_DISABLE);  // Deferred while the box was open
   }
 }
 
-void moveToTargetAngle() {
-  while (currentAngle != targetAngle) {
-    unsigned long currentMillis = millis();
-    if (currentMillis - previousMillis >= interval) {
-      previousMillis = currentMillis;
-
-      if (currentAngle > targetAngle) {
-        currentAngle -= angleStep;
-        if (currentAngle < targetAngle) {
-          currentAngle = targetAngle;
-        }
-      } else if (currentAngle < targetAngle) {
-        currentAngle += angleStep;
-        if (currentAngle > targetAngle) {
-          currentAngle = targetAngle;
-        }
-      }
-
-      myservo.write(currentAngle);
-    }
+static
+void startRelockTimer() {
+  stopRelockTimer();
+  relockTimer = timer_once(lockDelay, []() {
+    relockTimer = 0;
+    lock_dispatch(LOCK_EV_TIMEOUT);
+  });
+}
+
+static
+void stopRelockTimer() {
+  timer_cancel(relockTimer);
+}
+
+void runElectronicComponents() {
+  PROFILE_SCOPE(PROF_COMPONENTS);
+  TRACE_SCOPE(TRACE_COMPONENTS, 0);
+
+  // The components are active only while the system is on and the delivery person is nearby
+  const bool enabled = components_enabled();
+  if (enabled != lockFsm.enabled) {
+    lockFsm.enabled = enabled;
+    lock_dispatch(enabled ? LOCK_EV_ENABLE : LOCK_EV_DISABLE);
   }
 }
@@ -0,0 +1,239 @@
+#include "soc/gpio_struct.h"
+#include "esp_timer.h"
+#if defined(LCD_I2C_ADDR)
+  #include <Wire.h>
+  static_assert(!camera_pin(I2C_SDA_PIN) && !camera_pin(I2C_SCL_PIN),
+                "The LCD I2C pins are taken by the camera, see camera_pins.h");
+#endif
+
+/*
+ * HD44780 character LCD driver, in place of LiquidCrystal.
+ *
+ * On the 4-bit bus, a nibble is one write to the GPIO set and clear
+ * registers for the data pins (both banks, for pins 32 and up), then a 1 us
+ * enable pulse. RW is tied low, so the busy flag cannot be read: instead the
+ * driver remembers when the controller will be done with the last byte
+ * (LCD_EXEC_US, or LCD_CLEAR_US after a clear) and only waits for that when
+ * the next byte comes. A clear() returns at once, and a byte costs its
+ * execution time instead of LiquidCrystal's fixed 100 us plus a digitalWrite()
+ * per pin.
+ *
+ * With LCD_I2C_ADDR, it drives a PCF8574 backpack instead (P0 RS, P2 E,
+ * P3 backlight, P4-P7 D4-D7): a string goes out as one I2C burst, each
+ * nibble two bytes (enable high, then low). At 400 kHz a character takes
+ * longer on the bus than in the controller, so only clear and home wait.
+ */
+
+#define LCD_CMD_CLEAR        0x01
+#define LCD_CMD_HOME         0x02
+#define LCD_CMD_ENTRY_MODE   0x06  // Increment, no shift
+#define LCD_CMD_DISPLAY_ON   0x0C  // Display on, cursor off, blink off
+#define LCD_CMD_FUNCTION_4B  0x28  // 4-bit bus, 2 lines, 5x8 dots
+#define LCD_CMD_DDRAM        0x80
+
+#define LCD_I2C_RS           0x01
+#define LCD_I2C_EN           0x04
+#define LCD_I2C_BACKLIGHT    0x08
+#define LCD_I2C_BURST        120   // Bytes per I2C transmission, within the Wire buffer
+
+class FastLCD : public Print {
+public:
+  // 4-bit bus on GPIOs
+  FastLCD(uint8_t rs, uint8_t en, uint8_t d4, uint8_t d5, uint8_t d6, uint8_t d7)
+    : m_Rs(rs), m_En(en), m_I2c(0), m_Cols(16), m_Rows(2), m_ReadyUs(0)
+  {
+    const uint8_t data[4] = { d4, d5, d6, d7 };
+    for (int n = 0; n < 16; n++) {
+      m_Set[n][0] = m_Set[n][1] = 0;
+      for (int b = 0; b < 4; b++) {
+        if (n & (1 << b)) {
+          m_Set[n][data[b] / 32] |= 1UL << (data[b] % 32);
+        }
+      }
+    }
+    m_Data[0] = m_Set[15][0];
+    m_Data[1] = m_Set[15][1];
+    m_Pins[0] = rs; m_Pins[1] = en;
+    for (int b = 0; b < 4; b++) {
+      m_Pins[2 + b] = data[b];
+    }
+  }
+
+  // PCF8574 I2C backpack
+  FastLCD(uint8_t i2cAddr) : m_Rs(0), m_En(0), m_I2c(i2cAddr), m_Cols(16), m_Rows(2), m_ReadyUs(0) {}
+
+  // Function to set up the pins and the controller
+  void begin(uint8_t cols, uint8_t rows) {
+    m_Cols = cols;
+    m_Rows = rows;
+    if (m_I2c) {
+#if defined(LCD_I2C_ADDR)
+      Wire.begin(I2C_SDA_PIN, I2C_SCL_PIN);  // Also the bus of the locker-bank expanders, if any
+      Wire.setClock(400000);
+#endif
+    } else {
+      for (uint8_t pin : m_Pins) {
+        pinMode(pin, OUTPUT);
+        digitalWrite(pin, LOW);
+      }
+    }
+
+    // Reset into 4-bit mode, whatever mode it was left in (HD44780 datasheet, figure 24)
+    delay(50);
+    nibble(0x3, false);
+    delayMicroseconds(4500);
+    nibble(0x3, false);
+    delayMicroseconds(4500);
+    nibble(0x3, false);
+    delayMicroseconds(150);
+    nibble(0x2, false);
+    delayMicroseconds(LCD_EXEC_US);
+
+    command(LCD_CMD_FUNCTION_4B);
+    command(LCD_CMD_DISPLAY_ON);
+    clear();
+    command(LCD_CMD_ENTRY_MODE);
+  }
+
+  // Function to clear the screen; the next write waits for it, not this call
+  void clear() {
+    command(LCD_CMD_CLEAR);
+    m_ReadyUs += LCD_CLEAR_US - LCD_EXEC_US;
+  }
+
+  void home() {
+    command(LCD_CMD_HOME);
+    m_ReadyUs += LCD_CLEAR_US - LCD_EXEC_US;
+  }
+
+  // Function to move to a cell, for the next characters
+  void setCursor(uint8_t col, uint8_t row) {
+    static const uint8_t rowStart[4] = { 0x00, 0x40, 0x14, 0x54 };
+    if (row >= m_Rows) {
+      row = m_Rows - 1;
+    }
+    command(LCD_CMD_DDRAM | (col + rowStart[row & 3]));
+  }
+
+  size_t write(uint8_t c) override {
+    return write(&c, 1);
+  }
+
+  // Function to write characters at the cursor; print() comes from Print
+  size_t write(const uint8_t* buf, size_t len) override {
+    if (m_I2c) {
+      sendI2c(buf, len, true);
+    } else {
+      for (size_t i = 0; i < len; i++) {
+        send(buf[i], true);
+      }
+    }
+    return len;
+  }
+
+  using Print::write;
+
+private:
+  void command(uint8_t cmd) {
+    if (m_I2c) {
+      sendI2c(&cmd, 1, false);
+    } else {
+      send(cmd, false);
+    }
+  }
+
+  // Function to wait until the controller is done with the last byte
+  void waitReady() {
+    while (esp_timer_get_time() < m_ReadyUs) {
+    }
+  }
+
+  // Function to put a byte on the 4-bit bus, high nibble first
+  void send(uint8_t value, bool data) {
+    waitReady();
+    if (data) {
+      setPin(m_Rs);
+    } else {
+      clearPin(m_Rs);
+    }
+    nibble(value >> 4, data);
+    nibble(value & 0xF, data);
+    m_ReadyUs = esp_timer_get_time() + LCD_EXEC_US;
+  }
+
+  // Function to latch one nibble: the data pins in one write per bank, then the enable pulse
+  void nibble(uint8_t n, bool data) {
+#if defined(LCD_I2C_ADDR)
+    if (m_I2c) {
+      const uint8_t b = (n << 4) | (data ? LCD_I2C_RS : 0) | LCD_I2C_BACKLIGHT;
+      Wire.beginTransmission(m_I2c);
+      Wire.write(b | LCD_I2C_EN);
+      Wire.write(b);
+      Wire.endTransmission();
+      return;
+    }
+#else
+    (void)data;  // On the 4-bit bus, the caller has set RS already
+#endif
+    GPIO.out_w1tc      = m_Data[0] & ~m_Set[n][0];
+    GPIO.out_w1ts      = m_Set[n][0];
+    GPIO.out1_w1tc.val = m_Data[1] & ~m_Set[n][1];
+    GPIO.out1_w1ts.val = m_Set[n][1];
+    setPin(m_En);
+    delayMicroseconds(1);  // Enable high for at least 450 ns
+    clearPin(m_En);
+  }
+
+  // Function to send bytes through the backpack, as few I2C transmissions as the Wire buffer allows
+#if defined(LCD_I2C_ADDR)
+  void sendI2c(const uint8_t* buf, size_t len, bool data) {
+    waitReady();
+    size_t out = 0;
+    Wire.beginTransmission(m_I2c);
+    for (size_t i = 0; i < len; i++) {
+      if (out + 4 > LCD_I2C_BURST) {
+        Wire.endTransmission();
+        Wire.beginTransmission(m_I2c);
+        out = 0;
+      }
+      const uint8_t flags = (data ? LCD_I2C_RS : 0) | LCD_I2C_BACKLIGHT;
+      const uint8_t hi = (buf[i] & 0xF0) | flags;
+      const uint8_t lo = (buf[i] << 4) | flags;
+      Wire.write(hi | LCD_I2C_EN);
+      Wire.write(hi);
+      Wire.write(lo | LCD_I2C_EN);
+      Wire.write(lo);
+      out += 4;
+    }
+    Wire.endTransmission();
+    m_ReadyUs = esp_timer_get_time() + LCD_EXEC_US;
+  }
+#else
+  void sendI2c(const uint8_t*, size_t, bool) {}
+#endif
+
+  static inline
+  void setPin(uint8_t pin) {
+    if (pin < 32) {
+      GPIO.out_w1ts = 1UL << pin;
+    } else {
+      GPIO.out1_w1ts.val = 1UL << (pin - 32);
+    }
+  }
+
+  static inline
+  void clearPin(uint8_t pin) {
+    if (pin < 32) {
+      GPIO.out_w1tc = 1UL << pin;
+    } else {
+      GPIO.out1_w1tc.val = 1UL << (pin - 32);
+    }
+  }
+
+  uint8_t  m_Rs, m_En, m_I2c;
+  uint8_t  m_Pins[6];
+  uint8_t  m_Cols, m_Rows;
+  uint32_t m_Set[16][2];  // Pins to set for each nibble value, in the low and high GPIO bank
+  uint32_t m_Data[2];     // All the data pins
+  int64_t  m_ReadyUs;     // esp_timer time the controller is done with the last byte
+};
@@ -0,0 +1,96 @@
+#include <stdarg.h>
+
+/*
+ * Fixed-capacity string for building short texts without touching the heap.
+ *
+ * Holds up to N-1 characters plus the terminator in place, so it lives on the
+ * stack or inside the object that owns it. Appending past the end truncates
+ * (and sets truncated()) instead of reallocating, which keeps the steady state
+ * free of the small, short-lived allocations that fragment the heap.
+ */
+template <size_t N>
+class FixedString {
+public:
+  FixedString() { clear(); }
+  FixedString(const char* s) { clear(); append(s); }
+
+  FixedString& operator=(const char* s) {
+    clear();
+    return append(s);
+  }
+
+  FixedString& append(const char* s, size_t len) {
+    if (len > N - 1 - m_Len) {
+      len = N - 1 - m_Len;
+      m_Truncated = true;
+    }
+    memcpy(m_Buf + m_Len, s, len);
+    m_Len += len;
+    m_Buf[m_Len] = '\0';
+    return *this;
+  }
+
+  FixedString& append(const char* s)   { return s ? append(s, strlen(s)) : *this; }
+  FixedString& append(char c)          { return append(&c, 1); }
+  FixedString& append(int v)           { return appendf("%d", v); }
+  FixedString& append(unsigned v)      { return appendf("%u", v); }
+  FixedString& append(long v)          { return appendf("%ld", v); }
+  FixedString& append(unsigned long v) { return appendf("%lu", v); }
+
+  __attribute__((format(printf, 2, 3)))
+  FixedString& appendf(const char* fmt, ...) {
+    va_list args;
+    va_start(args, fmt);
+    const int n = vsnprintf(m_Buf + m_Len, N - m_Len, fmt, args);
+    va_end(args);
+    if (n < 0) {
+      m_Buf[m_Len] = '\0';
+    } else if ((size_t)n >= N - m_Len) {
+      m_Len = N - 1;
+      m_Truncated = true;
+    } else {
+      m_Len += n;
+    }
+    return *this;
+  }
+
+  template <typename T>
+  FixedString& operator+=(T v) { return append(v); }
+
+  void clear() {
+    m_Len = 0;
+    m_Buf[0] = '\0';
+    m_Truncated = false;
+  }
+
+  void truncate(size_t len) {
+    if (len < m_Len) {
+      m_Len = len;
+      m_Buf[m_Len] = '\0';
+    }
+  }
+
+  // Function to replace every occurrence of one character with another
+  void replace(char from, char to) {
+    for (size_t i = 0; i < m_Len; i++) {
+      if (m_Buf[i] == from) {
+        m_Buf[i] = to;
+      }
+    }
+  }
+
+  bool startsWith(const char* s) const { return 0 == strncmp(m_Buf, s, strlen(s)); }
+  bool equals(const char* s) const     { return 0 == strcmp(m_Buf, s); }
+
+  const char* c_str() const    { return m_Buf; }
+  operator const char*() const { return m_Buf; }
+  size_t length() const        { return m_Len; }
+  bool   isEmpty() const       { return m_Len == 0; }
+  bool   truncated() const     { return m_Truncated; }
+  static constexpr size_t capacity() { return N - 1; }
+
+private:
+  char   m_Buf[N];
+  size_t m_Len;
+  bool   m_Truncated;
+};
@@ -0,0 +1,226 @@
+/*
+ * GPIO events.
+ *
+ * Interrupt handlers only timestamp the edge and push (pin, level, us) into a
+ * lock-free single-producer/single-consumer ring. Everything else - debouncing,
+ * press durations, pulse widths - is worked out by gpio_events_run() in task
+ * context, which app_loop() calls on every pass (including the blocking waits
+ * of the connection states), so an edge is handled within one loop pass.
+ *
+ * All watched pins share one handler, attached from the main loop task, so
+ * their interrupts run on one core and do not nest: one producer. The main
+ * loop is the only consumer.
+ */
+
+struct GpioEvent {
+  uint32_t us;     // micros() at the edge
+  uint8_t  pin;
+  uint8_t  level;  // Level after the edge
+};
+
+struct GpioEventQueue {
+  GpioEvent         events[GPIO_EVENT_QUEUE_SIZE];
+  volatile uint32_t head;       // Events pushed, written by the interrupt handler only
+  volatile uint32_t tail;       // Events popped, written by the main loop only
+  volatile uint32_t overflows;  // Events lost because the ring was full
+};
+
+static GpioEventQueue gpioQueue;
+
+// Function to record an edge, in interrupt context
+static void IRAM_ATTR gpio_event_isr(void* arg) {
+  const uint8_t  pin  = (uintptr_t)arg;
+  const uint32_t head = gpioQueue.head;
+  if (head - __atomic_load_n(&gpioQueue.tail, __ATOMIC_ACQUIRE) >= GPIO_EVENT_QUEUE_SIZE) {
+    gpioQueue.overflows++;
+    return;
+  }
+  GpioEvent& ev = gpioQueue.events[head % GPIO_EVENT_QUEUE_SIZE];
+  ev.us    = micros();
+  ev.pin   = pin;
+  ev.level = digitalRead(pin);
+  __atomic_store_n(&gpioQueue.head, head + 1, __ATOMIC_RELEASE);  // Publish the event
+}
+
+// Function to take the oldest event, in task context
+static
+bool gpio_event_pop(GpioEvent& ev) {
+  const uint32_t tail = gpioQueue.tail;
+  if (tail == __atomic_load_n(&gpioQueue.head, __ATOMIC_ACQUIRE)) {
+    return false;
+  }
+  ev = gpioQueue.events[tail % GPIO_EVENT_QUEUE_SIZE];
+  __atomic_store_n(&gpioQueue.tail, tail + 1, __ATOMIC_RELEASE);  // Free the slot
+  return true;
+}
+
+/*
+ * Watched pins
+ */
+
+typedef void (*GpioEventHandler)(void* ctx, const GpioEvent& ev);
+
+struct GpioWatch {
+  uint8_t          pin;
+  GpioEventHandler handler;
+  void*            ctx;
+  void           (*poll)(void* ctx, bool resync);  // Optional, called after every drain
+};
+
+static GpioWatch gpioWatches[GPIO_WATCH_MAX];
+static int       gpioWatchCount = 0;
+static bool      gpioResyncPending = false;
+
+// Function to make the watchers re-read their pins on the next run, e.g. after a sleep that may have missed edges
+void gpio_events_resync() {
+  gpioResyncPending = true;
+}
+
+// Function to route the edges of a pin to a handler
+bool gpio_events_watch(uint8_t pin, GpioEventHandler handler, void* ctx,
+                       void (*poll)(void*, bool) = NULL)
+{
+  if (gpioWatchCount >= GPIO_WATCH_MAX) {
+    return false;
+  }
+  GpioWatch& w = gpioWatches[gpioWatchCount++];
+  w.pin     = pin;
+  w.handler = handler;
+  w.ctx     = ctx;
+  w.poll    = poll;
+  attachInterruptArg(pin, gpio_event_isr, (void*)(uintptr_t)pin, CHANGE);
+  return true;
+}
+
+// Function to dispatch the queued edges, called from the main loop
+void gpio_events_run() {
+  static uint32_t overflowsSeen = 0;
+
+  GpioEvent ev;
+  while (gpio_event_pop(ev)) {
+    for (int i = 0; i < gpioWatchCount; i++) {
+      if (gpioWatches[i].pin == ev.pin) {
+        gpioWatches[i].handler(gpioWatches[i].ctx, ev);
+      }
+    }
+  }
+
+  // After an overflow the edges no longer add up: let the watchers re-read their pins
+  const bool resync = (gpioQueue.overflows != overflowsSeen) || gpioResyncPending;
+  overflowsSeen = gpioQueue.overflows;
+  gpioResyncPending = false;
+  for (int i = 0; i < gpioWatchCount; i++) {
+    if (gpioWatches[i].poll) {
+      gpioWatches[i].poll(gpioWatches[i].ctx, resync);
+    }
+  }
+}
+
+/*
+ * Debounced button
+ */
+
+typedef void (*GpioButtonHandler)(bool pressed, uint32_t heldMs);
+
+struct GpioButton {
+  uint8_t  pin;
+  bool     activeLow;
+  bool     pressed;    // Debounced state
+  bool     raw;        // State after the last edge
+  uint32_t edgeUs;     // Time of the last edge
+  uint32_t pressUs;    // Time of the edge that started the current press
+  GpioButtonHandler handler;  // Optional, called on every debounced change
+};
+
+// Function to read the current (undebounced) state of a button
+static
+bool gpio_button_read(const GpioButton& b) {
+  return (digitalRead(b.pin) == LOW) == b.activeLow;
+}
+
+// Function to note an edge of a button; it only counts once the pin settles
+static
+void gpio_button_event(void* ctx, const GpioEvent& ev) {
+  GpioButton& b = *(GpioButton*)ctx;
+  b.raw    = ((ev.level == LOW) == b.activeLow);
+  b.edgeUs = ev.us;
+}
+
+// Function to accept a change of a button once the pin has been quiet for GPIO_DEBOUNCE_MS
+static
+void gpio_button_poll(void* ctx, bool resync) {
+  GpioButton& b = *(GpioButton*)ctx;
+  if (resync) {
+    b.raw    = gpio_button_read(b);
+    b.edgeUs = micros();
+  }
+  if (b.raw == b.pressed || micros() - b.edgeUs < GPIO_DEBOUNCE_MS * 1000UL) {
+    return;
+  }
+  b.pressed = b.raw;
+  uint32_t heldMs = 0;
+  if (b.pressed) {
+    b.pressUs = b.edgeUs;
+  } else {
+    heldMs = (b.edgeUs - b.pressUs) / 1000;  // Measured between the edges, not when they were handled
+  }
+  if (b.handler) {
+    b.handler(b.pressed, heldMs);
+  }
+}
+
+// Function to set up a button and start watching it
+void gpio_button_init(GpioButton& b, uint8_t pin, bool activeLow, GpioButtonHandler handler = NULL) {
+  b.pin       = pin;
+  b.activeLow = activeLow;
+  b.handler   = handler;
+  pinMode(pin, activeLow ? INPUT_PULLUP : INPUT_PULLDOWN);
+  b.pressed   = b.raw = gpio_button_read(b);
+  b.edgeUs    = b.pressUs = micros();
+  gpio_events_watch(pin, gpio_button_event, &b, gpio_button_poll);
+}
+
+/*
+ * Pulse width (e.g. an ultrasonic echo)
+ */
+
+struct GpioPulse {
+  uint8_t  pin;
+  bool     high;      // A pulse has started
+  uint32_t riseUs;
+  uint32_t widthUs;   // Width of the last complete pulse
+  bool     ready;     // widthUs has not been taken yet
+};
+
+// Function to measure a pulse from its rising and falling edges
+static
+void gpio_pulse_event(void* ctx, const GpioEvent& ev) {
+  GpioPulse& p = *(GpioPulse*)ctx;
+  if (ev.level) {
+    p.riseUs = ev.us;
+    p.high   = true;
+  } else if (p.high) {
+    p.widthUs = ev.us - p.riseUs;
+    p.high    = false;
+    p.ready   = true;
+  }
+}
+
+// Function to set up a pulse input and start watching it
+void gpio_pulse_init(GpioPulse& p, uint8_t pin) {
+  p.pin   = pin;
+  p.high  = false;
+  p.ready = false;
+  pinMode(pin, INPUT);
+  gpio_events_watch(pin, gpio_pulse_event, &p);
+}
+
+// Function to take the width of the last pulse, returns false if there is no new one
+bool gpio_pulse_take(GpioPulse& p, uint32_t& widthUs) {
+  if (!p.ready) {
+    return false;
+  }
+  p.ready = false;
+  widthUs = p.widthUs;
+  return true;
+}
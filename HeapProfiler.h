@@ -0,0 +1,170 @@
+#include "esp_heap_caps.h"
+#if CONFIG_HEAP_TRACING_STANDALONE
+  #include "esp_heap_trace.h"
+#endif
+
+/*
+ * Heap usage and allocation profiling, for the "heap" console command.
+ *
+ * The fragmentation figures (free, largest block, block counts) are always
+ * available. Attributing allocations to call sites needs the standalone heap
+ * tracer of ESP-IDF (CONFIG_HEAP_TRACING_STANDALONE, e.g. when building with
+ * Arduino as an IDF component): "heap start" records every allocation with
+ * its callers, "heap sites" groups them by call site. The addresses can be
+ * resolved with xtensa-esp32-elf-addr2line -pfiaCe firmware.elf <pc>...
+ */
+
+struct HeapSnapshot {
+  uint32_t free;          // Bytes free
+  uint32_t largest;       // Largest free block
+  uint32_t minFree;       // Low-water mark since boot
+  uint32_t allocBlocks;   // Blocks in use
+  uint32_t freeBlocks;    // Free blocks; growing with a stable free size means fragmentation
+};
+
+static HeapSnapshot heapBaseline = { 0, 0, 0, 0, 0 };  // Taken once the device is running
+
+// Function to read the state of the internal heap
+static
+HeapSnapshot heap_snapshot() {
+  multi_heap_info_t info;
+  heap_caps_get_info(&info, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+  HeapSnapshot snap;
+  snap.free        = info.total_free_bytes;
+  snap.largest     = info.largest_free_block;
+  snap.minFree     = info.minimum_free_bytes;
+  snap.allocBlocks = info.allocated_blocks;
+  snap.freeBlocks  = info.free_blocks;
+  return snap;
+}
+
+// Function to get the fragmentation of the free heap, in percent
+static
+uint32_t heap_fragmentation(const HeapSnapshot& snap) {
+  return snap.free ? 100 - (uint64_t)snap.largest * 100 / snap.free : 0;
+}
+
+// Function to remember the current heap state, to compare later ones against
+void heap_profiler_baseline() {
+  heapBaseline = heap_snapshot();
+}
+
+#if CONFIG_HEAP_TRACING_STANDALONE
+
+#define HEAP_SITE_DEPTH  (CONFIG_HEAP_TRACING_STACK_DEPTH < 4 ? CONFIG_HEAP_TRACING_STACK_DEPTH : 4)
+
+struct HeapSite {
+  void*    callers[4];  // Innermost first
+  uint32_t count;       // Allocations made here
+  uint32_t bytes;       // Bytes allocated here
+  uint32_t live;        // Allocations not yet freed
+};
+
+static heap_trace_record_t heapTraceRecords[HEAP_TRACE_RECORDS];
+static bool                heapTraceReady = false;
+
+// Function to start recording allocations
+bool heap_profiler_start() {
+  if (!heapTraceReady) {
+    heapTraceReady = (ESP_OK == heap_trace_init_standalone(heapTraceRecords, HEAP_TRACE_RECORDS));
+  }
+  return heapTraceReady && (ESP_OK == heap_trace_start(HEAP_TRACE_ALL));
+}
+
+// Function to stop recording allocations, keeping the records for the report
+void heap_profiler_stop() {
+  heap_trace_stop();
+}
+
+// Function to group the recorded allocations by call site and print the busiest ones
+template <typename Out>
+void heap_profiler_sites(Out& out) {
+  HeapSite sites[HEAP_SITES_MAX];
+  int siteCount = 0;
+  uint32_t dropped = 0;
+
+  const size_t count = heap_trace_get_count();
+  for (size_t i = 0; i < count; i++) {
+    heap_trace_record_t rec;
+    if (ESP_OK != heap_trace_get(i, &rec) || !rec.address) {
+      continue;
+    }
+    int s = 0;
+    while (s < siteCount && memcmp(sites[s].callers, rec.alloced_by, HEAP_SITE_DEPTH * sizeof(void*))) {
+      s++;
+    }
+    if (s == siteCount) {
+      if (siteCount == HEAP_SITES_MAX) {
+        dropped++;
+        continue;
+      }
+      memset(&sites[s], 0, sizeof(HeapSite));
+      memcpy(sites[s].callers, rec.alloced_by, HEAP_SITE_DEPTH * sizeof(void*));
+      siteCount++;
+    }
+    sites[s].count++;
+    sites[s].bytes += rec.size;
+    if (!rec.freed_by[0]) {
+      sites[s].live++;
+    }
+  }
+
+  // Busiest first
+  for (int i = 1; i < siteCount; i++) {
+    for (int j = i; j > 0 && sites[j].count > sites[j-1].count; j--) {
+      const HeapSite tmp = sites[j]; sites[j] = sites[j-1]; sites[j-1] = tmp;
+    }
+  }
+
+  out.printf("%u allocations recorded%s\n", count, count >= HEAP_TRACE_RECORDS ? " (buffer full)" : "");
+  out.printf("%6s %8s %5s  callers\n", "count", "bytes", "live");
+  for (int i = 0; i < siteCount; i++) {
+    out.printf("%6u %8u %5u ", sites[i].count, sites[i].bytes, sites[i].live);
+    for (int d = 0; d < HEAP_SITE_DEPTH && sites[i].callers[d]; d++) {
+      out.printf(" %p", sites[i].callers[d]);
+    }
+    out.printf("\n");
+  }
+  if (dropped) {
+    out.printf("%u allocations from other sites not shown\n", dropped);
+  }
+}
+
+#endif
+
+// Function to handle the "heap" console command: heap [baseline | start | stop | sites]
+template <typename Out>
+void heap_profiler_command(Out& out, int argc, const char** argv) {
+  if (argc >= 1 && 0 == strcmp(argv[0], "baseline")) {
+    heap_profiler_baseline();
+    return;
+  }
+#if CONFIG_HEAP_TRACING_STANDALONE
+  if (argc >= 1 && 0 == strcmp(argv[0], "start")) {
+    out.print(heap_profiler_start() ? R"json({"status":"OK"})json" "\n"
+                                    : R"json({"status":"error","msg":"heap tracing failed to start"})json" "\n");
+    return;
+  } else if (argc >= 1 && 0 == strcmp(argv[0], "stop")) {
+    heap_profiler_stop();
+    return;
+  } else if (argc >= 1 && 0 == strcmp(argv[0], "sites")) {
+    heap_profiler_sites(out);
+    return;
+  }
+#else
+  if (argc >= 1) {
+    out.print(R"json({"status":"error","msg":"heap tracing is not enabled in this build"})json" "\n");
+    return;
+  }
+#endif
+
+  const HeapSnapshot now = heap_snapshot();
+  out.printf(" Free:            %u (min %u)\n", now.free, now.minFree);
+  out.printf(" Largest block:   %u (%u%% fragmented)\n", now.largest, heap_fragmentation(now));
+  out.printf(" Blocks:          %u used, %u free\n", now.allocBlocks, now.freeBlocks);
+  if (heapBaseline.free) {
+    out.printf(" Since baseline:  %+d bytes free, %+d used blocks, %+d%% fragmentation\n",
+               (int)(now.free - heapBaseline.free), (int)(now.allocBlocks - heapBaseline.allocBlocks),
+               (int)(heap_fragmentation(now) - heap_fragmentation(heapBaseline)));
+  }
+}
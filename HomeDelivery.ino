@@ -16,8 +16,18 @@
 
 #include "Geofence.h"  // Include the Geofence header file
 
-// Timer for Blynk operations
-BlynkTimer timer;
+#include "PowerGovernor.h"  // CPU clock, sleep and Wi-Fi power save by delivery state
+
+#include "UlpRanging.h"  // Deep sleep with the ULP watching the ultrasonic sensor (battery units)
+
+#include "Bench.h"  // Microbenchmarks for the "bench" console command
+
+#include "LockerBank.h"  // Several compartments driven by one controller (locker-bank mode)
+
+int cameraBoot = -1;  // Boot job probing the camera
+TimerId cameraServerTimer = 0;  // Polls the camera boot job until its server can start
+uint64_t cameraServerSince = 0;  // timer_now() when the polling started
+bool cameraServerStarted = false;
 
 Preferences preferences;
 
@@ -52,24 +62,28 @@ bool inGeofence = false; // Indicates whether the delivery person is within the
 // Virtual pin for "Activate System" button
 BLYNK_WRITE(V0)
 {
+  TRACE_SCOPE(TRACE_BLYNK_WRITE, request.pin);
+
   int value = param.asInt(); // Get the incoming value from Virtual Pin V0
   bool requestedV0State = (value == 1); // Determine the desired state based on user interaction
 
   if (!requestedV0State && lockState && !openState) {
       // If the user requested to turn V0 OFF and the conditions are met
       isV0On = false;
-      Serial.println("The system has been disabled.");
+      LOG_I("The system has been disabled.");
   } else {
       // If the conditions are not met, or the user requested to turn V0 ON
       isV0On = true;
       Blynk.virtualWrite(V0, 1); // Force the button back to ON state in the app
-      Serial.println("The system has been enabled.");
+      LOG_I("The system has been enabled.");
   }
 }
 
 // Virtual pin for "Email Notification" button
 BLYNK_WRITE(V4)
 {
+  TRACE_SCOPE(TRACE_BLYNK_WRITE, request.pin);
+
   int value = param.asInt(); 
   isV4On = (value == 1); // Update the state of V4
 }
@@ -78,9 +92,10 @@ BLYNK_WRITE(V4)
 // This pin is not visible in the Blynk app interface
 BLYNK_WRITE(V5)
 {
+  TRACE_SCOPE(TRACE_BLYNK_WRITE, request.pin);
+
   latitude_delivery = param.asDouble(); 
-  Serial.print("Updated delivery latitude: ");
-  Serial.println(latitude_delivery, 6);  // 6 decimal values
+  LOG_I("Updated delivery latitude: %.6f", latitude_delivery);  // 6 decimal values
   checkGeofence(); // Check geofence whenever location is updated
 }
 
@@ -88,19 +103,21 @@ BLYNK_WRITE(V5)
 // This pin is not visible in the Blynk app interface
 BLYNK_WRITE(V6)
 {
+  TRACE_SCOPE(TRACE_BLYNK_WRITE, request.pin);
+
   longitude_delivery = param.asDouble(); 
-  Serial.print("Updated delivery longitude: ");
-  Serial.println(longitude_delivery, 6);
+  LOG_I("Updated delivery longitude: %.6f", longitude_delivery);
   checkGeofence(); // Check geofence whenever location is updated
 }
 
 // Stores the latitude value in preferences
 BLYNK_WRITE(V7)
 {
+  TRACE_SCOPE(TRACE_BLYNK_WRITE, request.pin);
+
   double value = param.asDouble(); 
 
-  Serial.print("Value from V7: ");
-  Serial.println(value, 6); 
+  LOG_D("Value from V7: %.6f", value);
 
   // Store the new latitude value in preferences
   preferences.begin("blynk", false);
@@ -109,18 +126,18 @@ BLYNK_WRITE(V7)
 
   // Update the home latitude
   latitude_home = value;
-  Serial.print("Home latitude updated to: ");
-  Serial.println(latitude_home, 6);
+  LOG_I("Home latitude updated to: %.6f", latitude_home);
   checkGeofence();  // Check geofence with updated value
 }
 
 // Stores the longitude value in preferences
 BLYNK_WRITE(V8)
 {
+  TRACE_SCOPE(TRACE_BLYNK_WRITE, request.pin);
+
   double value = param.asDouble();
 
-  Serial.print("Value from V8: ");
-  Serial.println(value, 6);
+  LOG_D("Value from V8: %.6f", value);
 
   // Store the new longitude value in preferences
   preferences.begin("blynk", false);
@@ -130,11 +147,34 @@ BLYNK_WRITE(V8)
 
   // Update the home longitude
   longitude_home = value;
-  Serial.print("Home longitude updated to: ");
-  Serial.println(longitude_home, 6);
+  LOG_I("Home longitude updated to: %.6f", longitude_home);
   checkGeofence();  // Check geofence with updated value
 }
 
+// Function to start the camera web server once the camera boot job is done; polled by cameraServerTimer
+void startCameraServerWhenReady()
+{
+  if (!boot_wait(cameraBoot, 0)) {
+    if (cameraServerSince && timer_now() - cameraServerSince >= BOOT_CAMERA_TIMEOUT) {
+      cameraServerSince = 0;  // Warn once, and keep waiting
+      LOG_W("Camera is still starting up.");
+    }
+    return;
+  }
+  timer_cancel(cameraServerTimer);
+
+  // The driver is only there if the probe succeeded
+  if (!esp_camera_sensor_get()) {
+    LOG_E("Camera init failed, the camera server is not started.");
+    return;
+  }
+  startCameraServer();
+  cameraServerStarted = true;
+
+  // Print the IP address of the ESP32 to access the camera server
+  LOG_I("Camera Ready! Use 'http://%s' to connect", WiFi.localIP().toString().c_str());
+}
+
 // This function is called every time the device is connected to Blynk.Cloud
 BLYNK_CONNECTED()
 {
@@ -142,23 +182,27 @@ BLYNK_CONNECTED()
   Blynk.virtualWrite(V0, true);
   Blynk.virtualWrite(V1, 0);
   Blynk.virtualWrite(V4, false);
-  Blynk.virtualWrite(V5, 0.0);
-  Blynk.virtualWrite(V6, 0.0);
+  if (ulp_ranging_woken()) {
+    Blynk.syncVirtual(V5, V6);  // Where the delivery person went while the box was asleep
+  } else {
+    Blynk.virtualWrite(V5, 0.0);
+    Blynk.virtualWrite(V6, 0.0);
+  }
   Blynk.virtualWrite(V7, latitude_home);
   Blynk.virtualWrite(V8, longitude_home);
 
   // Wait for connection to WiFi
   if (WiFi.status() != WL_CONNECTED) {
     delay(500);
-    Serial.print("Wi-Fi not connected.");
+    LOG_W("Wi-Fi not connected.");
+  }
+  // Start the camera web server once the camera is up, without holding up the loop here
+  if (cameraServerStarted) {
+    LOG_I("Camera Ready! Use 'http://%s' to connect", WiFi.localIP().toString().c_str());
+  } else if (!cameraServerTimer) {
+    cameraServerSince = timer_now();
+    cameraServerTimer = timer_every(100, startCameraServerWhenReady);
   }
-  // Print the IP address of the ESP32 to access the camera server
-  Serial.print("Camera Ready! Use 'http://");
-  Serial.print(WiFi.localIP());
-  Serial.println("' to connect");
-
-  // Start the camera web server
-  startCameraServer();
 }
 
 // This function sends Arduino's uptime every second to Virtual Pin 2.
@@ -171,42 +215,83 @@ void myTimerEvent()
 void setup()
 {
   Serial.begin(115200); // Initialize serial communication at 115200 baud
+  Serial.setDebugOutput(true);
+
+  // Bring up the lock, LCD and button first, so the box is usable right away
+  {
+    BOOT_PHASE("components");
+#if defined(LOCKER_BANK)
+    locker_bank_init();
+#else
+    initializeElectronicComponents();
+#endif
+  }
+  boot_mark("usable");
 
-  // Initialize preferences with the namespace "blynk" in read-write mode
-  preferences.begin("blynk", false);
+  // Probe the camera and allocate its frame buffers on the other core,
+  // while the rest starts up and Wi-Fi associates
+  cameraBoot = boot_spawn("camera", initializeCameraWeb, 0);
+
+  {
+    BOOT_PHASE("preferences");
 
-  // Retrieve the latitude and longitude values from ESP32 memory, or use default values if not found
-  latitude_home = preferences.getDouble(LATITUDE_KEY, latitude_home_default);
-  longitude_home = preferences.getDouble(LONGITUDE_KEY, longitude_home_default);
+    // Initialize preferences with the namespace "blynk" in read-write mode
+    preferences.begin("blynk", false);
 
-  // To manually reset the stored latitude and longitude in ESP32 memory 
-  if (resetMemory){
-    preferences.putDouble(LATITUDE_KEY, latitude_home_default);
-    preferences.putDouble(LONGITUDE_KEY, longitude_home_default);
+    // Retrieve the latitude and longitude values from ESP32 memory, or use default values if not found
+    latitude_home = preferences.getDouble(LATITUDE_KEY, latitude_home_default);
+    longitude_home = preferences.getDouble(LONGITUDE_KEY, longitude_home_default);
+
+    // To manually reset the stored latitude and longitude in ESP32 memory 
+    if (resetMemory){
+      preferences.putDouble(LATITUDE_KEY, latitude_home_default);
+      preferences.putDouble(LONGITUDE_KEY, longitude_home_default);
+    }
+
+    // Close the preferences after accessing them
+    preferences.end();
   }
 
-  // Close the preferences after accessing them
-  preferences.end();
+  {
+    BOOT_PHASE("edgent");
+    BlynkEdgent.begin();  // Initialize Blynk and Wi-Fi provisioning
+  }
 
-  BlynkEdgent.begin();  // Initialize Blynk and Wi-Fi provisioning
+  // Coming back from deep sleep, restore the lock state, home location and Wi-Fi connection
+  ulp_ranging_wake();
 
   // Perform initial geofence check without triggering an HTTP request.
   checkGeofence();
 
   // Set a timer to call myTimerEvent every second
-  timer.setInterval(1000L, myTimerEvent);
+  timer_every(1000, myTimerEvent);
+
+  // Start the power governor
+  power_init();
 
-  // Initialize camera setting
-  initializeCameraWeb();
+  // Start the telemetry stream (TELEMETRY_ENABLE)
+  telemetry_init();
 
-  // Initialize electronic components
-  initializeElectronicComponents();
+  // Start looking for motion in the camera frames, once the camera is up (MOTION_ENABLE)
+  motion_init();
 }
 
 void loop()
 {
-  BlynkEdgent.run();  // Handle Blynk and Wi-Fi provisioning
-  timer.run(); // Run the timer
+  PROFILE_SCOPE(PROF_LOOP);  // Time the whole pass of the loop
 
+  {
+    PROFILE_SCOPE(PROF_EDGENT);
+    BlynkEdgent.run();  // Handle Blynk and Wi-Fi provisioning, and run the timers
+  }
+
+#if defined(LOCKER_BANK)
+  locker_bank_run();  // Run the compartments of the locker bank
+#else
   runElectronicComponents();  // Run the electronic components
+#endif
+
+  power_run();  // Pick the power profile, and sleep while idle
+
+  ulp_ranging_run();  // Go to deep sleep when idle for long enough (battery units)
 }
@@ -6,6 +6,10 @@
   Adafruit_NeoPixel rgb = Adafruit_NeoPixel(1, BOARD_LED_PIN_WS2812, NEO_GRB + NEO_KHZ800);
 #endif
 
+#if !defined(BOARD_LED_PIN_WS2812) && (defined(BOARD_LED_PIN_R) || defined(BOARD_LED_PIN))
+  #include "driver/ledc.h"          // LEDC fade engine
+#endif
+
 void indicator_run();  // Forward declaration of the indicator_run function
 
 // Define default LED brightness if not already defined
@@ -23,6 +27,31 @@ void indicator_run();  // Forward declaration of the indicator_run function
 #define RGB(r,g,b) (DIMM(r) << 16 | DIMM(g) << 8 | DIMM(b) << 0)
 #define TO_PWM(x)  ((uint32_t)(x)*(BOARD_PWM_MAX)/255)
 
+// One animation: the LED steps through brightness levels of a color, switching or fading to each
+struct LedAnim {
+  uint32_t        color;
+  const uint8_t*  levels;   // Brightness of each step, 0..255 of the color
+  const uint16_t* times;    // Duration of each step in ms, or NULL to use stepMs for all of them
+  uint16_t        stepMs;
+  uint8_t         count;    // Number of steps
+  bool            fade;     // Fade into each level (in LEDC hardware where available)
+};
+
+// Breathing curve: one period of a raised cosine, gamma-corrected (2.2) for a smooth perceived fade
+static const uint8_t ledBreathe[32] = {
+    0,   0,   0,   1,   4,   9,  19,  34,  55,  82, 113, 147, 180, 210, 234, 250,
+  255, 250, 234, 210, 180, 147, 113,  82,  55,  34,  19,   9,   4,   1,   0,   0,
+};
+static const uint8_t  ledOnOff[4]      = { 255, 0, 255, 0 };
+static const uint16_t ledBeatSlow[2]   = { 50, 500 };
+static const uint16_t ledBeatMedium[2] = { 200, 200 };
+static const uint16_t ledBeatFast[2]   = { 100, 100 };
+static const uint16_t ledBeatRapid[2]  = { 50, 50 };
+static const uint16_t ledBeatError[4]  = { 80, 100, 80, 1000 };
+
+#define LED_BEAT(color, times)     { color, ledOnOff, times, 0, sizeof(times)/sizeof(times[0]), false }
+#define LED_BREATHE(color, period) { color, ledBreathe, NULL, (period)/32, 32, true }
+
 // Indicator class to manage LED states and animations
 class Indicator {
 public:
@@ -42,38 +71,83 @@ public:
   // Initialize the indicator by resetting the counter and initializing the LED
   void init() {
     m_Counter = 0;
+    m_Anim = NULL;
     initLED();
   }
 
-  // Run the indicator logic based on the current state
+  // Run the indicator logic based on the current state, returns the time until the next step
   uint32_t run() {
-    State currState = BlynkState::get();  // Get the current state from BlynkState
+    const LedAnim* anim = select();
 
-    // Reset counter if indicator state changes
-    if (m_PrevState != currState) {
-      m_PrevState = currState;
+    // Restart the animation when it changes
+    if (m_Anim != anim) {
+      m_Anim = anim;
       m_Counter = 0;
     }
+    return playLED(*anim);
+  }
+
+protected:
+
+  // Pick the animation for the current state
+  const LedAnim* select() {
+    static const LedAnim holdAction     = LED_BEAT(COLOR_WHITE, ledBeatFast);
+    static const LedAnim holdIndication = LED_BREATHE(COLOR_WHITE, 1000);
+    static const LedAnim waitConfig     = LED_BEAT(COLOR_BLUE, ledBeatSlow);
+    static const LedAnim configuring    = LED_BEAT(COLOR_BLUE, ledBeatMedium);
+    static const LedAnim connectingNet  = LED_BEAT(COLOR_BLYNK, ledBeatSlow);
+    static const LedAnim connectingCld  = LED_BEAT(COLOR_BLYNK, ledBeatFast);
+    static const LedAnim running        = LED_BREATHE(COLOR_BLYNK, 5000);
+    static const LedAnim otaUpgrade     = LED_BEAT(COLOR_MAGENTA, ledBeatRapid);
+    static const LedAnim error          = LED_BEAT(COLOR_RED, ledBeatError);
 
     const long t = millis();  // Get the current time in milliseconds
     if (g_buttonPressed) {
-      if (t - g_buttonPressTime > BUTTON_HOLD_TIME_ACTION)     { return beatLED(COLOR_WHITE,   (int[]){ 100, 100 }); }
-      if (t - g_buttonPressTime > BUTTON_HOLD_TIME_INDICATION) { return waveLED(COLOR_WHITE,   1000); }
+      if (t - g_buttonPressTime > BUTTON_HOLD_TIME_ACTION)     { return &holdAction; }
+      if (t - g_buttonPressTime > BUTTON_HOLD_TIME_INDICATION) { return &holdIndication; }
     }
     // Determine the LED behavior based on the current state
-    switch (currState) {
+    switch (BlynkState::get()) {
     case MODE_RESET_CONFIG:
-    case MODE_WAIT_CONFIG:       return beatLED(COLOR_BLUE,    (int[]){ 50, 500 });
-    case MODE_CONFIGURING:       return beatLED(COLOR_BLUE,    (int[]){ 200, 200 });
-    case MODE_CONNECTING_NET:    return beatLED(COLOR_BLYNK,   (int[]){ 50, 500 });
-    case MODE_CONNECTING_CLOUD:  return beatLED(COLOR_BLYNK,   (int[]){ 100, 100 });
-    case MODE_RUNNING:           return waveLED(COLOR_BLYNK,   5000);
-    case MODE_OTA_UPGRADE:       return beatLED(COLOR_MAGENTA, (int[]){ 50, 50 });
-    default:                     return beatLED(COLOR_RED,     (int[]){ 80, 100, 80, 1000 } );
+    case MODE_WAIT_CONFIG:       return &waitConfig;
+    case MODE_CONFIGURING:       return &configuring;
+    case MODE_CONNECTING_NET:    return &connectingNet;
+    case MODE_CONNECTING_CLOUD:  return &connectingCld;
+    case MODE_RUNNING:           return &running;
+    case MODE_OTA_UPGRADE:       return &otaUpgrade;
+    default:                     return &error;
     }
   }
 
-protected:
+  // Function to start the next step of an animation, returns its duration
+  uint32_t playLED(const LedAnim& anim) {
+    const uint8_t  level = anim.levels[m_Counter];
+    const uint32_t ms    = anim.times ? anim.times[m_Counter] : anim.stepMs;
+#if defined(BOARD_LED_IS_RGB)
+    const uint32_t color = scaleRGB(anim.color, level);
+    if (anim.fade) {
+      fadeRGB(color, ms);
+    } else {
+      setRGB(color);
+    }
+#else
+    if (anim.fade) {
+      fadeLED(DIMM(level), ms);
+    } else {
+      setLED(DIMM(level));
+    }
+#endif
+    m_Counter = (m_Counter+1) % anim.count;
+    return ms;
+  }
+
+  // Function to scale each channel of a color by a brightness level
+  static uint32_t scaleRGB(uint32_t color, uint8_t level) {
+    const uint32_t r = ((color >> 16) & 0xFF) * level / 255;
+    const uint32_t g = ((color >> 8)  & 0xFF) * level / 255;
+    const uint32_t b = ( color        & 0xFF) * level / 255;
+    return (r << 16) | (g << 8) | b;
+  }
 
   /*
    * LED drivers
@@ -87,12 +161,17 @@ protected:
     setRGB(COLOR_BLACK);  // Initialize the LED to off (black)
   }
 
-  // Set the color of the WS2812 LED
+  // Set the color of the WS2812 LED (the library sends it with the RMT peripheral)
   void setRGB(uint32_t color) {
     rgb.setPixelColor(0, color);
     rgb.show();
   }
 
+  // No fade engine for the WS2812: the curve is stepped through at the table resolution
+  void fadeRGB(uint32_t color, uint32_t) {
+    setRGB(color);
+  }
+
   // If separate RGB LED pins are defined, use PWM for RGB control
 #elif defined(BOARD_LED_PIN_R)     
 
@@ -105,6 +184,8 @@ protected:
     ledcSetup(BOARD_LEDC_CHANNEL_1, BOARD_LEDC_BASE_FREQ, BOARD_LEDC_TIMER_BITS);
     ledcSetup(BOARD_LEDC_CHANNEL_2, BOARD_LEDC_BASE_FREQ, BOARD_LEDC_TIMER_BITS);
     ledcSetup(BOARD_LEDC_CHANNEL_3, BOARD_LEDC_BASE_FREQ, BOARD_LEDC_TIMER_BITS);
+
+    ledc_fade_func_install(0);  // Enable the hardware fade engine
   }
 
   // Set the color of the RGB LED using PWM
@@ -124,6 +205,22 @@ protected:
     #endif
   }
 
+  // Fade the RGB LED to a color, in the LEDC hardware
+  void fadeRGB(uint32_t color, uint32_t ms) {
+    uint8_t r = (color & 0xFF0000) >> 16;
+    uint8_t g = (color & 0x00FF00) >> 8;
+    uint8_t b = (color & 0x0000FF);
+    #if BOARD_LED_INVERSE
+    fadePWM(BOARD_LEDC_CHANNEL_1, TO_PWM(255 - r), ms);
+    fadePWM(BOARD_LEDC_CHANNEL_2, TO_PWM(255 - g), ms);
+    fadePWM(BOARD_LEDC_CHANNEL_3, TO_PWM(255 - b), ms);
+    #else
+    fadePWM(BOARD_LEDC_CHANNEL_1, TO_PWM(r), ms);
+    fadePWM(BOARD_LEDC_CHANNEL_2, TO_PWM(g), ms);
+    fadePWM(BOARD_LEDC_CHANNEL_3, TO_PWM(b), ms);
+    #endif
+  }
+
   // If a single color LED pin is defined, use PWM for brightness control
 #elif defined(BOARD_LED_PIN)       
 
@@ -131,6 +228,8 @@ protected:
     // Setup and attach PWM channel for single color LED
     ledcSetup(BOARD_LEDC_CHANNEL_1, BOARD_LEDC_BASE_FREQ, BOARD_LEDC_TIMER_BITS);
     ledcAttachPin(BOARD_LED_PIN, BOARD_LEDC_CHANNEL_1);
+
+    ledc_fade_func_install(0);  // Enable the hardware fade engine
   }
 
   // Set the brightness of the single color LED
@@ -142,6 +241,15 @@ protected:
     #endif
   }
 
+  // Fade the single color LED to a brightness, in the LEDC hardware
+  void fadeLED(uint32_t color, uint32_t ms) {
+    #if BOARD_LED_INVERSE
+    fadePWM(BOARD_LEDC_CHANNEL_1, TO_PWM(255 - color), ms);
+    #else
+    fadePWM(BOARD_LEDC_CHANNEL_1, TO_PWM(color), ms);
+    #endif
+  }
+
 #else
 
   // If no valid LED configuration is defined, provide dummy functions
@@ -150,81 +258,33 @@ protected:
   void initLED() {
   }
 
-  void setLED(uint32_t color) {
+  void setLED(uint32_t) {
   }
 
-#endif
-
-  /*
-   * Animations
-   */
-
-  // Skip the LED animation
-  uint32_t skipLED() {
-    return 20;
+  void fadeLED(uint32_t, uint32_t) {
   }
 
-#if defined(BOARD_LED_IS_RGB)
-
-  // Function for beat animation with RGB LED
-  template<typename T>
-  uint32_t beatLED(uint32_t onColor, const T& beat) {
-    const uint8_t cnt = sizeof(beat)/sizeof(beat[0]);
-    setRGB((m_Counter % 2 == 0) ? onColor : (uint32_t)COLOR_BLACK);
-    uint32_t next = beat[m_Counter % cnt];
-    m_Counter = (m_Counter+1) % cnt;
-    return next;
-  }
-
-  // Function for wave (breathing) animation with RGB LED
-  uint32_t waveLED(uint32_t colorMax, unsigned breathePeriod) {
-    uint8_t redMax = (colorMax & 0xFF0000) >> 16;
-    uint8_t greenMax = (colorMax & 0x00FF00) >> 8;
-    uint8_t blueMax = (colorMax & 0x0000FF);
-
-    // Brightness will rise from 0 to 128, then fall back to 0
-    uint8_t brightness = (m_Counter < 128) ? m_Counter : 255 - m_Counter;
-
-    // Multiply our three colors by the brightness:
-    redMax *= ((float)brightness / 128.0);
-    greenMax *= ((float)brightness / 128.0);
-    blueMax *= ((float)brightness / 128.0);
-    // And turn the LED to that color:
-    setRGB((redMax << 16) | (greenMax << 8) | blueMax);
-
-    // This function relies on the 8-bit, unsigned m_Counter rolling over.
-    m_Counter = (m_Counter+1) % 256;
-    return breathePeriod / 256;
-  }
-
-#else
-
-  // Function for beat animation with single color LED
-  template<typename T>
-  uint32_t beatLED(uint32_t, const T& beat) {
-    const uint8_t cnt = sizeof(beat)/sizeof(beat[0]);
-    setLED((m_Counter % 2 == 0) ? BOARD_LED_BRIGHTNESS : 0);
-    uint32_t next = beat[m_Counter % cnt];
-    m_Counter = (m_Counter+1) % cnt;
-    return next;
-  }
-
-  // Function for wave (breathing) animation with single color LED
-  uint32_t waveLED(uint32_t, unsigned breathePeriod) {
-    uint32_t brightness = (m_Counter < 128) ? m_Counter : 255 - m_Counter;
-
-    setLED(DIMM(brightness*2));
+#endif
 
-    // This function relies on the 8-bit, unsigned m_Counter rolling over.
-    m_Counter = (m_Counter+1) % 256;
-    return breathePeriod / 256;
+#if !defined(BOARD_LED_PIN_WS2812) && (defined(BOARD_LED_PIN_R) || defined(BOARD_LED_PIN))
+
+  // Start a hardware fade of an Arduino LEDC channel; it runs on its own until the next step
+  static void fadePWM(uint8_t channel, uint32_t duty, uint32_t ms) {
+  #if SOC_LEDC_SUPPORT_HS_MODE
+    const ledc_mode_t mode = (channel < 8) ? LEDC_HIGH_SPEED_MODE : LEDC_LOW_SPEED_MODE;
+  #else
+    const ledc_mode_t mode = LEDC_LOW_SPEED_MODE;
+  #endif
+    const ledc_channel_t ch = (ledc_channel_t)(channel % 8);
+    ledc_set_fade_with_time(mode, ch, duty, ms);
+    ledc_fade_start(mode, ch, LEDC_FADE_NO_WAIT);
   }
 
 #endif
 
 private:
-  uint8_t m_Counter;    // Counter for animation timing
-  State   m_PrevState;  // Previous state of the indicator
+  uint8_t        m_Counter;  // Current step of the animation
+  const LedAnim* m_Anim;     // Animation being played
 };
 
 Indicator indicator;  // Create an instance of the Indicator class
@@ -252,18 +312,23 @@ Indicator indicator;  // Create an instance of the Indicator class
     indicator.init();
     blinker.attach_ms(100, indicator_run);
   }
+  void indicator_notify() {}
 
 #elif defined(USE_PTHREAD)
 
   #include <pthread.h>
 
   pthread_t blinker;
+  static TaskHandle_t blinkerTask = NULL;
 
+  // The thread only wakes for the next animation step (fades run in hardware meanwhile),
+  // or when indicator_notify() reports a state change
   void* indicator_thread(void*) {
+    blinkerTask = xTaskGetCurrentTaskHandle();
     while (true) {
       uint32_t returnTime = indicator.run();
       returnTime = BlynkMathClamp(returnTime, 1, 10000);
-      vTaskDelay(returnTime);
+      ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(returnTime));
     }
   }
 
@@ -272,6 +337,13 @@ Indicator indicator;  // Create an instance of the Indicator class
     pthread_create(&blinker, NULL, indicator_thread, NULL);
   }
 
+  // Wake the indicator thread to show a new state right away
+  void indicator_notify() {
+    if (blinkerTask) {
+      xTaskNotifyGive(blinkerTask);
+    }
+  }
+
 #elif defined(USE_TIMER_ONE)
 
   #include <TimerOne.h>
@@ -288,6 +360,7 @@ Indicator indicator;  // Create an instance of the Indicator class
     Timer1.initialize(100*1000);
     Timer1.attachInterrupt(indicator_run);
   }
+  void indicator_notify() {}
 
 #elif defined(USE_TIMER_THREE)
 
@@ -305,6 +378,7 @@ Indicator indicator;  // Create an instance of the Indicator class
     Timer3.initialize(100*1000);
     Timer3.attachInterrupt(indicator_run);
   }
+  void indicator_notify() {}
 
 #elif defined(USE_TIMER_FIVE)
 
@@ -324,6 +398,7 @@ Indicator indicator;  // Create an instance of the Indicator class
     MyTimer5.attachInterrupt(indicator_run);
     MyTimer5.start();
   }
+  void indicator_notify() {}
 
 #else
 
@@ -331,5 +406,6 @@ Indicator indicator;  // Create an instance of the Indicator class
 
   void indicator_run() {}
   void indicator_init() {}
+  void indicator_notify() {}
 
 #endif
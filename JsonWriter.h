@@ -0,0 +1,179 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+// Streaming JSON writer: formats into a caller-provided buffer and hands each
+// full chunk to a sink, so responses of any length need no heap allocation.
+// Does not depend on Arduino, so it also builds on the host.
+class JsonWriter {
+public:
+  // Receives a chunk of output; data is NUL-terminated
+  typedef void (*Sink)(void* ctx, const char* data, size_t len);
+
+  JsonWriter(char* buf, size_t size, Sink sink, void* ctx = NULL)
+    : m_Buf(buf), m_Size(size), m_Len(0), m_Sink(sink), m_Ctx(ctx), m_Comma(false), m_Depth(0), m_RawLen(0)
+  {}
+
+  ~JsonWriter() { flush(); }
+
+  JsonWriter& beginObject() { separate(); put('{'); m_Comma = false; m_Depth++; return *this; }
+  JsonWriter& endObject()   { close('}'); return *this; }
+  JsonWriter& beginArray()  { separate(); put('['); m_Comma = false; m_Depth++; return *this; }
+  JsonWriter& endArray()    { close(']'); return *this; }
+
+  // Write an object key; the next call writes its value
+  JsonWriter& key(const char* k) {
+    separate();
+    putString(k);
+    put(':');
+    m_Comma = false;
+    return *this;
+  }
+
+  JsonWriter& value(const char* s) {
+    separate();
+    if (s) {
+      putString(s);
+    } else {
+      puts("null");
+    }
+    m_Comma = true;
+    return *this;
+  }
+
+  JsonWriter& value(bool b)               { separate(); puts(b ? "true" : "false"); m_Comma = true; return *this; }
+  JsonWriter& value(int n)                { return number("%d", n); }
+  JsonWriter& value(unsigned n)           { return number("%u", n); }
+  JsonWriter& value(long n)               { return number("%ld", n); }
+  JsonWriter& value(unsigned long n)      { return number("%lu", n); }
+  JsonWriter& value(long long n)          { return number("%lld", n); }
+  JsonWriter& value(unsigned long long n) { return number("%llu", n); }
+
+  // NaN and infinities have no JSON form: they are written as null
+  JsonWriter& value(double d, int digits = 3) {
+    separate();
+    if (isfinite(d)) {
+      char tmp[32];
+      snprintf(tmp, sizeof(tmp), "%.*f", digits, d);
+      puts(tmp);
+    } else {
+      puts("null");
+    }
+    m_Comma = true;
+    return *this;
+  }
+
+  // Shorthand for key(k).value(v)
+  template<typename T>
+  JsonWriter& field(const char* k, T v) { return key(k).value(v); }
+
+  JsonWriter& field(const char* k, double v, int digits) { return key(k).value(v, digits); }
+
+  // Write pre-formatted text as-is, e.g. whitespace between elements or a newline between
+  // records. Between two elements it is held until the next one, to go after the comma
+  JsonWriter& raw(const char* s) {
+    const size_t len = strlen(s);
+    if (!m_Depth || !m_Comma) {
+      puts(s);
+    } else if (m_RawLen + len < sizeof(m_Raw)) {
+      memcpy(m_Raw + m_RawLen, s, len);
+      m_RawLen += len;
+    } else {
+      separate();  // Too long to hold: only fit for text that comes before another element
+      m_Comma = false;
+      puts(s);
+    }
+    return *this;
+  }
+
+  // Hand everything buffered so far to the sink
+  void flush() {
+    if (m_Len) {
+      m_Buf[m_Len] = '\0';
+      m_Sink(m_Ctx, m_Buf, m_Len);
+      m_Len = 0;
+    }
+  }
+
+private:
+  // Function to write the comma before an element that follows another, then any text held for it
+  void separate() {
+    if (m_Comma && m_Depth) {
+      put(',');
+    }
+    putRaw();
+  }
+
+  void close(char c) {
+    putRaw();
+    put(c);
+    m_Comma = true;
+    if (m_Depth) {
+      m_Depth--;
+    }
+  }
+
+  void putRaw() {
+    for (size_t i = 0; i < m_RawLen; i++) {
+      put(m_Raw[i]);
+    }
+    m_RawLen = 0;
+  }
+
+  void put(char c) {
+    if (m_Len + 1 >= m_Size) {  // Keep one byte for the terminator
+      flush();
+    }
+    m_Buf[m_Len++] = c;
+  }
+
+  void puts(const char* s) {
+    while (*s) {
+      put(*s++);
+    }
+  }
+
+  void putString(const char* s) {
+    put('"');
+    for (; *s; s++) {
+      const unsigned char c = *s;
+      switch (c) {
+        case '"':  puts("\\\""); break;
+        case '\\': puts("\\\\"); break;
+        case '\n': puts("\\n");  break;
+        case '\r': puts("\\r");  break;
+        case '\t': puts("\\t");  break;
+        default:
+          if (c < 0x20) {
+            char tmp[8];
+            snprintf(tmp, sizeof(tmp), "\\u%04x", c);
+            puts(tmp);
+          } else {
+            put(c);
+          }
+      }
+    }
+    put('"');
+  }
+
+  template<typename T>
+  JsonWriter& number(const char* fmt, T n) {
+    separate();
+    char tmp[24];
+    snprintf(tmp, sizeof(tmp), fmt, n);
+    puts(tmp);
+    m_Comma = true;
+    return *this;
+  }
+
+  char*  m_Buf;
+  size_t m_Size;
+  size_t m_Len;
+  Sink   m_Sink;
+  void*  m_Ctx;
+  bool   m_Comma;  // A value was written at this level, the next one needs a separator
+  uint8_t m_Depth;  // Open objects and arrays; top-level records get no separator
+  uint8_t m_RawLen;
+  char    m_Raw[16];  // Text from raw() held for after the next separator
+};
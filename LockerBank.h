@@ -0,0 +1,446 @@
+/*
+ * Locker-bank mode: one controller drives LOCKER_BANK compartments
+ * (Settings.h), each with its own servo, ultrasonic sensor and door switch,
+ * and one shared status LCD.
+ *
+ * Every compartment runs the lock state machine of ElectronicComponents.h
+ * (same lockTable), but the per-compartment state is kept as one array per
+ * field, and flags (door open, servo moving, relock pending) as bitmasks, so
+ * a pass over the bank touches a few small arrays instead of N objects.
+ *
+ * The sensors are pinged round-robin, one at a time, pingInterval apart, so
+ * an echo never reaches another sensor's ping; only locked compartments are
+ * pinged. That also lets the echo outputs share one input, wired-OR through a
+ * diode each. A reading goes through the compartment's RangeFilter.
+ *
+ * The camera leaves too few free GPIOs for pins per compartment, so the
+ * per-compartment I/O sits on the I2C bus: the servos on a PCA9685 PWM
+ * expander (16 channels), and the trig outputs and door switches on PCF8574
+ * GPIO expanders, four compartments each (P0-P3 trig, P4-P7 doors). Only the
+ * shared echo input and the bus take GPIOs (Settings.h); they are checked
+ * against camera_pins.h. Door switches are polled on every ping tick and
+ * debounced over two ticks.
+ *
+ * The "bank" console command shows each compartment, with the scan rate of
+ * each and of the whole bank.
+ */
+
+#if defined(LOCKER_BANK)
+
+#if defined(ULP_RANGING)
+  #error "ULP_RANGING watches a single sensor, it does not work with LOCKER_BANK"
+#endif
+#if LOCKER_BANK > 16
+  #error "Too many compartments for the servo outputs"
+#endif
+
+#include <Wire.h>
+
+#define BANK_BOXES_PER_IO     4       // Compartments per PCF8574: trig on P0-P3, door on P4-P7
+#define BANK_IO_COUNT         ((LOCKER_BANK + BANK_BOXES_PER_IO - 1) / BANK_BOXES_PER_IO)
+#define BANK_IO_DOORS         0xF0    // Door bits, kept high so the PCF8574 reads them as inputs
+#define BANK_I2C_HZ           400000
+#define BANK_SERVO_HZ         50
+#define BANK_SERVO_MIN_US     500     // Pulse width at 0 degrees
+#define BANK_SERVO_MAX_US     2500    // Pulse width at 180 degrees
+
+#define BANK_PCA9685_MODE1    0x00
+#define BANK_PCA9685_PRESCALE 0xFE
+#define BANK_PCA9685_LED0     0x06   // LEDn_ON_L of channel 0, 4 registers per channel
+
+// Function to tell whether a pin is taken by the LCD (ElectronicComponents.h)
+static constexpr bool bank_lcd_pin(int pin) {
+#if defined(LCD_I2C_ADDR)
+  return pin == backlightPin;
+#else
+  return pin == backlightPin || pin == rs || pin == en || pin == d4 || pin == d5 || pin == d6 || pin == d7;
+#endif
+}
+
+static_assert(!camera_pin(BANK_ECHO_PIN) && !camera_pin(I2C_SDA_PIN) && !camera_pin(I2C_SCL_PIN),
+              "A locker-bank pin is taken by the camera, see camera_pins.h");
+static_assert(!bank_lcd_pin(BANK_ECHO_PIN) && !bank_lcd_pin(I2C_SDA_PIN) && !bank_lcd_pin(I2C_SCL_PIN),
+              "A locker-bank pin is taken by the LCD");
+
+typedef uint16_t BankMask;  // One bit per compartment
+
+struct LockerBank {
+  // Per-compartment state, one array per field
+  uint8_t     state[LOCKER_BANK];       // LockState
+  uint8_t     angle[LOCKER_BANK];       // Servo angle now
+  uint8_t     target[LOCKER_BANK];      // Servo angle it moves to
+  uint16_t    distanceMm[LOCKER_BANK];  // Filtered distance
+  uint8_t     confidence[LOCKER_BANK];
+  uint32_t    enteredMs[LOCKER_BANK];   // millis() when the state was entered
+  uint32_t    relockMs[LOCKER_BANK];    // millis() when it relocks, if its relock bit is set
+  uint32_t    scans[LOCKER_BANK];       // Readings since the bank was enabled
+  RangeFilter filter[LOCKER_BANK];
+
+  BankMask    doorOpen;     // Debounced door state
+  BankMask    doorRaw;      // Door state at the last tick
+  BankMask    moving;       // Servo not at its target yet
+  BankMask    relock;       // Relock pending
+
+  bool        enabled;      // Last enable condition seen
+  int8_t      pinged;       // Compartment whose echo is awaited, -1 for none
+  uint8_t     next;         // Compartment to ping next, if locked
+  uint32_t    scanFromMs;   // millis() when the scan counts started
+  uint32_t    ignored;      // Events with no row for the state they came in
+};
+
+static LockerBank bank;
+static GpioPulse  bankEcho;
+static TimerId    bankTickTimer  = 0;  // Pings, doors and relocks, while any compartment is enabled
+static TimerId    bankServoTimer = 0;  // Steps the servos, while any of them moves
+static uint32_t   bankServoMs    = 0;  // millis() of the last servo step
+
+static void bank_dispatch(int box, LockEvent ev);
+
+/*
+ * I2C expanders: servos, trig outputs and door switches
+ */
+
+static inline
+uint32_t bank_servo_us(int angle) {
+  return BANK_SERVO_MIN_US + (uint32_t)angle * (BANK_SERVO_MAX_US - BANK_SERVO_MIN_US) / 180;
+}
+
+static
+void bank_pca9685_write(uint8_t reg, uint8_t value) {
+  Wire.beginTransmission(BANK_PCA9685_ADDR);
+  Wire.write(reg);
+  Wire.write(value);
+  Wire.endTransmission();
+}
+
+static
+void bank_io_write(int io, uint8_t trig) {
+  Wire.beginTransmission(BANK_PCF8574_ADDR + io);
+  Wire.write(BANK_IO_DOORS | trig);
+  Wire.endTransmission();
+}
+
+// Function to set up the bus, the trig outputs and the expander for servo pulses; the I2C LCD shares the bus
+static
+void bank_io_begin() {
+  Wire.begin(I2C_SDA_PIN, I2C_SCL_PIN);
+  Wire.setClock(BANK_I2C_HZ);
+  for (int io = 0; io < BANK_IO_COUNT; io++) {
+    bank_io_write(io, 0);  // Trig low, doors as inputs
+  }
+  bank_pca9685_write(BANK_PCA9685_MODE1, 0x10);  // Sleep, to set the prescaler
+  bank_pca9685_write(BANK_PCA9685_PRESCALE, 25000000 / (4096 * BANK_SERVO_HZ) - 1);
+  bank_pca9685_write(BANK_PCA9685_MODE1, 0x20);  // Wake, register auto-increment
+  delayMicroseconds(500);                         // Oscillator start-up
+}
+
+static
+void bank_servo_write(int box, int angle) {
+  const uint16_t off = bank_servo_us(angle) * 4096 / (1000000 / BANK_SERVO_HZ);
+  Wire.beginTransmission(BANK_PCA9685_ADDR);
+  Wire.write(BANK_PCA9685_LED0 + 4 * box);
+  Wire.write(0);  // On at the start of the period
+  Wire.write(0);
+  Wire.write(off & 0xFF);
+  Wire.write(off >> 8);
+  Wire.endTransmission();
+}
+
+// Function to pulse the trig of one compartment; an I2C write keeps it high ~75 us, over the 10 us it needs
+static
+void bank_trig(int box) {
+  const int io = box / BANK_BOXES_PER_IO;
+  bank_io_write(io, 1 << (box % BANK_BOXES_PER_IO));
+  bank_io_write(io, 0);
+}
+
+// Function to read the door switches of every compartment, one bit each, set when open
+static
+BankMask bank_read_doors() {
+  BankMask open = 0;
+  for (int io = 0; io < BANK_IO_COUNT; io++) {
+    uint8_t pins = 0xFF;  // Reads closed if the expander does not answer
+    if (Wire.requestFrom((uint8_t)(BANK_PCF8574_ADDR + io), (uint8_t)1) == 1) {
+      pins = Wire.read();
+    }
+    open |= (BankMask)((~pins & BANK_IO_DOORS) >> 4) << (io * BANK_BOXES_PER_IO);
+  }
+  return open & (((BankMask)1 << LOCKER_BANK) - 1);
+}
+
+// Function to step every moving servo towards its target, catching up on late calls
+static
+void bank_step_servos() {
+  PROFILE_SCOPE(PROF_SERVO);
+  const uint32_t now   = millis();
+  const int      steps = (now - bankServoMs) / interval;
+  bankServoMs += steps * interval;
+
+  BankMask arrived = 0;
+  for (BankMask m = bank.moving; m; m &= m - 1) {
+    const int box = __builtin_ctz(m);
+    if (bank.angle[box] > bank.target[box]) {
+      bank.angle[box] = BlynkMax(bank.angle[box] - steps * angleStep, (int)bank.target[box]);
+    } else {
+      bank.angle[box] = BlynkMin(bank.angle[box] + steps * angleStep, (int)bank.target[box]);
+    }
+    bank_servo_write(box, bank.angle[box]);
+    TELEMETRY(TELEMETRY_SERVO, box, 0, bank.distanceMm[box] / 10.0f, 0, bank.confidence[box],
+              bank.angle[box], bank.state[box]);
+    if (bank.angle[box] == bank.target[box]) {
+      arrived |= 1 << box;
+    }
+  }
+
+  bank.moving &= ~arrived;
+  if (!bank.moving) {
+    timer_cancel(bankServoTimer);
+  }
+  for (; arrived; arrived &= arrived - 1) {
+    bank_dispatch(__builtin_ctz(arrived), LOCK_EV_SERVO_DONE);
+  }
+}
+
+// Function to start moving a servo; it reports LOCK_EV_SERVO_DONE when it gets there
+static
+void bank_move(int box, int angle) {
+  bank.target[box] = angle;
+  bank.moving |= 1 << box;
+  if (!bankServoTimer) {
+    bankServoMs    = millis();
+    bankServoTimer = timer_every(interval, bank_step_servos);
+  }
+}
+
+/*
+ * Shared display
+ */
+
+static const char bankStateChars[LOCK_STATE_MAX] = { '-', 'L', '>', 'U', 'O', '<' };
+
+// Function to show the whole bank on the LCD: a summary, then one character per compartment
+static
+void bank_show() {
+  PROFILE_SCOPE(PROF_LCD);
+  int locked = 0;
+  char line[17];
+  for (int box = 0; box < LOCKER_BANK; box++) {
+    locked += (bank.state[box] == LOCK_LOCKED || bank.state[box] == LOCK_DISABLED);
+    line[box] = bankStateChars[bank.state[box]];
+  }
+  line[LOCKER_BANK] = '\0';
+
+  char head[17];
+  snprintf(head, sizeof(head), "Locked %2d/%-2d   ", locked, LOCKER_BANK);
+  lcd.setCursor(0, 0);
+  lcd.print(head);
+  lcd.setCursor(0, 1);
+  lcd.print(line);
+}
+
+// Function to keep the single-box globals meaningful for the rest of the sketch: locked only if all are
+static
+void bank_summarize() {
+  bool all = true;
+  for (int box = 0; box < LOCKER_BANK; box++) {
+    all = all && (bank.state[box] == LOCK_LOCKED || bank.state[box] == LOCK_DISABLED);
+  }
+  lockState = all;
+  openState = bank.doorOpen != 0;
+}
+
+/*
+ * State machine
+ */
+
+// Function to do what entering a state takes, for one compartment
+static
+void bank_enter(int box, LockState from, LockState to) {
+  const BankMask bit = 1 << box;
+  switch (to) {
+    case LOCK_LOCKED:
+      range_filter_reset(bank.filter[box]);
+      if (from == LOCK_RELOCKING && !bank.enabled) {
+        bank_dispatch(box, LOCK_EV_DISABLE);  // Deferred while the compartment was open
+      }
+      break;
+    case LOCK_UNLOCKING:
+      bank_move(box, minAngle);
+      if (isV4On) {
+        char msg[48];
+        snprintf(msg, sizeof(msg), "Compartment %d has unlocked.", box + 1);
+        Blynk.logEvent("unlock_state", msg);
+      }
+      break;
+    case LOCK_UNLOCKED_CLOSED:
+      bank.relockMs[box] = millis() + lockDelay;
+      bank.relock |= bit;
+      break;
+    case LOCK_OPEN:
+      bank.relock &= ~bit;
+      if (from == LOCK_RELOCKING) {
+        bank_move(box, minAngle);  // Opened while relocking: pull the bolt back
+      }
+      break;
+    case LOCK_RELOCKING:
+      bank_move(box, maxAngle);
+      break;
+    default:
+      break;
+  }
+}
+
+// Function to feed an event to the state machine of one compartment
+static
+void bank_dispatch(int box, LockEvent ev) {
+  const LockState from = (LockState)bank.state[box];
+  const LockTransition* t = lock_transition(from, ev);
+  if (!t) {
+    bank.ignored++;
+    return;
+  }
+  const uint32_t now = millis();
+  LOG_I("Box %d: %s -> %s on %s, after %u ms", box + 1, lockStateNames[from], lockStateNames[t->to],
+        lockEventNames[ev], now - bank.enteredMs[box]);
+  TRACE_INSTANT(TRACE_LOCK, (box << 16) | (ev << 8) | t->to);
+  TELEMETRY(TELEMETRY_LOCK, box, 0, bank.distanceMm[box] / 10.0f, 0, bank.confidence[box],
+            bank.angle[box], t->to);
+
+  bank.state[box]     = t->to;
+  bank.enteredMs[box] = now;
+  bank_enter(box, from, t->to);
+  bank_summarize();
+  bank_show();
+}
+
+/*
+ * Ping tick: echo, doors, relocks, next ping
+ */
+
+static
+void bank_tick() {
+  PROFILE_SCOPE(PROF_ULTRASONIC);
+  const uint32_t now = millis();
+
+  // Echo of the last ping
+  if (bank.pinged >= 0) {
+    const int box = bank.pinged;
+    uint32_t echoUs = 0;
+    gpio_pulse_take(bankEcho, echoUs);  // Stays 0 if no echo came back
+    const RangeSample s = range_filter_add(bank.filter[box], echoUs);
+    bank.distanceMm[box] = s.cm * 10;
+    bank.confidence[box] = s.confidence;
+    bank.scans[box]++;
+    bank.pinged = -1;
+    TELEMETRY(TELEMETRY_RANGE, box, echoUs, s.cm, s.flags, s.confidence, bank.angle[box], bank.state[box]);
+    if (bank.state[box] == LOCK_LOCKED && !(bank.doorOpen & (1 << box)) &&
+        range_sample_closer(s, unlockDistance, unlock_confidence()))
+    {
+      bank_dispatch(box, LOCK_EV_NEAR);
+    }
+  }
+
+  // Doors: a change counts once it reads the same on two ticks in a row
+  BankMask raw = bank_read_doors();
+  BankMask changed = (raw ^ bank.doorOpen) & ~(raw ^ bank.doorRaw);
+  bank.doorRaw   = raw;
+  bank.doorOpen ^= changed;
+  for (; changed; changed &= changed - 1) {
+    const int box = __builtin_ctz(changed);
+    bank_dispatch(box, (bank.doorOpen & (1 << box)) ? LOCK_EV_DOOR_OPEN : LOCK_EV_DOOR_CLOSED);
+  }
+
+  // Relocks that are due
+  for (BankMask m = bank.relock; m; m &= m - 1) {
+    const int box = __builtin_ctz(m);
+    if ((int32_t)(now - bank.relockMs[box]) >= 0) {
+      bank.relock &= ~(1 << box);
+      bank_dispatch(box, LOCK_EV_TIMEOUT);
+    }
+  }
+
+  // Ping the next locked compartment
+  for (int i = 1; i <= LOCKER_BANK; i++) {
+    const int box = (bank.next + i) % LOCKER_BANK;
+    if (bank.state[box] == LOCK_LOCKED) {
+      bank_trig(box);
+      bank.pinged = box;
+      bank.next   = box;
+      break;
+    }
+  }
+
+  // Nothing left to watch
+  bool idle = !bank.relock && !bank.moving;
+  for (int box = 0; idle && box < LOCKER_BANK; box++) {
+    idle = (bank.state[box] == LOCK_DISABLED);
+  }
+  if (idle) {
+    timer_cancel(bankTickTimer);
+    lcd.clear();
+    digitalWrite(backlightPin, LOW);
+  }
+}
+
+// Function to set up the pins and outputs of every compartment; replaces initializeElectronicComponents()
+void locker_bank_init() {
+  for (int box = 0; box < LOCKER_BANK; box++) {
+    bank.state[box]  = LOCK_DISABLED;
+    bank.angle[box]  = bank.target[box] = maxAngle;
+    bank.distanceMm[box] = maxDistance * 10;
+  }
+  gpio_pulse_init(bankEcho, BANK_ECHO_PIN);
+  bank.pinged = -1;
+
+  bank_io_begin();
+  for (int box = 0; box < LOCKER_BANK; box++) {
+    bank_servo_write(box, bank.angle[box]);
+  }
+
+  pinMode(backlightPin, OUTPUT);
+  digitalWrite(backlightPin, LOW);
+  lcd.begin(16, 2);
+  bank_summarize();
+}
+
+// Function to follow the enable condition; replaces runElectronicComponents()
+void locker_bank_run() {
+  PROFILE_SCOPE(PROF_COMPONENTS);
+
+  const bool enabled = components_enabled();
+  if (enabled == bank.enabled) {
+    return;
+  }
+  bank.enabled = enabled;
+  if (enabled) {
+    digitalWrite(backlightPin, HIGH);
+    for (uint32_t& n : bank.scans) {
+      n = 0;
+    }
+    bank.scanFromMs = millis();
+    if (!bankTickTimer) {
+      bankTickTimer = timer_every(pingInterval, bank_tick);
+    }
+  }
+  for (int box = 0; box < LOCKER_BANK; box++) {
+    bank_dispatch(box, enabled ? LOCK_EV_ENABLE : LOCK_EV_DISABLE);
+  }
+}
+
+// Function to handle the "bank" console command: every compartment, and the scan rates
+void bank_command(int, const char**) {
+  const uint32_t ms = BlynkMax(millis() - bank.scanFromMs, 1UL);
+  uint32_t total = 0;
+  edgentConsole.printf(" Box  %-9s  %8s  %4s  %6s  %6s\n", "state", "distance", "conf", "scans", "per s");
+  for (int box = 0; box < LOCKER_BANK; box++) {
+    edgentConsole.printf(" %3d  %-9s  %5.1f cm  %3u%%  %6u  %6.2f%s\n", box + 1,
+                         lockStateNames[bank.state[box]], bank.distanceMm[box] / 10.0,
+                         bank.confidence[box], bank.scans[box], bank.scans[box] * 1000.0 / ms,
+                         (bank.doorOpen & (1 << box)) ? "  door open" : "");
+    total += bank.scans[box];
+  }
+  edgentConsole.printf(" All  %u scans in %.1f s, %.2f per s (%u events ignored)\n",
+                       total, ms / 1000.0, total * 1000.0 / ms, bank.ignored);
+}
+
+#endif
@@ -0,0 +1,277 @@
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+/*
+ * Deferred-formatting logger.
+ *
+ * LOG_E/W/I/D(fmt, ...) do not format anything: they copy the address of the
+ * format string (a literal, so it is interned in flash by the compiler) and
+ * the raw arguments into a RAM ring buffer. A low-priority task drains the
+ * ring, either formatting the records as text on Serial, or writing them
+ * as-is (LOG_OUTPUT_BINARY) for tools/log_decode.py, which looks the format
+ * strings up in the firmware ELF. Callers never wait for the UART.
+ *
+ * Record: 0xA5, u8 length of the rest, u32 ms timestamp, u32 format address,
+ *         u8 level, then the arguments in order: integers as 4 bytes (8 for
+ *         long long), floating point as an 8 byte double, strings as
+ *         u8 length + bytes. All little-endian.
+ *
+ * Messages below LOG_LEVEL are compiled out.
+ */
+
+#define LOG_LEVEL_NONE   0
+#define LOG_LEVEL_ERROR  1
+#define LOG_LEVEL_WARN   2
+#define LOG_LEVEL_INFO   3
+#define LOG_LEVEL_DEBUG  4
+
+#define LOG_SYNC         0xA5
+#define LOG_HEADER_SIZE  11    // Sync, length, timestamp, format, level
+#define LOG_RECORD_MAX   128   // Longer records are cut at the last whole argument
+#define LOG_STR_MAX      32    // Longer string arguments are truncated
+
+static uint8_t       logRing[LOG_RING_SIZE];
+static uint32_t      logHead    = 0;  // Total bytes written
+static uint32_t      logTail    = 0;  // Total bytes drained
+static uint32_t      logDropped = 0;  // Records lost because the ring was full
+static portMUX_TYPE  logMux     = portMUX_INITIALIZER_UNLOCKED;
+static TaskHandle_t  logTask    = NULL;
+
+// Builds one record on the stack of the caller
+class LogRecord {
+public:
+  LogRecord(uint8_t level, const char* fmt) : m_Len(LOG_HEADER_SIZE), m_Full(false) {
+    const uint32_t ts   = millis();
+    const uint32_t addr = (uint32_t)(uintptr_t)fmt;
+    m_Buf[0] = LOG_SYNC;
+    memcpy(m_Buf + 2, &ts, 4);
+    memcpy(m_Buf + 6, &addr, 4);
+    m_Buf[10] = level;
+  }
+
+  void add(int v)                 { put32(v); }
+  void add(unsigned v)            { put32(v); }
+  void add(long v)                { put32(v); }
+  void add(unsigned long v)       { put32(v); }
+  void add(short v)               { put32(v); }
+  void add(unsigned short v)      { put32(v); }
+  void add(char v)                { put32(v); }
+  void add(signed char v)         { put32(v); }
+  void add(unsigned char v)       { put32(v); }
+  void add(bool v)                { put32(v); }
+  void add(long long v)           { put(&v, 8); }
+  void add(unsigned long long v)  { put(&v, 8); }
+  void add(double v)              { put(&v, 8); }
+  void add(float v)               { add((double)v); }
+  void add(const void* v)         { put32((uintptr_t)v); }
+
+  void add(const char* s) {
+    const size_t len = s ? BlynkMin(strlen(s), (size_t)LOG_STR_MAX) : 0;
+    if (!m_Full && m_Len + 1 + len <= LOG_RECORD_MAX) {
+      m_Buf[m_Len++] = len;
+      memcpy(m_Buf + m_Len, s, len);
+      m_Len += len;
+    } else {
+      m_Full = true;
+    }
+  }
+
+  void addAll() {}
+
+  template <typename T, typename... Args>
+  void addAll(T v, Args... rest) {
+    add(v);
+    addAll(rest...);
+  }
+
+  // Function to copy the record into the ring, dropping it if there is no room
+  void commit() {
+    m_Buf[1] = m_Len - 2;
+    portENTER_CRITICAL_SAFE(&logMux);  // Also called from interrupt handlers
+    if (LOG_RING_SIZE - (logHead - logTail) < m_Len) {
+      logDropped++;
+    } else {
+      for (size_t i = 0; i < m_Len; i++) {
+        logRing[(logHead + i) % LOG_RING_SIZE] = m_Buf[i];
+      }
+      logHead += m_Len;
+    }
+    portEXIT_CRITICAL_SAFE(&logMux);
+  }
+
+private:
+  void put32(uint32_t v) {
+    put(&v, 4);
+  }
+
+  void put(const void* v, size_t len) {
+    if (!m_Full && m_Len + len <= LOG_RECORD_MAX) {
+      memcpy(m_Buf + m_Len, v, len);
+      m_Len += len;
+    } else {
+      m_Full = true;
+    }
+  }
+
+  uint8_t m_Buf[LOG_RECORD_MAX];
+  size_t  m_Len;
+  bool    m_Full;
+};
+
+template <typename... Args>
+void log_write(uint8_t level, const char* fmt, Args... args) {
+  LogRecord rec(level, fmt);
+  rec.addAll(args...);
+  rec.commit();
+}
+
+// Function to format a drained record as text, taking the argument types from the format
+static
+size_t log_format(char* out, size_t size, const char* fmt, const uint8_t* args, size_t argLen) {
+  size_t n = 0, pos = 0;
+  while (*fmt && n + 1 < size) {
+    if (*fmt != '%') {
+      out[n++] = *fmt++;
+      continue;
+    }
+    if (fmt[1] == '%') {
+      out[n++] = '%';
+      fmt += 2;
+      continue;
+    }
+
+    // Copy the flags, width and precision; drop the length modifiers but remember "ll"
+    char spec[16] = "%";
+    size_t sl = 1;
+    bool wide = false;
+    for (fmt++; *fmt && strchr("-+ #0123456789.hlzjt", *fmt); fmt++) {
+      if (*fmt == 'l' && fmt[1] == 'l') {
+        wide = true;
+      }
+      if (!strchr("hlzjt", *fmt) && sl < sizeof(spec) - 4) {
+        spec[sl++] = *fmt;
+      }
+    }
+    const char conv = *fmt;
+    if (!conv) {
+      break;
+    }
+    fmt++;
+
+    char tmp[48];
+    tmp[0] = '\0';
+    if (conv == 's') {
+      const size_t len = (pos < argLen) ? BlynkMin((size_t)args[pos], argLen - pos - 1) : 0;
+      char str[LOG_STR_MAX + 1];
+      memcpy(str, args + pos + 1, len);
+      str[len] = '\0';
+      pos += 1 + len;
+      spec[sl++] = 's'; spec[sl] = '\0';
+      snprintf(tmp, sizeof(tmp), spec, str);
+    } else if (strchr("fFeEgGaA", conv)) {
+      double v = 0;
+      if (pos + 8 <= argLen) { memcpy(&v, args + pos, 8); }
+      pos += 8;
+      spec[sl++] = conv; spec[sl] = '\0';
+      snprintf(tmp, sizeof(tmp), spec, v);
+    } else if (wide) {
+      long long v = 0;
+      if (pos + 8 <= argLen) { memcpy(&v, args + pos, 8); }
+      pos += 8;
+      spec[sl++] = 'l'; spec[sl++] = 'l'; spec[sl++] = conv; spec[sl] = '\0';
+      snprintf(tmp, sizeof(tmp), spec, v);
+    } else {
+      int32_t v = 0;
+      if (pos + 4 <= argLen) { memcpy(&v, args + pos, 4); }
+      pos += 4;
+      spec[sl++] = (conv == 'p') ? 'x' : conv; spec[sl] = '\0';
+      snprintf(tmp, sizeof(tmp), spec, v);
+    }
+    for (const char* t = tmp; *t && n + 1 < size; t++) {
+      out[n++] = *t;
+    }
+  }
+  out[n] = '\0';
+  return n;
+}
+
+// Function to take the oldest record out of the ring, returns its size or 0 if there is none
+static
+size_t log_pop(uint8_t* rec) {
+  size_t len = 0;
+  portENTER_CRITICAL(&logMux);
+  if (logHead != logTail) {
+    len = logRing[(logTail + 1) % LOG_RING_SIZE] + 2;
+    for (size_t i = 0; i < len; i++) {
+      rec[i] = logRing[(logTail + i) % LOG_RING_SIZE];
+    }
+    logTail += len;
+  }
+  portEXIT_CRITICAL(&logMux);
+  return len;
+}
+
+// Task writing the records out, in the background
+static
+void log_task(void*) {
+  static const char levels[] = "-EWID";
+  uint8_t rec[LOG_RECORD_MAX];
+  for (;;) {
+    ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(LOG_FLUSH_INTERVAL));
+    while (size_t len = log_pop(rec)) {
+#ifdef LOG_OUTPUT_BINARY
+      Serial.write(rec, len);
+#else
+      uint32_t ts, addr;
+      memcpy(&ts,   rec + 2, 4);
+      memcpy(&addr, rec + 6, 4);
+      const char* fmt = (const char*)(uintptr_t)addr;
+      char line[160];
+      int n = snprintf(line, sizeof(line), "[%u] %c: ", ts, levels[BlynkMin(rec[10], (uint8_t)4)]);
+      n += log_format(line + n, sizeof(line) - n - 1, fmt, rec + LOG_HEADER_SIZE, len - LOG_HEADER_SIZE);
+      line[n++] = '\n';
+      Serial.write((const uint8_t*)line, n);
+#endif
+    }
+  }
+}
+
+// Function to start the drain task
+void log_init() {
+  if (!logTask) {
+    xTaskCreatePinnedToCore(log_task, "log", LOG_TASK_STACK, NULL, LOG_TASK_PRIORITY, &logTask, LOG_TASK_CORE);
+  }
+}
+
+// Function to wait until the records written so far are out, e.g. before a deep sleep
+void log_flush(uint32_t timeoutMs) {
+  const uint32_t start = millis();
+  while (logTask && logTail != logHead && millis() - start < timeoutMs) {
+    xTaskNotifyGive(logTask);
+    delay(1);
+  }
+  Serial.flush();
+}
+
+#define LOG_AT(level, fmt, ...)  log_write(level, fmt, ##__VA_ARGS__)
+
+#if LOG_LEVEL >= LOG_LEVEL_ERROR
+  #define LOG_E(fmt, ...)  LOG_AT(LOG_LEVEL_ERROR, fmt, ##__VA_ARGS__)
+#else
+  #define LOG_E(fmt, ...)
+#endif
+#if LOG_LEVEL >= LOG_LEVEL_WARN
+  #define LOG_W(fmt, ...)  LOG_AT(LOG_LEVEL_WARN, fmt, ##__VA_ARGS__)
+#else
+  #define LOG_W(fmt, ...)
+#endif
+#if LOG_LEVEL >= LOG_LEVEL_INFO
+  #define LOG_I(fmt, ...)  LOG_AT(LOG_LEVEL_INFO, fmt, ##__VA_ARGS__)
+#else
+  #define LOG_I(fmt, ...)
+#endif
+#if LOG_LEVEL >= LOG_LEVEL_DEBUG
+  #define LOG_D(fmt, ...)  LOG_AT(LOG_LEVEL_DEBUG, fmt, ##__VA_ARGS__)
+#else
+  #define LOG_D(fmt, ...)
+#endif
@@ -0,0 +1,171 @@
+#include "esp_timer.h"
+
+/*
+ * Soft watchdog for the main loop. Edgent::run() feeds it once per pass; a
+ * periodic esp_timer checks how long the current pass has been running and,
+ * once it goes over LOOP_WD_BUDGET, takes a snapshot of the open profiler
+ * sections (which section, and the code address that opened each one).
+ * The stall is finalized with its full length when the loop comes back.
+ *
+ * The statistics live in RTC memory, so they survive a reset - including
+ * one caused by the stall itself (the task watchdog or a brownout).
+ */
+
+struct LoopStall {
+  uint32_t us;                       // Length of the stalled pass
+  uint8_t  depth;                    // Open sections at the time of the snapshot
+  uint8_t  sections[PROF_STACK_DEPTH];
+  uint32_t pcs[PROF_STACK_DEPTH];
+};
+
+struct LoopWdStats {
+  uint32_t  magic;
+  uint32_t  stalls;                            // Passes over budget
+  uint32_t  resetsInStall;                     // Resets that happened while the loop was stalled
+  uint16_t  sectionStalls[PROF_SECTION_MAX];   // Stalls by innermost open section
+  uint32_t  sectionMaxUs[PROF_SECTION_MAX];
+  LoopStall worst[LOOP_WD_WORST_MAX];          // Longest stalls, longest first
+  LoopStall current;                           // Stall in progress
+  uint8_t   pending;                           // current holds a stall in progress
+};
+
+#define LOOP_WD_MAGIC  0x4C574431
+
+RTC_NOINIT_ATTR LoopWdStats loopWd;
+
+static volatile uint32_t loopWdLastFeed  = 0;      // micros() at the start of the current pass
+static volatile bool     loopWdArmed     = false;  // The loop has started (setup() is not watched)
+static uint32_t          loopWdMaxPeriod = 0;      // Longest pass since boot
+static bool              loopWdReport    = false;  // A stall was recorded, publish the count
+static portMUX_TYPE      loopWdMux       = portMUX_INITIALIZER_UNLOCKED;
+
+// Function to get the section a stall is blamed on: the innermost open one
+static
+uint8_t loop_wd_section(const LoopStall& st) {
+  if (!st.depth) {
+    return PROF_LOOP;
+  }
+  return st.sections[BlynkMin(st.depth, (uint8_t)PROF_STACK_DEPTH) - 1];
+}
+
+// Function to add a finished stall to the statistics
+static
+void loop_wd_commit(const LoopStall& st) {
+  const uint8_t section = loop_wd_section(st);
+  loopWd.stalls++;
+  loopWd.sectionStalls[section]++;
+  if (st.us > loopWd.sectionMaxUs[section]) {
+    loopWd.sectionMaxUs[section] = st.us;
+  }
+
+  // Keep the longest ones, in order
+  int pos = LOOP_WD_WORST_MAX;
+  while (pos > 0 && loopWd.worst[pos - 1].us < st.us) {
+    pos--;
+  }
+  if (pos < LOOP_WD_WORST_MAX) {
+    memmove(&loopWd.worst[pos + 1], &loopWd.worst[pos], (LOOP_WD_WORST_MAX - pos - 1) * sizeof(LoopStall));
+    loopWd.worst[pos] = st;
+  }
+}
+
+// Function to check the running pass, called by the esp_timer task
+static
+void loop_wd_check(void*) {
+  const uint32_t elapsed = micros() - loopWdLastFeed;
+  if (!loopWdArmed || elapsed < LOOP_WD_BUDGET * 1000UL) {
+    return;
+  }
+  portENTER_CRITICAL(&loopWdMux);
+  LoopStall& st = loopWd.current;
+  if (!loopWd.pending) {
+    // First look at this stall: remember where the loop is
+    st.depth = profDepth;
+    for (int i = 0; i < PROF_STACK_DEPTH; i++) {
+      st.sections[i] = profStack[i].section;
+      st.pcs[i]      = profStack[i].pc;
+    }
+    loopWd.pending = 1;
+  }
+  st.us = elapsed;  // Keeps growing, so a reset still leaves a lower bound
+  portEXIT_CRITICAL(&loopWdMux);
+}
+
+// Function to mark the start of a loop pass
+void loop_watchdog_feed() {
+  const uint32_t now    = micros();
+  const uint32_t period = now - loopWdLastFeed;
+  bool stalled = false;
+
+  portENTER_CRITICAL(&loopWdMux);
+  loopWdLastFeed = now;
+  if (loopWd.pending) {
+    loopWd.pending = 0;
+    if (period >= LOOP_WD_BUDGET * 1000UL) {
+      loopWd.current.us = period;
+      loop_wd_commit(loopWd.current);
+      stalled = true;
+    }
+  }
+  portEXIT_CRITICAL(&loopWdMux);
+
+  if (!loopWdArmed) {
+    loopWdArmed = true;  // First pass: the time since boot is not a loop period
+    return;
+  }
+  if (period > loopWdMaxPeriod) {
+    loopWdMaxPeriod = period;
+  }
+  if (stalled) {
+    DEBUG_PRINTF("Loop stalled for %u ms in %s", period / 1000,
+                 profSectionNames[loop_wd_section(loopWd.current)]);
+    loopWdReport = true;
+  }
+#ifdef LOOP_WD_VPIN
+  if (loopWdReport && Blynk.connected()) {
+    loopWdReport = false;
+    Blynk.virtualWrite(LOOP_WD_VPIN, loopWd.stalls);
+  }
+#endif
+}
+
+// Function to clear the statistics
+void loop_watchdog_reset() {
+  portENTER_CRITICAL(&loopWdMux);
+  memset(&loopWd, 0, sizeof(loopWd));
+  loopWd.magic = LOOP_WD_MAGIC;
+  portEXIT_CRITICAL(&loopWdMux);
+  loopWdMaxPeriod = 0;
+}
+
+// Function to start the watchdog, keeping the statistics of previous boots
+void loop_watchdog_init() {
+  if (loopWd.magic != LOOP_WD_MAGIC) {
+    loop_watchdog_reset();  // Power-on: RTC memory holds garbage
+  } else if (loopWd.pending) {
+    // The device was reset in the middle of a stall
+    loopWd.pending = 0;
+    loopWd.resetsInStall++;
+    loop_wd_commit(loopWd.current);
+    loopWdReport = true;
+  }
+
+  esp_timer_create_args_t args = {};
+  args.callback = loop_wd_check;
+  args.name     = "loop_wd";
+  esp_timer_handle_t timer;
+  if (esp_timer_create(&args, &timer) == ESP_OK) {
+    esp_timer_start_periodic(timer, LOOP_WD_CHECK_INTERVAL * 1000ULL);
+  }
+}
+
+// Function to print a stall: its length, and the open sections with their code addresses
+template <typename Out>
+void loop_watchdog_print(Out& out, const LoopStall& st) {
+  out.printf("%6u ms ", st.us / 1000);
+  const int depth = BlynkMin(st.depth, (uint8_t)PROF_STACK_DEPTH);
+  for (int i = 0; i < depth; i++) {
+    out.printf(" %s@0x%08x", profSectionNames[st.sections[i]], st.pcs[i]);
+  }
+  out.printf("\n");
+}
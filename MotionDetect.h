@@ -0,0 +1,399 @@
+#include <stdint.h>
+#include <string.h>
+
+/*
+ * Motion detection on downscaled camera frames.
+ *
+ * Each grayscale frame is cut into MOTION_BLOCK x MOTION_BLOCK blocks, and
+ * every block is compared with an adaptive background: the mean absolute
+ * difference of its pixels. A block past MOTION_BLOCK_DIFF has changed, and
+ * a frame with at least MOTION_MIN_BLOCKS changed blocks has motion.
+ *
+ *  - The background follows each frame by 1/2^MOTION_LEARN of the way, so
+ *    slow light changes (clouds, dusk) are absorbed. A changed block only
+ *    moves one gray level per frame toward it: a person standing still
+ *    stays in view for seconds, and a parcel left there is absorbed in the
+ *    end instead of reading as motion for good.
+ *  - When most of the frame changes at once (a light switched on, the
+ *    exposure stepping), that is not motion: the frame becomes the
+ *    background.
+ *  - The first MOTION_WARMUP frames only build the background, learning at
+ *    half the way per frame.
+ *
+ * The kernel is SWAR: four pixels per 32-bit word, split into two 16-bit
+ * lanes each for the differences and the background update, so there is no
+ * per-pixel branch and no carry between pixels. The same code runs on the
+ * board and on the host, where tools/bench_host.cpp replays frame sequences
+ * through it; the core is kept free of Arduino dependencies for that.
+ *
+ * On the board (MOTION_ENABLE), a task takes a frame from the camera every
+ * MOTION_INTERVAL ms, decodes the JPEG at 1/2, 1/4 or 1/8 scale (at most
+ * MOTION_MAX_W x MOTION_MAX_H) and converts it to gray.
+ *
+ * The camera runs at UXGA (initializeCameraWeb()), and a frame above VGA
+ * costs a lot to decode even at 1/8 scale: scaling skips the IDCT but not
+ * the entropy decoding of the whole image, roughly 100-200 ms of core 0 at
+ * UXGA. The detector warns about such a frame size, and stretches its
+ * interval so that taking frames stays within MOTION_DUTY_PCT of its core,
+ * which it shares with the Wi-Fi stack. Setting VGA or less from the web
+ * page brings it back towards MOTION_INTERVAL.
+ *
+ * It pauses while a client holds the camera stream (power_set_streaming(),
+ * from the power governor).
+ */
+
+#define MOTION_BLOCK        8     // Side of a block (pixels)
+#define MOTION_MAX_W        200   // Largest frame the detector takes
+#define MOTION_MAX_H        150
+#define MOTION_BLOCKS_MAX   ((MOTION_MAX_W / MOTION_BLOCK) * (MOTION_MAX_H / MOTION_BLOCK))
+#define MOTION_BLOCK_DIFF   12    // Mean difference (gray levels) for a block to have changed
+#define MOTION_MIN_BLOCKS   4     // Changed blocks for a frame to have motion
+#define MOTION_GLOBAL_PCT   70    // Share of the blocks (%) changing at once that is a light change, not motion
+#define MOTION_LEARN        3     // The background moves 1/2^n of the way to each frame, outside the changed blocks
+#define MOTION_WARMUP       4     // Frames taken to build the background
+
+enum MotionFlags : uint8_t {
+  MOTION_SEEN     = 1 << 0,  // Enough blocks changed
+  MOTION_LIGHTING = 1 << 1,  // Most of the frame changed: relearned, not motion
+  MOTION_WARMING  = 1 << 2,  // Still building the background
+};
+
+struct MotionResult {
+  uint16_t changed;  // Blocks that changed
+  uint8_t  peak;     // Largest mean difference of a block
+  uint8_t  flags;
+};
+
+struct MotionDetector {
+  uint8_t* background;  // width * height, owned by the caller
+  uint16_t width;       // Of the frames, one byte per pixel, rows of width bytes
+  uint16_t height;
+  uint16_t cols;        // Whole blocks; the pixels past them are not looked at
+  uint16_t rows;
+  uint8_t  diff[MOTION_BLOCKS_MAX];  // Mean difference of each block in the last frame
+  uint32_t frames;
+  uint32_t motionFrames;
+  uint32_t lightingFrames;
+};
+
+// Function to set a detector up for frames of a size, with the buffer for its background
+bool motion_detector_init(MotionDetector& m, uint8_t* background, uint16_t width, uint16_t height) {
+  if (width > MOTION_MAX_W || height > MOTION_MAX_H || width < MOTION_BLOCK || height < MOTION_BLOCK) {
+    return false;
+  }
+  memset(&m, 0, sizeof(m));
+  m.background = background;
+  m.width      = width;
+  m.height     = height;
+  m.cols       = width / MOTION_BLOCK;
+  m.rows       = height / MOTION_BLOCK;
+  return true;
+}
+
+static inline
+uint32_t motion_load(const uint8_t* p) {
+  uint32_t w;
+  memcpy(&w, p, sizeof(w));  // One load when aligned, and legal when not
+  return w;
+}
+
+// Function to get |a - b| in two 16-bit lanes holding one pixel each
+static inline
+uint32_t motion_absdiff_lanes(uint32_t a, uint32_t b) {
+  const uint32_t t   = (a | 0x01000100) - b;    // 256 + a - b per lane: no borrow between lanes
+  const uint32_t neg = ~(t >> 8) & 0x00010001;  // 1 in the lanes where a < b
+  return ((t & 0x00FF00FF) ^ (neg * 0xFF)) + neg;
+}
+
+// Function to get the differences of four pixels, summed into two 16-bit lanes
+static inline
+uint32_t motion_sad4(uint32_t a, uint32_t b) {
+  return motion_absdiff_lanes(a & 0x00FF00FF, b & 0x00FF00FF) +
+         motion_absdiff_lanes((a >> 8) & 0x00FF00FF, (b >> 8) & 0x00FF00FF);
+}
+
+// Function to move the background of two 16-bit lanes 1/2^shift of the way to the frame, rounded
+static inline
+uint32_t motion_learn_lanes(uint32_t f, uint32_t bg, int shift) {
+  const uint32_t lanes = 0x00010001;
+  const uint32_t t     = (f | 0x01000100) - bg + (1 << shift >> 1) * lanes;  // 256 + f - bg + half, 10 bits
+  const uint32_t step  = (t >> shift) & ((0x3FF >> shift) * lanes);
+  return bg + step - (0x100 >> shift) * lanes;  // bg + round((f - bg) / 2^shift)
+}
+
+// Function to move the background of two 16-bit lanes one level toward the frame
+static inline
+uint32_t motion_creep_lanes(uint32_t f, uint32_t bg) {
+  const uint32_t t  = (f | 0x01000100) - bg;
+  const uint32_t up = ((t - 0x00010001) >> 8) & 0x00010001;  // f > bg
+  const uint32_t dn = ~(t >> 8) & 0x00010001;                // f < bg
+  return bg + up - dn;
+}
+
+// Function to update the background of four pixels: by 1/2^shift of the way, or one level with shift 0
+static inline
+uint32_t motion_learn4(uint32_t f, uint32_t bg, int shift) {
+  const uint32_t fe = f & 0x00FF00FF, fo = (f >> 8) & 0x00FF00FF;
+  const uint32_t be = bg & 0x00FF00FF, bo = (bg >> 8) & 0x00FF00FF;
+  if (!shift) {
+    return motion_creep_lanes(fe, be) | (motion_creep_lanes(fo, bo) << 8);
+  }
+  return motion_learn_lanes(fe, be, shift) | (motion_learn_lanes(fo, bo, shift) << 8);
+}
+
+// Function to get the mean difference of a block with the background
+static
+uint8_t motion_block_diff(const uint8_t* frame, const uint8_t* bg, uint16_t stride) {
+  uint32_t acc = 0;  // Two lanes of at most 32 * 255
+  for (int y = 0; y < MOTION_BLOCK; y++) {
+    for (int x = 0; x < MOTION_BLOCK; x += 4) {
+      acc += motion_sad4(motion_load(frame + x), motion_load(bg + x));
+    }
+    frame += stride;
+    bg    += stride;
+  }
+  return ((acc & 0xFFFF) + (acc >> 16)) / (MOTION_BLOCK * MOTION_BLOCK);
+}
+
+// Function to move the background of a block toward the frame
+static
+void motion_block_learn(const uint8_t* frame, uint8_t* bg, uint16_t stride, int shift) {
+  for (int y = 0; y < MOTION_BLOCK; y++) {
+    for (int x = 0; x < MOTION_BLOCK; x += 4) {
+      const uint32_t w = motion_learn4(motion_load(frame + x), motion_load(bg + x), shift);
+      memcpy(bg + x, &w, sizeof(w));
+    }
+    frame += stride;
+    bg    += stride;
+  }
+}
+
+// Function to compare a frame with the background, then update the background with it
+MotionResult motion_detect(MotionDetector& m, const uint8_t* frame) {
+  MotionResult r = { 0, 0, 0 };
+  const uint16_t stride = m.width;
+  const int blocks = m.cols * m.rows;
+
+  if (m.frames++ == 0) {
+    memcpy(m.background, frame, (size_t)m.width * m.height);
+    r.flags = MOTION_WARMING;
+    return r;
+  }
+
+  for (int b = 0; b < blocks; b++) {
+    const size_t at = (size_t)(b / m.cols) * MOTION_BLOCK * stride + (b % m.cols) * MOTION_BLOCK;
+    const uint8_t d = motion_block_diff(frame + at, m.background + at, stride);
+    m.diff[b] = d;
+    if (d >= MOTION_BLOCK_DIFF) {
+      r.changed++;
+    }
+    if (d > r.peak) {
+      r.peak = d;
+    }
+  }
+
+  if (m.frames <= MOTION_WARMUP) {
+    r.flags = MOTION_WARMING;
+  } else if (r.changed * 100 > blocks * MOTION_GLOBAL_PCT) {
+    memcpy(m.background, frame, (size_t)m.width * m.height);
+    r.flags = MOTION_LIGHTING;
+    m.lightingFrames++;
+    return r;
+  } else if (r.changed >= MOTION_MIN_BLOCKS) {
+    r.flags = MOTION_SEEN;
+    m.motionFrames++;
+  }
+
+  for (int b = 0; b < blocks; b++) {
+    const size_t at = (size_t)(b / m.cols) * MOTION_BLOCK * stride + (b % m.cols) * MOTION_BLOCK;
+    const int shift = (r.flags & MOTION_WARMING) ? 1 :  // Settle quickly on the scene
+                      m.diff[b] >= MOTION_BLOCK_DIFF ? 0 : MOTION_LEARN;
+    motion_block_learn(frame + at, m.background + at, stride, shift);
+  }
+  return r;
+}
+
+#if defined(ARDUINO) && defined(MOTION_ENABLE)
+
+#include "esp_camera.h"
+#include "img_converters.h"
+#include "esp_heap_caps.h"
+
+struct MotionStats {
+  uint32_t lastFrameMs;   // millis() of the last frame looked at
+  uint32_t lastMotionMs;  // millis() of the last frame with motion
+  uint32_t events;        // Motion after MOTION_HOLD ms without any
+  uint32_t decodeErrors;
+  uint32_t grabUs;        // Last frame: taking and decoding it
+  uint32_t kernelUs;      // Last frame: the detector
+  uint32_t kernelMaxUs;
+  MotionResult last;
+};
+
+static MotionDetector motion;
+static MotionStats    motionStats;
+static uint8_t*       motionFrame  = NULL;  // Decoded RGB565, then gray in place
+static uint8_t*       motionBg     = NULL;
+static volatile bool  motionPaused = false;
+static TaskHandle_t   motionTask   = NULL;
+static uint32_t       motionWaitMs = MOTION_INTERVAL;  // Time between frames, stretched for costly ones
+
+// Function to tell whether the camera saw motion in the last ms milliseconds
+bool motion_recent(uint32_t ms) {
+  return motionStats.events && millis() - motionStats.lastMotionMs < ms;
+}
+
+// Function to tell whether the detector is looking at frames, i.e. has a say on what is in front of the box
+bool motion_watching() {
+  return motionStats.lastFrameMs && millis() - motionStats.lastFrameMs < 4 * motionWaitMs + 1000;  // A few frames late at most
+}
+
+// Function to leave the camera to a stream, and to take it back after; called by power_set_streaming()
+void motion_set_paused(bool paused) {
+  motionPaused = paused;
+}
+
+// Function to turn RGB565 pixels (big-endian, as jpg2rgb565 writes them) into gray, in place
+static
+void motion_rgb565_to_gray(uint8_t* buf, size_t pixels) {
+  for (size_t i = 0; i < pixels; i++) {
+    const uint8_t hi = buf[2 * i], lo = buf[2 * i + 1];
+    const uint32_t r = hi & 0xF8;
+    const uint32_t g = ((hi & 0x07) << 5) | ((lo & 0xE0) >> 3);
+    const uint32_t b = (lo & 0x1F) << 3;
+    buf[i] = (r * 77 + g * 150 + b * 29) >> 8;  // BT.601 luma
+  }
+}
+
+// Function to decode a camera frame to gray at the scale that fits the detector
+static
+bool motion_grab(const camera_fb_t* fb) {
+  if (fb->format != PIXFORMAT_JPEG) {
+    return false;
+  }
+  int scale = 0;
+  while (scale < JPG_SCALE_8X && ((fb->width >> scale) > MOTION_MAX_W || (fb->height >> scale) > MOTION_MAX_H)) {
+    scale++;
+  }
+  const uint16_t w = fb->width >> scale, h = fb->height >> scale;
+  if (w != motion.width || h != motion.height) {
+    // First frame, or the frame size was changed from the web page
+    if (!motion_detector_init(motion, motionBg, w, h)) {
+      return false;
+    }
+    LOG_I("Motion: %ux%u frames at 1/%d scale", w, h, 1 << scale);
+    if (fb->width > 640) {
+      LOG_W("Motion: %ux%u frames are slow to decode, set VGA or less from the camera page",
+            fb->width, fb->height);
+    }
+  }
+  if (!jpg2rgb565(fb->buf, fb->len, motionFrame, (jpg_scale_t)scale)) {
+    return false;
+  }
+  motion_rgb565_to_gray(motionFrame, (size_t)w * h);
+  return true;
+}
+
+// Task looking for motion in the camera frames, in the background
+static
+void motion_task(void*) {
+  for (;;) {
+    vTaskDelay(pdMS_TO_TICKS(motionWaitMs));
+    if (motionPaused || !esp_camera_sensor_get()) {
+      continue;  // Streaming, or the camera is not up (yet)
+    }
+
+    int64_t t = esp_timer_get_time();
+    camera_fb_t* fb = esp_camera_fb_get();
+    if (!fb) {
+      continue;
+    }
+    const bool ok = motion_grab(fb);
+    esp_camera_fb_return(fb);
+    if (!ok) {
+      motionStats.decodeErrors++;
+      continue;
+    }
+    motionStats.grabUs = esp_timer_get_time() - t;
+    motionWaitMs = BlynkMax((uint32_t)MOTION_INTERVAL, motionStats.grabUs / (10 * MOTION_DUTY_PCT));
+
+    t = esp_timer_get_time();
+    const MotionResult r = motion_detect(motion, motionFrame);
+    motionStats.kernelUs    = esp_timer_get_time() - t;
+    motionStats.kernelMaxUs = BlynkMax(motionStats.kernelMaxUs, motionStats.kernelUs);
+    motionStats.last        = r;
+
+    const uint32_t now = millis();
+    motionStats.lastFrameMs = now;
+    if (r.flags & MOTION_SEEN) {
+      if (!motion_recent(MOTION_HOLD)) {
+        motionStats.events++;
+        LOG_I("Motion: %u blocks changed", r.changed);
+      }
+      motionStats.lastMotionMs = now;
+    }
+  }
+}
+
+// Function to allocate the frame buffers and start the detector task; it waits for the camera itself
+void motion_init() {
+  if (motionTask) {
+    return;
+  }
+  const size_t pixels = MOTION_MAX_W * MOTION_MAX_H;
+  motionFrame = (uint8_t*)heap_caps_malloc(pixels * 2, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+  motionBg    = (uint8_t*)heap_caps_malloc(pixels, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+  if (!motionFrame) {
+    motionFrame = (uint8_t*)malloc(pixels * 2);
+  }
+  if (!motionBg) {
+    motionBg = (uint8_t*)malloc(pixels);
+  }
+  if (!motionFrame || !motionBg) {
+    free(motionFrame);
+    free(motionBg);
+    motionFrame = motionBg = NULL;
+    LOG_E("Motion: no memory for the frames");
+    return;
+  }
+  xTaskCreatePinnedToCore(motion_task, "motion", MOTION_TASK_STACK, NULL,
+                          MOTION_TASK_PRIORITY, &motionTask, MOTION_TASK_CORE);
+}
+
+// Function to handle the "motion" console command: the counters, or the block differences with "map"
+void motion_command(int argc, const char** argv) {
+  if (argc >= 1 && 0 == strcmp(argv[0], "map")) {
+    static const char shades[] = " .:-=+*#";
+    for (int y = 0; y < motion.rows; y++) {
+      char line[MOTION_MAX_W / MOTION_BLOCK + 1];
+      for (int x = 0; x < motion.cols; x++) {
+        const uint8_t d = motion.diff[y * motion.cols + x];
+        line[x] = d >= MOTION_BLOCK_DIFF ? '#' : shades[d * 7 / MOTION_BLOCK_DIFF];
+      }
+      line[motion.cols] = '\0';
+      edgentConsole.printf(" |%s|\n", line);
+    }
+    return;
+  }
+  const MotionStats& s = motionStats;
+  edgentConsole.printf(" Detector:        %s, %ux%u frames in %ux%u blocks\n",
+                       motionPaused ? "paused (streaming)" : motion_watching() ? "watching" : "no frames",
+                       motion.width, motion.height, motion.cols, motion.rows);
+  edgentConsole.printf(" Frames:          %u (%u with motion, %u light changes, %u not decoded)\n",
+                       motion.frames, motion.motionFrames, motion.lightingFrames, s.decodeErrors);
+  edgentConsole.printf(" Last frame:      %u blocks changed, peak %u\n", s.last.changed, s.last.peak);
+  if (s.events) {
+    edgentConsole.printf(" Last motion:     %u ms ago (%u events)\n", millis() - s.lastMotionMs, s.events);
+  }
+  edgentConsole.printf(" Time:            grab %u us, detect %u us (max %u us), every %u ms\n",
+                       s.grabUs, s.kernelUs, s.kernelMaxUs, motionWaitMs);
+}
+
+#elif defined(ARDUINO)
+
+  bool motion_recent(uint32_t) { return false; }
+  bool motion_watching() { return false; }
+  void motion_set_paused(bool) {}
+  void motion_init() {}
+
+#endif
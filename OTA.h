@@ -1,116 +1,328 @@
 #include <WiFi.h>
 #include <Update.h>
 #include <HTTPClient.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
 
 // URL for Over-The-Air update
-String overTheAirURL;
+FixedString<256> overTheAirURL;
 
-// External timer used for scheduling events
-extern BlynkTimer edgentTimer;
+// Statistics of the last OTA update, kept in RTC memory so they survive the reboot into the new image
+struct OtaStats {
+  uint32_t magic;
+  uint8_t  encoding;     // OTA_ENCODING_* of the download
+  uint32_t bytesIn;      // Bytes transferred
+  uint32_t bytesOut;     // Bytes of firmware written
+  uint32_t decodeUs;     // Time spent decoding and writing
+  uint32_t totalMs;      // End-to-end update time, request to reboot
+  uint16_t resumes;      // Times the download was resumed after a drop
+};
 
-// Function to handle OTA update requests
-BLYNK_WRITE(InternalPinOTA) {
-  // Read the OTA URL from the parameter
-  overTheAirURL = param.asString();
+#define OTA_STATS_MAGIC  0x4F544131
 
-  // Set a timeout to start the OTA process after 2 seconds
-  edgentTimer.setTimeout(2000L, [](){
-    // Log event for OTA start
-    Blynk.logEvent("sys_ota", "OTA started");
+RTC_NOINIT_ATTR OtaStats otaStats;
 
-    // Disconnect from Blynk to avoid interference with the OTA process
-    Blynk.disconnect();
+// State of the background OTA job
+enum OtaJobState {
+  OTA_IDLE,
+  OTA_DOWNLOADING,
+  OTA_DONE,
+  OTA_FAILED
+};
 
-    // Set the state to OTA upgrade mode
-    BlynkState::set(MODE_OTA_UPGRADE);
-  });
-}
+struct OtaJob {
+  volatile uint8_t  state;
+  volatile bool     cancel;     // Set by the main loop to stop the download
+  volatile uint32_t total;      // Size of the download, 0 until the first response
+  volatile uint32_t received;   // Bytes received so far
+  uint32_t startTime;           // millis() when the job was started
+  uint32_t lastReport;          // millis() of the last published metrics
+  const char* error;            // Why the job failed
+};
 
-// Function to handle the OTA process
-void enterOTA() {
-  // Set the state to OTA upgrade mode
-  BlynkState::set(MODE_OTA_UPGRADE);
+static OtaJob otaJob = { OTA_IDLE, false, 0, 0, 0, 0, NULL };
 
-  // Print the firmware update URL for debugging
-  DEBUG_PRINT(String("Firmware update URL: ") + overTheAirURL);
+// Function to get a printable name of the OTA job state
+static
+const char* ota_state_str(uint8_t state) {
+  switch (state) {
+    case OTA_IDLE:        return "idle";
+    case OTA_DOWNLOADING: return "downloading";
+    case OTA_DONE:        return "done";
+    default:              return "failed";
+  }
+}
 
-  // Initialize HTTP client
-  HTTPClient http;
-  http.begin(overTheAirURL);
+// Function to get the download rate of the running job, in bytes per second
+static
+uint32_t ota_rate() {
+  const uint32_t elapsed = millis() - otaJob.startTime;
+  return elapsed ? (uint64_t)otaJob.received * 1000 / elapsed : 0;
+}
 
-  // Collect MD5 header for validation
-  const char* headerkeys[] = { "x-MD5" };
+// Function to send the OTA request, from the given offset of the download
+static
+int ota_request(HTTPClient& http, uint32_t offset, const char* etag) {
+  http.end();
+  http.begin(overTheAirURL.c_str());
+  http.setTimeout(OTA_READ_TIMEOUT);
+
+  // Collect the digests for validation, the encoding of the image, and what is needed to resume
+  const char* headerkeys[] = { "x-MD5", "x-SHA256", "x-OTA-Encoding", "x-OTA-Size", "ETag", "Content-Range" };
   http.collectHeaders(headerkeys, sizeof(headerkeys)/sizeof(char*));
 
+  if (offset) {
+    FixedString<24> range;
+    range.appendf("bytes=%u-", offset);
+    http.addHeader("Range", range.c_str());
+    if (etag[0]) {
+      http.addHeader("If-Range", etag);  // Get the whole file again if it has changed meanwhile
+    }
+  }
+  return http.GET();
+}
+
+// Function to download the update and write it to flash, resuming after drops.
+// Runs in the OTA task; returns NULL on success or the reason of the failure.
+static
+const char* ota_download() {
+  HTTPClient http;
+
   // Send HTTP GET request
-  int httpCode = http.GET();
+  int httpCode = ota_request(http, 0, "");
   if (httpCode != HTTP_CODE_OK) {
-    // If the response is not 200, set the state to error and return
-    DEBUG_PRINT("HTTP response should be 200");
-    BlynkState::set(MODE_ERROR);
-    return;
+    DEBUG_PRINTF("OTA HTTP response %d", httpCode);
+    return "HTTP response should be 200";
   }
 
-  // Get the content length of the firmware
+  // Get the content length of the download
   int contentLength = http.getSize();
   if (contentLength <= 0) {
-    // If content length is not defined, set the state to error and return
-    DEBUG_PRINT("Content-Length not defined");
-    BlynkState::set(MODE_ERROR);
-    return;
+    return "Content-Length not defined";
   }
+  otaJob.total = contentLength;
+  const FixedString<64> etag = http.header("ETag").c_str();
 
-  // Begin the OTA update
-  bool canBegin = Update.begin(contentLength);
-  if (!canBegin) {
-    // If there's not enough space, set the state to error and return
-    DEBUG_PRINT("Not enough space to begin OTA");
-    BlynkState::set(MODE_ERROR);
-    return;
+  // Work out how the download is encoded, and how large the decoded image is
+  uint8_t encoding = http.hasHeader("x-OTA-Encoding")
+                   ? ota_encoding_parse(http.header("x-OTA-Encoding").c_str())
+                   : ota_encoding_from_url(overTheAirURL);
+  DEBUG_PRINTF("OTA encoding: %s", ota_encoding_str(encoding));
+
+  OtaFlashSink flash;
+  if (encoding == OTA_ENCODING_RAW) {
+    flash.setSize(contentLength);
+  } else if (http.hasHeader("x-OTA-Size")) {
+    flash.setSize(http.header("x-OTA-Size").toInt());
   }
 
-  // Check for MD5 header and set MD5 for update validation
+  // Check for the digest headers and set them for update validation
+  if (http.hasHeader("x-SHA256")) {
+    String sha = http.header("x-SHA256");
+    if (sha.length() == 64) {
+      DEBUG_PRINTF("Expected SHA-256: %s", sha.c_str());
+      flash.setSHA256(sha.c_str());
+    }
+  }
   if (http.hasHeader("x-MD5")) {
     String md5 = http.header("x-MD5");
     if (md5.length() == 32) {
       md5.toLowerCase();
-      DEBUG_PRINT("Expected MD5: " + md5);
-      Update.setMD5(md5.c_str());
+      DEBUG_PRINTF("Expected MD5: %s", md5.c_str());
+      flash.setMD5(md5.c_str());
     }
   }
+#ifdef OTA_REQUIRE_SHA256
+  if (!flash.hasSHA256()) {
+    return "x-SHA256 header missing";
+  }
+#endif
+
+  // Chain the decoders: inflate first, then apply the delta
+  OtaDeltaSink   delta(flash);
+  OtaSink&       decoded = (encoding & OTA_ENCODING_DELTA) ? (OtaSink&)delta : (OtaSink&)flash;
+  OtaInflateSink inflate(decoded);
+  OtaSink&       input = (encoding & OTA_ENCODING_GZIP) ? (OtaSink&)inflate : decoded;
+
+  otaStats.magic    = OTA_STATS_MAGIC;
+  otaStats.encoding = encoding;
+  otaStats.bytesIn  = 0;
+  otaStats.bytesOut = 0;
+  otaStats.decodeUs = 0;
+  otaStats.resumes  = 0;
+
+  // Stream the download through the decoders to flash, in chunks
+  uint8_t buff[OTA_CHUNK_SIZE];
+  while (otaJob.received < (uint32_t)contentLength) {
+    if (otaJob.cancel) {
+      return "Cancelled";
+    }
+
+    WiFiClient* client = http.getStreamPtr();
+    size_t len = 0;
+    if (client && (client->connected() || client->available())) {
+      len = client->readBytes(buff, BlynkMin(sizeof(buff), (size_t)(contentLength - otaJob.received)));
+    }
+
+    if (!len) {
+      // The connection dropped or stalled: ask for the rest of the file
+      if (++otaStats.resumes > OTA_RESUME_MAX) {
+        return "Too many interruptions";
+      }
+      DEBUG_PRINTF("OTA interrupted at %u / %d bytes, resuming", otaJob.received, contentLength);
+      vTaskDelay(pdMS_TO_TICKS(OTA_RESUME_DELAY * otaStats.resumes));
+
+      httpCode = ota_request(http, otaJob.received, etag);
+      FixedString<24> expected;
+      expected.appendf("bytes %u-", otaJob.received);
+      if (httpCode != HTTP_CODE_PARTIAL_CONTENT ||
+          strncmp(http.header("Content-Range").c_str(), expected.c_str(), expected.length()))
+      {
+        // The server cannot resume, or the file has changed since the first request
+        DEBUG_PRINTF("OTA resume response %d", httpCode);
+        return "Server cannot resume the download";
+      }
+      continue;
+    }
+
+    otaJob.received  += len;
+    otaStats.bytesIn  = otaJob.received;
+
+    const uint32_t t = micros();
+    const bool ok = input.write(buff, len);
+    otaStats.decodeUs += micros() - t;
+    if (!ok) {
+      return "Invalid image";
+    }
+  }
+  http.end();
+  otaStats.bytesOut = flash.written();
+
+  // End the update process, checking the digests
+  if (!input.finish()) {
+    DEBUG_PRINTF("Error #%d", Update.getError());
+    return "Verification failed";
+  }
+
+  // Check if the update is finished
+  if (!Update.isFinished()) {
+    return "Update failed";
+  }
+
+  otaStats.totalMs = millis() - otaJob.startTime;
+  DEBUG_PRINTF("OTA %s: %u bytes in, %u bytes out, decode %u KB/s, total %u ms, %u resumes",
+               ota_encoding_str(encoding), otaStats.bytesIn, otaStats.bytesOut,
+               otaStats.bytesOut / BlynkMax(otaStats.decodeUs / 1000, 1u), otaStats.totalMs,
+               otaStats.resumes);
+  return NULL;
+}
+
+// Background task running the download, so Blynk and the application keep running
+static
+void ota_task(void*) {
+  otaJob.error = ota_download();
+  if (otaJob.error && Update.isRunning()) {
+    Update.abort();  // Whichever step failed, so the next update can begin
+  }
+  otaJob.state = otaJob.error ? OTA_FAILED : OTA_DONE;
+  vTaskDelete(NULL);
+}
+
+// Function to start the OTA update in the background, returns false if one is already running
+bool ota_start(const char* url) {
+  if (otaJob.state == OTA_DOWNLOADING) {
+    return false;
+  }
+  overTheAirURL = url;
+  if (overTheAirURL.truncated()) {
+    DEBUG_PRINT("Firmware update URL too long");
+    return false;
+  }
+
+  // Print the firmware update URL for debugging
+  DEBUG_PRINTF("Firmware update URL: %s", overTheAirURL.c_str());
 
   // Close file system if defined
 #ifdef BLYNK_FS
   BLYNK_FS.end();
 #endif
 
-  // Get the stream of the firmware
-  Client& client = http.getStream();
-  // Write the firmware to flash
-  int written = Update.writeStream(client);
-  if (written != contentLength) {
-    // If the written bytes do not match the content length, set the state to error and return
-    DEBUG_PRINT(String("OTA written ") + written + " / " + contentLength + " bytes");
-    BlynkState::set(MODE_ERROR);
-    return;
+  otaJob.state      = OTA_DOWNLOADING;
+  otaJob.cancel     = false;
+  otaJob.total      = 0;
+  otaJob.received   = 0;
+  otaJob.startTime  = millis();
+  otaJob.lastReport = 0;
+  otaJob.error      = NULL;
+
+  if (xTaskCreatePinnedToCore(ota_task, "OTA", OTA_TASK_STACK, NULL,
+                              OTA_TASK_PRIORITY, NULL, OTA_TASK_CORE) != pdPASS)
+  {
+    otaJob.state = OTA_FAILED;
+    otaJob.error = "Cannot start the OTA task";
+    return false;
   }
+  return true;
+}
 
-  // End the update process
-  if (!Update.end()) {
-    // If there's an error ending the update, set the state to error and return
-    DEBUG_PRINT("Error #" + String(Update.getError()));
-    BlynkState::set(MODE_ERROR);
-    return;
+// Function to stop the running OTA update
+void ota_cancel() {
+  if (otaJob.state == OTA_DOWNLOADING) {
+    otaJob.cancel = true;
   }
+}
 
-  // Check if the update is finished
-  if (!Update.isFinished()) {
-    // If the update is not finished, set the state to error and return
-    DEBUG_PRINT("Update failed.");
-    BlynkState::set(MODE_ERROR);
-    return;
+// Function to publish the progress of the OTA job and act on its result, run by the main loop
+void ota_poll() {
+  switch (otaJob.state) {
+  case OTA_DOWNLOADING: {
+    if (millis() - otaJob.lastReport < OTA_METRICS_INTERVAL || !otaJob.total) {
+      break;
+    }
+    otaJob.lastReport = millis();
+    const unsigned progress = (uint64_t)otaJob.received * 100 / otaJob.total;
+    DEBUG_PRINTF("OTA %u%% (%u / %u bytes, %u B/s)", progress, otaJob.received, otaJob.total, ota_rate());
+    TRACE_INSTANT(TRACE_OTA, progress);
+#ifdef OTA_PROGRESS_VPIN
+    Blynk.virtualWrite(OTA_PROGRESS_VPIN, progress);
+#endif
+#ifdef OTA_RATE_VPIN
+    Blynk.virtualWrite(OTA_RATE_VPIN, ota_rate() / 1024);
+#endif
+  } break;
+  case OTA_DONE:
+    Blynk.logEvent("sys_ota", "OTA finished");
+    BlynkState::set(MODE_OTA_UPGRADE);  // Reboot into the new image
+    break;
+  case OTA_FAILED:
+    FixedString<64> msg;
+    msg.appendf("OTA failed: %s", otaJob.error);
+    DEBUG_PRINT(msg.c_str());
+    Blynk.logEvent("sys_ota", msg.c_str());
+#ifdef BLYNK_FS
+    BLYNK_FS.begin(true);  // Unmounted by ota_start()
+#endif
+    otaJob.state = OTA_IDLE;
+    break;
   }
+}
 
+// Function to set up the polling of the OTA job
+void ota_init() {
+  timer_every(500, ota_poll);
+}
+
+// Function to handle OTA update requests
+BLYNK_WRITE(InternalPinOTA) {
+  // Log event for OTA start
+  Blynk.logEvent("sys_ota", "OTA started");
+
+  // Download in the background; Blynk stays connected meanwhile
+  ota_start(param.asStr());
+}
+
+// Function to finish the OTA process, once the image is downloaded and verified
+void enterOTA() {
   // Print success message and reboot the device
   DEBUG_PRINT("=== Update successfully completed. Rebooting.");
   restartMCU();
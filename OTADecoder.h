@@ -0,0 +1,491 @@
+#include <Update.h>
+#include "mbedtls/sha256.h"
+
+// Include external C libraries for ESP32 partition and OTA operations
+extern "C" {
+  #include "esp_partition.h"
+  #include "esp_ota_ops.h"
+}
+
+// The inflater from the ROM copy of miniz, so it costs no flash
+#if __has_include("rom/miniz.h")
+  #include "rom/miniz.h"
+#else
+  #include "esp32/rom/miniz.h"
+#endif
+#if __has_include("rom/crc.h")
+  #include "rom/crc.h"
+#else
+  #include "esp32/rom/crc.h"
+#endif
+
+/*
+ * OTA decoding pipeline. The download is pushed through a chain of sinks:
+ *
+ *   HTTP stream -> [OtaInflateSink] -> [OtaDeltaSink] -> OtaFlashSink -> Update
+ *
+ * Every stage works on whatever chunk it gets, with a fixed amount of RAM,
+ * so the whole image never has to be held in memory.
+ */
+
+// Encodings of an OTA download (bit flags, as a delta patch may also be compressed)
+#define OTA_ENCODING_RAW    0x00
+#define OTA_ENCODING_GZIP   0x01
+#define OTA_ENCODING_DELTA  0x02
+
+// Function to parse the encoding name sent in the x-OTA-Encoding header
+static
+uint8_t ota_encoding_parse(const char* name) {
+  uint8_t enc = OTA_ENCODING_RAW;
+  if (strstr(name, "gzip"))  { enc |= OTA_ENCODING_GZIP; }
+  if (strstr(name, "delta")) { enc |= OTA_ENCODING_DELTA; }
+  return enc;
+}
+
+// Function to check if the first len characters of a string end with a suffix
+static
+bool ota_ends_with(const char* str, size_t len, const char* suffix) {
+  const size_t sl = strlen(suffix);
+  return len >= sl && 0 == memcmp(str + len - sl, suffix, sl);
+}
+
+// Function to guess the encoding from the file name when the server sends no header
+static
+uint8_t ota_encoding_from_url(const char* url) {
+  uint8_t enc = OTA_ENCODING_RAW;
+  size_t len = strlen(url);
+  if (ota_ends_with(url, len, ".gz"))  { enc |= OTA_ENCODING_GZIP;  len -= 3; }
+  if (ota_ends_with(url, len, ".dlt")) { enc |= OTA_ENCODING_DELTA; }
+  return enc;
+}
+
+// Function to get a printable name of an encoding
+static
+const char* ota_encoding_str(uint8_t enc) {
+  switch (enc) {
+    case OTA_ENCODING_GZIP:                       return "gzip";
+    case OTA_ENCODING_DELTA:                      return "delta";
+    case OTA_ENCODING_DELTA | OTA_ENCODING_GZIP:  return "delta+gzip";
+    default:                                      return "raw";
+  }
+}
+
+// A stage of the decoding pipeline
+class OtaSink {
+public:
+  virtual ~OtaSink() {}
+  virtual bool write(const uint8_t* data, size_t len) = 0;  // Consume a chunk, false on error
+  virtual bool finish() = 0;                                 // The input is complete
+};
+
+// Last stage: writes the decoded image to the update partition, hashing it on the way
+class OtaFlashSink : public OtaSink {
+public:
+  OtaFlashSink() : m_Size(UPDATE_SIZE_UNKNOWN), m_Started(false), m_Written(0) {
+    mbedtls_sha256_init(&m_Sha);
+    mbedtls_sha256_starts_ret(&m_Sha, 0);
+  }
+
+  ~OtaFlashSink() {
+    mbedtls_sha256_free(&m_Sha);
+  }
+
+  // Set the image size (if known) and the expected digests, before the first write
+  void setSize(size_t size)         { m_Size = size; }
+  void setMD5(const char* md5)      { m_MD5 = md5; }
+  void setSHA256(const char* sha)   { m_SHA256 = sha; }
+  bool hasSHA256() const            { return m_SHA256.length() == 64; }
+  size_t written() const            { return m_Written; }
+
+  bool write(const uint8_t* data, size_t len) {
+    if (!m_Started) {
+      if (!Update.begin(m_Size)) {
+        DEBUG_PRINT("Not enough space to begin OTA");
+        return false;
+      }
+      if (m_MD5.length() == 32) {
+        Update.setMD5(m_MD5.c_str());
+      }
+      m_Started = true;
+    }
+    if (Update.write((uint8_t*)data, len) != len) {
+      DEBUG_PRINT(Update.errorString());
+      return false;
+    }
+    mbedtls_sha256_update_ret(&m_Sha, data, len);
+    m_Written += len;
+    return true;
+  }
+
+  bool finish() {
+    if (!m_Started) {
+      return false;
+    }
+    if (hasSHA256() && !checkSHA256()) {
+      DEBUG_PRINT("SHA-256 mismatch");
+      Update.abort();
+      return false;
+    }
+    // With an unknown size, the image ends where the data ends
+    return Update.end(m_Size == UPDATE_SIZE_UNKNOWN);
+  }
+
+private:
+  // Function to compare the digest of the written image with the expected one
+  bool checkSHA256() {
+    uint8_t digest[32];
+    mbedtls_sha256_finish_ret(&m_Sha, digest);
+
+    char hex[65];
+    for (int i = 0; i < 32; i++) {
+      snprintf(hex + 2*i, 3, "%02x", digest[i]);
+    }
+    return 0 == strcasecmp(m_SHA256.c_str(), hex);
+  }
+
+  size_t m_Size;
+  FixedString<33> m_MD5;
+  FixedString<65> m_SHA256;
+  bool   m_Started;
+  size_t m_Written;
+  mbedtls_sha256_context m_Sha;
+};
+
+// Inflates a gzip stream using the miniz ROM inflater and a 32K window
+class OtaInflateSink : public OtaSink {
+public:
+  OtaInflateSink(OtaSink& next)
+    : m_Next(next), m_Decomp(NULL), m_Dict(NULL), m_DictPos(0)
+    , m_HeaderLen(0), m_Flags(0), m_ExtraLen(0), m_State(GZ_HEADER), m_Done(false)
+    , m_Crc(0), m_OutSize(0), m_TrailerLen(0)
+  {}
+
+  ~OtaInflateSink() {
+    free(m_Decomp);
+    free(m_Dict);
+  }
+
+  bool write(const uint8_t* data, size_t len) {
+    if (!m_Dict) {
+      m_Decomp = (tinfl_decompressor*)malloc(sizeof(tinfl_decompressor));
+      m_Dict   = (uint8_t*)malloc(TINFL_LZ_DICT_SIZE);
+      if (!m_Decomp || !m_Dict) {
+        DEBUG_PRINT("Not enough memory to inflate");
+        return false;
+      }
+      tinfl_init(m_Decomp);
+    }
+
+    while (len && m_State != GZ_BODY) {
+      if (!parseHeader(*data++)) {
+        DEBUG_PRINT("Invalid gzip header");
+        return false;
+      }
+      len--;
+    }
+
+    while (len && !m_Done) {
+      size_t inSize  = len;
+      size_t outSize = TINFL_LZ_DICT_SIZE - m_DictPos;
+      tinfl_status status = tinfl_decompress(m_Decomp, data, &inSize,
+                                             m_Dict, m_Dict + m_DictPos, &outSize,
+                                             TINFL_FLAG_HAS_MORE_INPUT);
+      data += inSize;
+      len  -= inSize;
+
+      if (outSize) {
+        if (!m_Next.write(m_Dict + m_DictPos, outSize)) {
+          return false;
+        }
+        m_Crc = crc32_le(m_Crc, m_Dict + m_DictPos, outSize);
+        m_OutSize += outSize;
+        m_DictPos = (m_DictPos + outSize) & (TINFL_LZ_DICT_SIZE - 1);
+      }
+
+      if (status < TINFL_STATUS_DONE) {
+        DEBUG_PRINTF("Inflate error %d", (int)status);
+        return false;
+      } else if (status == TINFL_STATUS_DONE) {
+        m_Done = true;  // What follows is the gzip trailer
+        takeTrailerBits();
+      } else if (status == TINFL_STATUS_NEEDS_MORE_INPUT && !inSize && !outSize) {
+        break;
+      }
+    }
+
+    while (len && m_Done && m_TrailerLen < sizeof(m_Trailer)) {
+      m_Trailer[m_TrailerLen++] = *data++;
+      len--;
+    }
+    return true;
+  }
+
+  bool finish() {
+    if (!m_Done || m_TrailerLen < sizeof(m_Trailer)) {
+      DEBUG_PRINT("Truncated gzip stream");
+      return false;
+    }
+    if (readLE32(m_Trailer) != m_Crc || readLE32(m_Trailer + 4) != m_OutSize) {
+      DEBUG_PRINT("gzip CRC or size mismatch");
+      return false;
+    }
+    return m_Next.finish();
+  }
+
+private:
+  enum { GZ_HEADER, GZ_EXTRA_LEN, GZ_EXTRA, GZ_NAME, GZ_COMMENT, GZ_HCRC, GZ_BODY };
+
+  // Function to skip the gzip member header (RFC 1952), one byte at a time
+  bool parseHeader(uint8_t b) {
+    switch (m_State) {
+    case GZ_HEADER:
+      if ((m_HeaderLen == 0 && b != 0x1F) ||
+          (m_HeaderLen == 1 && b != 0x8B) ||
+          (m_HeaderLen == 2 && b != 8))      // Deflate
+      {
+        return false;
+      }
+      if (m_HeaderLen == 3) {
+        m_Flags = b;
+      }
+      if (++m_HeaderLen == 10) {
+        m_HeaderLen = 0;
+        nextHeaderField(GZ_EXTRA_LEN);
+      }
+      return true;
+    case GZ_EXTRA_LEN:
+      m_ExtraLen |= (uint16_t)b << (8 * m_HeaderLen);
+      if (++m_HeaderLen == 2) {
+        m_HeaderLen = 0;
+        nextHeaderField(m_ExtraLen ? GZ_EXTRA : GZ_NAME);
+      }
+      return true;
+    case GZ_EXTRA:
+      if (--m_ExtraLen == 0) { nextHeaderField(GZ_NAME); }
+      return true;
+    case GZ_NAME:
+      if (!b) { nextHeaderField(GZ_COMMENT); }
+      return true;
+    case GZ_COMMENT:
+      if (!b) { nextHeaderField(GZ_HCRC); }
+      return true;
+    case GZ_HCRC:
+      if (++m_HeaderLen == 2) { nextHeaderField(GZ_BODY); }
+      return true;
+    default:
+      return false;
+    }
+  }
+
+  // Function to recover trailer bytes the inflater already read ahead into its bit buffer
+  void takeTrailerBits() {
+    uint32_t bits = m_Decomp->m_num_bits;
+    uint32_t buf  = m_Decomp->m_bit_buf >> (bits & 7);  // The last deflate byte is padded
+    for (bits >>= 3; bits && m_TrailerLen < sizeof(m_Trailer); bits--, buf >>= 8) {
+      m_Trailer[m_TrailerLen++] = (uint8_t)buf;
+    }
+  }
+
+  static uint32_t readLE32(const uint8_t* p) {
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+  }
+
+  // Function to advance to the next optional header field that is present
+  void nextHeaderField(int state) {
+    static const uint8_t flagOf[] = { 0, 0x04, 0x04, 0x08, 0x10, 0x02, 0 };  // FEXTRA, FNAME, FCOMMENT, FHCRC
+    while (state != GZ_BODY && !(m_Flags & flagOf[state])) {
+      state = (state == GZ_EXTRA_LEN) ? GZ_NAME : state + 1;
+    }
+    m_State = state;
+  }
+
+  OtaSink&            m_Next;
+  tinfl_decompressor* m_Decomp;
+  uint8_t*            m_Dict;
+  size_t              m_DictPos;
+  uint8_t             m_HeaderLen;
+  uint8_t             m_Flags;
+  uint16_t            m_ExtraLen;
+  int                 m_State;
+  bool                m_Done;
+  uint32_t            m_Crc;      // CRC32 and length of the inflated output, for the trailer
+  uint32_t            m_OutSize;
+  uint8_t             m_Trailer[8];
+  uint8_t             m_TrailerLen;
+};
+
+/*
+ * Delta patches, produced by tools/ota_delta.py against the running firmware:
+ *
+ *   header:  "DLT1", u32 source size, u32 target size, 16 byte MD5 of the source image
+ *   ops:     0x01 COPY  <src offset> <len>            copy bytes of the running image
+ *            0x02 DATA  <len> <bytes>                 literal bytes
+ *            0x03 ADD   <src offset> <len> <bytes>    source bytes plus the given deltas
+ *            0x00 END
+ *
+ * Numbers are little-endian in the header and LEB128 varints in the ops.
+ */
+
+// Function to read a piece of the running firmware image
+static
+bool ota_read_running(uint32_t offset, uint8_t* buf, size_t len) {
+  const esp_partition_t* running = esp_ota_get_running_partition();
+  return running && (esp_partition_read(running, offset, buf, len) == ESP_OK);
+}
+
+// Applies a delta patch against the running partition, in a single pass
+class OtaDeltaSink : public OtaSink {
+public:
+  OtaDeltaSink(OtaFlashSink& next)
+    : m_Next(next), m_State(ST_HEADER), m_Pos(0), m_Op(0), m_Shift(0)
+    , m_Offset(0), m_Len(0), m_Varint(0), m_TargetSize(0)
+  {}
+
+  bool write(const uint8_t* data, size_t len) {
+    while (len) {
+      switch (m_State) {
+      case ST_HEADER:
+        m_Header[m_Pos++] = *data++; len--;
+        if (m_Pos == sizeof(m_Header) && !checkHeader()) {
+          return false;
+        }
+        break;
+      case ST_OP:
+        m_Op = *data++; len--;
+        m_Offset = m_Len = 0;
+        if (m_Op == OP_END) {
+          m_State = ST_END;
+        } else if (m_Op == OP_DATA) {
+          startVarint(ST_LEN);
+        } else if (m_Op == OP_COPY || m_Op == OP_ADD) {
+          startVarint(ST_OFFSET);
+        } else {
+          DEBUG_PRINT("Invalid delta op");
+          return false;
+        }
+        break;
+      case ST_OFFSET:
+      case ST_LEN:
+        len--;
+        if (!readVarint(*data++)) {
+          break;
+        }
+        if (m_State == ST_OFFSET) {
+          m_Offset = m_Varint;
+          startVarint(ST_LEN);
+        } else {
+          m_Len = m_Varint;
+          if (m_Op == OP_COPY) {
+            if (!copy()) {
+              return false;
+            }
+            m_State = ST_OP;
+          } else {
+            m_State = m_Len ? ST_BYTES : ST_OP;
+          }
+        }
+        break;
+      case ST_BYTES: {
+        size_t n = BlynkMin((size_t)m_Len, BlynkMin(len, sizeof(m_Buf)));
+        if (m_Op == OP_ADD) {
+          if (!ota_read_running(m_Offset, m_Buf, n)) {
+            return false;
+          }
+          for (size_t i = 0; i < n; i++) {
+            m_Buf[i] += data[i];
+          }
+          m_Offset += n;
+          if (!m_Next.write(m_Buf, n)) {
+            return false;
+          }
+        } else if (!m_Next.write(data, n)) {
+          return false;
+        }
+        data += n; len -= n; m_Len -= n;
+        if (!m_Len) {
+          m_State = ST_OP;
+        }
+      } break;
+      default:
+        return false;  // Data after END
+      }
+    }
+    return true;
+  }
+
+  bool finish() {
+    if (m_State != ST_END || m_Next.written() != m_TargetSize) {
+      DEBUG_PRINT("Delta patch incomplete");
+      return false;
+    }
+    return m_Next.finish();
+  }
+
+private:
+  enum { OP_END = 0x00, OP_COPY = 0x01, OP_DATA = 0x02, OP_ADD = 0x03 };
+  enum { ST_HEADER, ST_OP, ST_OFFSET, ST_LEN, ST_BYTES, ST_END };
+
+  static uint32_t le32(const uint8_t* p) {
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+  }
+
+  // Function to check that the patch was made for the firmware we are running
+  bool checkHeader() {
+    if (memcmp(m_Header, "DLT1", 4)) {
+      DEBUG_PRINT("Invalid delta header");
+      return false;
+    }
+    const uint32_t sourceSize = le32(m_Header + 4);
+    m_TargetSize = le32(m_Header + 8);
+
+    char md5[33];
+    for (int i = 0; i < 16; i++) {
+      snprintf(md5 + 2*i, 3, "%02x", m_Header[12 + i]);
+    }
+    if (sourceSize != ESP.getSketchSize() || ESP.getSketchMD5() != md5) {
+      DEBUG_PRINT("Delta patch does not match the running firmware");
+      return false;
+    }
+    m_Next.setSize(m_TargetSize);
+    m_State = ST_OP;
+    return true;
+  }
+
+  void startVarint(int state) {
+    m_State  = state;
+    m_Varint = 0;
+    m_Shift  = 0;
+  }
+
+  // Function to add a byte to the varint being read, true when it is complete
+  bool readVarint(uint8_t b) {
+    m_Varint |= (uint32_t)(b & 0x7F) << m_Shift;
+    m_Shift  += 7;
+    return !(b & 0x80);
+  }
+
+  // Function to copy a range of the running image to the output
+  bool copy() {
+    while (m_Len) {
+      size_t n = BlynkMin((size_t)m_Len, sizeof(m_Buf));
+      if (!ota_read_running(m_Offset, m_Buf, n) || !m_Next.write(m_Buf, n)) {
+        return false;
+      }
+      m_Offset += n;
+      m_Len    -= n;
+    }
+    return true;
+  }
+
+  OtaFlashSink& m_Next;
+  int      m_State;
+  size_t   m_Pos;
+  uint8_t  m_Op;
+  uint8_t  m_Shift;
+  uint32_t m_Offset;
+  uint32_t m_Len;
+  uint32_t m_Varint;
+  uint32_t m_TargetSize;
+  uint8_t  m_Header[28];
+  uint8_t  m_Buf[256];
+};
@@ -0,0 +1,156 @@
+#include "esp_wifi.h"
+#if CONFIG_PM_ENABLE
+  #include "esp_pm.h"
+#endif
+
+/*
+ * Power governor: picks a power profile from the delivery state, once per
+ * loop pass, and keeps per-profile residency with an estimated charge.
+ *
+ *  idle       System off or no courier nearby: CPU at POWER_IDLE_CPU_MHZ,
+ *             Wi-Fi modem sleep (listen interval of several beacons),
+ *             automatic light sleep where the SDK allows it, and the loop
+ *             sleeps until the next timer, at most POWER_IDLE_TICK ms per pass.
+ *  nearby     Courier inside the geofence (or motion, without GPS): full
+ *             clock, power save off.
+ *  streaming  Camera stream running (a client on the stream port, checked
+ *             every POWER_STREAM_CHECK ms): full clock, power save off. The
+ *             motion detector pauses meanwhile.
+ *
+ * Wake sources in idle are the loop tick and Wi-Fi traffic (Blynk), which
+ * the modem sleep still delivers at the beacons. Buttons are re-sampled on
+ * every wake, since edge interrupts are not delivered in light sleep.
+ *
+ * The charge is an estimate: residency times the typical current of each
+ * profile (POWER_MA_*), not a measurement.
+ */
+
+enum PowerProfile {
+  POWER_IDLE,
+  POWER_NEARBY,
+  POWER_STREAMING,
+  POWER_PROFILE_MAX
+};
+
+static const char* const powerProfileNames[POWER_PROFILE_MAX] = { "idle", "nearby", "streaming" };
+static const uint16_t    powerProfileMa[POWER_PROFILE_MAX]    = { POWER_MA_IDLE, POWER_MA_NEARBY, POWER_MA_STREAMING };
+
+struct PowerStats {
+  uint8_t  profile;                          // Current profile
+  uint32_t switches;                         // Profile changes since boot
+  int64_t  enteredUs;                        // esp_timer time the current profile was entered
+  int64_t  residencyUs[POWER_PROFILE_MAX];   // Time spent in each profile, up to enteredUs
+};
+
+static PowerStats    powerStats = { POWER_NEARBY, 0, 0, { 0, } };
+static volatile bool powerStreaming = false;  // A client holds the camera stream
+static uint32_t      powerStreamCheckMs = 0;  // millis() of the last look at the stream
+
+// Function to report that a camera stream starts or stops
+void power_set_streaming(bool on) {
+  powerStreaming = on;
+  motion_set_paused(on);  // The stream gets every frame
+}
+
+// Function to pick the profile for the current delivery state
+static
+uint8_t power_select() {
+  if (powerStreaming) {
+    return POWER_STREAMING;
+  }
+  if (components_enabled()) {
+    return POWER_NEARBY;
+  }
+  return POWER_IDLE;
+}
+
+// Function to set up the CPU clock, sleep and Wi-Fi power save of a profile
+static
+void power_apply(uint8_t profile) {
+  const bool idle = (profile == POWER_IDLE);
+
+#if CONFIG_PM_ENABLE && CONFIG_IDF_TARGET_ESP32
+  esp_pm_config_esp32_t pm;
+  pm.max_freq_mhz = idle ? POWER_IDLE_CPU_MHZ : 240;
+  pm.min_freq_mhz = idle ? POWER_IDLE_CPU_MHZ : 240;
+  #if CONFIG_FREERTOS_USE_TICKLESS_IDLE
+  pm.light_sleep_enable = idle;  // Sleeps whenever all tasks are blocked
+  #else
+  pm.light_sleep_enable = false;
+  #endif
+  esp_pm_configure(&pm);
+#else
+  setCpuFrequencyMhz(idle ? POWER_IDLE_CPU_MHZ : 240);
+#endif
+
+  // Max modem sleep wakes for every listen interval (3 beacons by default), not every DTIM.
+  // Through WiFi.setSleep(), which keeps the mode and applies it again on every STA start
+  // (reconnects, roams); esp_wifi_set_ps() alone is lost then.
+  WiFi.setSleep(idle ? WIFI_PS_MAX_MODEM : WIFI_PS_NONE);
+}
+
+// Function to add the time spent in the current profile to its residency
+static
+void power_account(int64_t now) {
+  powerStats.residencyUs[powerStats.profile] += now - powerStats.enteredUs;
+  powerStats.enteredUs = now;
+}
+
+// Function to get the estimated charge used since boot, in mAh
+static
+double power_charge_mah() {
+  power_account(esp_timer_get_time());
+  double mah = 0;
+  for (int i = 0; i < POWER_PROFILE_MAX; i++) {
+    mah += powerStats.residencyUs[i] / 3.6e9 * powerProfileMa[i];
+  }
+  return mah;
+}
+
+// Function to start the governor in the full-power profile
+void power_init() {
+  powerStats.enteredUs = esp_timer_get_time();
+  power_apply(powerStats.profile);
+}
+
+// Function to switch profiles when the delivery state changes, and to idle the loop; called once per pass
+void power_run() {
+  if (millis() - powerStreamCheckMs >= POWER_STREAM_CHECK) {
+    powerStreamCheckMs = millis();
+    const bool streaming = camera_streaming();
+    if (streaming != powerStreaming) {
+      power_set_streaming(streaming);
+    }
+  }
+
+  const uint8_t profile = power_select();
+  if (profile != powerStats.profile) {
+    power_account(esp_timer_get_time());
+    powerStats.profile = profile;
+    powerStats.switches++;
+    power_apply(profile);
+    LOG_I("Power profile: %s", powerProfileNames[profile]);
+  }
+
+  if (profile == POWER_IDLE) {
+    // Lets the CPU sleep until the next timer is due, for at most a tick (Blynk still needs polling)
+    vTaskDelay(pdMS_TO_TICKS(timer_idle_ms(POWER_IDLE_TICK)));
+    gpio_events_resync();                        // Edges are not seen while asleep
+  }
+}
+
+// Function to handle the "power" console command
+void power_command(int, const char**) {
+  const double mah = power_charge_mah();
+  const int64_t now = powerStats.enteredUs;
+
+  edgentConsole.printf(" Profile:         %s (%u changes)\n", powerProfileNames[powerStats.profile],
+                       powerStats.switches);
+  for (int i = 0; i < POWER_PROFILE_MAX; i++) {
+    edgentConsole.printf("   %-14s %8u s  %3u%%  ~%u mA\n", powerProfileNames[i],
+                         (uint32_t)(powerStats.residencyUs[i] / 1000000),
+                         (uint32_t)(now ? powerStats.residencyUs[i] * 100 / now : 0), powerProfileMa[i]);
+  }
+  edgentConsole.printf(" Estimated:       %.1f mAh since boot (%.1f mA average)\n",
+                       mah, now ? mah * 3.6e9 / now : 0.0);
+}
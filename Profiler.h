@@ -0,0 +1,147 @@
+/*
+ * Lightweight runtime profiler: scoped timers feed one histogram per section.
+ *
+ * Buckets are log-linear (4 per power of two), so percentiles are within
+ * ~12% of the real value over the whole range, at a fixed ~420 bytes per section.
+ * A probe costs two micros() calls and a few integer instructions.
+ * Scopes are meant for the loop task, which also keeps the stack of open sections.
+ */
+
+// Sections being timed
+enum ProfSection {
+  PROF_LOOP,        // One pass of loop()
+  PROF_EDGENT,      // BlynkEdgent.run()
+  PROF_TIMER,       // timer_run(): the callbacks of the due timers
+  PROF_COMPONENTS,  // runElectronicComponents()
+  PROF_GEOFENCE,    // checkGeofence()
+  PROF_LCD,         // LCD update
+  PROF_ULTRASONIC,  // Ultrasonic ping
+  PROF_SERVO,       // Servo move
+  PROF_CAMERA,      // Camera frame capture
+  PROF_SECTION_MAX
+};
+
+static const char* const profSectionNames[PROF_SECTION_MAX] = {
+  "loop",
+  "edgent",
+  "timer",
+  "components",
+  "geofence",
+  "lcd",
+  "ultrasonic",
+  "servo",
+  "camera",
+};
+
+#define PROF_SUB_BITS     2                          // Sub-buckets per power of two: 1 << PROF_SUB_BITS
+#define PROF_BUCKETS      ((27 - PROF_SUB_BITS) << PROF_SUB_BITS)  // Up to ~67 s
+
+struct ProfHistogram {
+  uint32_t count;
+  uint32_t maxUs;
+  uint64_t totalUs;
+  uint32_t buckets[PROF_BUCKETS];
+};
+
+static ProfHistogram profHist[PROF_SECTION_MAX];
+
+// Function to map a duration to its bucket
+static inline
+int prof_bucket(uint32_t us) {
+  if (us < (2u << PROF_SUB_BITS)) {
+    return us;  // Small values get a bucket each
+  }
+  const int msb = 31 - __builtin_clz(us);
+  const int sub = (us >> (msb - PROF_SUB_BITS)) & ((1 << PROF_SUB_BITS) - 1);
+  const int idx = ((msb - PROF_SUB_BITS + 1) << PROF_SUB_BITS) + sub;
+  return (idx < PROF_BUCKETS) ? idx : PROF_BUCKETS - 1;
+}
+
+// Function to get the lowest duration that falls into a bucket
+static
+uint32_t prof_bucket_floor(int idx) {
+  if (idx < (2 << PROF_SUB_BITS)) {
+    return idx;
+  }
+  const int msb = (idx >> PROF_SUB_BITS) + PROF_SUB_BITS - 1;
+  const int sub = idx & ((1 << PROF_SUB_BITS) - 1);
+  return (1u << msb) | ((uint32_t)sub << (msb - PROF_SUB_BITS));
+}
+
+// Function to add a sample to a section
+static inline
+void profiler_record(uint8_t section, uint32_t us) {
+  ProfHistogram& h = profHist[section];
+  h.count++;
+  h.totalUs += us;
+  if (us > h.maxUs) {
+    h.maxUs = us;
+  }
+  h.buckets[prof_bucket(us)]++;
+}
+
+// Function to estimate a percentile (0..100) of a section, in us
+static
+uint32_t profiler_percentile(uint8_t section, unsigned pct) {
+  const ProfHistogram& h = profHist[section];
+  if (!h.count || pct >= 100) {
+    return h.maxUs;
+  }
+  const uint32_t rank = ((uint64_t)h.count * pct + 99) / 100;
+  uint32_t seen = 0;
+  for (int i = 0; i < PROF_BUCKETS; i++) {
+    seen += h.buckets[i];
+    if (seen >= rank) {
+      // Report the middle of the bucket, but never more than the maximum seen
+      const uint32_t lo = prof_bucket_floor(i);
+      const uint32_t hi = (i + 1 < PROF_BUCKETS) ? prof_bucket_floor(i + 1) : h.maxUs;
+      return BlynkMin(lo + (hi - lo) / 2, h.maxUs);
+    }
+  }
+  return h.maxUs;
+}
+
+// Function to clear all histograms
+void profiler_reset() {
+  memset(profHist, 0, sizeof(profHist));
+}
+
+// Sections open on the loop task, innermost last, with the code address that opened
+// each one (decode with xtensa-esp32-elf-addr2line); read by the loop watchdog
+#define PROF_STACK_DEPTH  4
+
+struct ProfFrame {
+  uint8_t  section;
+  uint32_t pc;
+};
+
+static volatile ProfFrame profStack[PROF_STACK_DEPTH];
+static volatile uint8_t   profDepth = 0;
+
+// Times the enclosing scope
+class ProfScope {
+public:
+  __attribute__((noinline))
+  ProfScope(uint8_t section) : m_Section(section), m_Start(micros()) {
+    if (profDepth < PROF_STACK_DEPTH) {
+      profStack[profDepth].section = section;
+      profStack[profDepth].pc      = (uint32_t)(uintptr_t)__builtin_return_address(0);
+    }
+    profDepth++;
+  }
+  ~ProfScope() {
+    profDepth--;
+    profiler_record(m_Section, micros() - m_Start);
+  }
+private:
+  uint8_t  m_Section;
+  uint32_t m_Start;
+};
+
+#ifdef PROFILER_ENABLE
+  #define PROF_CONCAT2(a, b)  a##b
+  #define PROF_CONCAT(a, b)   PROF_CONCAT2(a, b)
+  #define PROFILE_SCOPE(section)  ProfScope PROF_CONCAT(profScope, __LINE__)(section)
+#else
+  #define PROFILE_SCOPE(section)
+#endif
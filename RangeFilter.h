@@ -0,0 +1,141 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <math.h>
+
+/*
+ * Ultrasonic range filter.
+ *
+ * Every ping gives one raw reading: the echo width in us, 0 when no echo came
+ * back. range_filter_add() turns it into a RangeSample:
+ *
+ *  - readings with no echo, or outside RANGE_MIN_CM..RANGE_MAX_CM, are flagged
+ *    and never read as a distance (a missing echo used to read as 0 cm);
+ *  - the last RANGE_WINDOW readings give a running median, and a reading more
+ *    than RANGE_OUTLIER_CM from it is flagged as an outlier (a stray echo);
+ *  - the median of the good readings is smoothed with an EMA, except that a
+ *    step the median has confirmed is taken at once;
+ *  - confidence is the share of the window that agrees with the median, so a
+ *    single spike or a dropout lowers it, and a step change is only trusted
+ *    once most of the window has seen it.
+ *
+ * Kept free of Arduino dependencies so the host benchmarks can replay traces
+ * through it.
+ */
+
+#define RANGE_WINDOW       5       // Readings the median is taken over (odd)
+#define RANGE_MIN_CM       2       // Closer than this the sensor cannot tell
+#define RANGE_MAX_CM       400     // Beyond the range of the sensor
+#define RANGE_OUTLIER_CM   6       // A reading further than this from the median is an outlier
+#define RANGE_EMA_ALPHA    0.5f    // Weight of a new median in the smoothed distance
+#define RANGE_CONFIDENT    60      // Confidence (%) needed to act on a sample
+#define RANGE_UNLOCK_CM    10      // A parcel closer than this unlocks the box
+
+enum RangeFlags : uint8_t {
+  RANGE_VALID        = 1 << 0,  // cm is usable: most of the window holds good readings
+  RANGE_NO_ECHO      = 1 << 1,  // This reading: no echo came back
+  RANGE_OUT_OF_RANGE = 1 << 2,  // This reading: too close or too far to trust
+  RANGE_OUTLIER      = 1 << 3,  // This reading: too far from the median, not used
+};
+
+struct RangeSample {
+  float   cm;          // Filtered distance, RANGE_MAX_CM when not valid
+  float   rawCm;       // This reading, 0 with no echo
+  uint8_t flags;
+  uint8_t confidence;  // 0..100
+};
+
+struct RangeFilter {
+  uint16_t window[RANGE_WINDOW];  // Last readings in mm, 0 for a bad one
+  uint8_t  pos;
+  float    ema;
+  bool     emaReady;
+  uint32_t samples;
+  uint32_t noEcho;
+  uint32_t outOfRange;
+  uint32_t outliers;
+};
+
+// Function to forget the readings, e.g. after the sensor has not been pinged for a while
+void range_filter_reset(RangeFilter& f) {
+  for (uint16_t& mm : f.window) {
+    mm = 0;
+  }
+  f.pos      = 0;
+  f.emaReady = false;
+}
+
+// Function to filter one raw reading: the echo width in us, 0 for no echo
+RangeSample range_filter_add(RangeFilter& f, uint32_t echoUs) {
+  RangeSample s;
+  s.rawCm = echoUs * 0.0343f / 2;
+  s.flags = 0;
+  f.samples++;
+
+  uint16_t mm = 0;
+  if (!echoUs) {
+    s.flags |= RANGE_NO_ECHO;
+    f.noEcho++;
+  } else if (s.rawCm < RANGE_MIN_CM || s.rawCm > RANGE_MAX_CM) {
+    s.flags |= RANGE_OUT_OF_RANGE;
+    f.outOfRange++;
+  } else {
+    mm = s.rawCm * 10 + 0.5f;
+  }
+  f.window[f.pos] = mm;
+  f.pos = (f.pos + 1) % RANGE_WINDOW;
+
+  // Median of the good readings (insertion sort: the window is tiny)
+  uint16_t sorted[RANGE_WINDOW];
+  int good = 0;
+  for (uint16_t w : f.window) {
+    if (w) {
+      int i = good++;
+      for (; i > 0 && sorted[i - 1] > w; i--) {
+        sorted[i] = sorted[i - 1];
+      }
+      sorted[i] = w;
+    }
+  }
+  if (!good) {
+    f.emaReady   = false;
+    s.cm         = RANGE_MAX_CM;
+    s.confidence = 0;
+    return s;
+  }
+  const uint16_t median = sorted[good / 2];
+
+  int agree = 0;
+  for (int i = 0; i < good; i++) {
+    if (abs((int)sorted[i] - (int)median) <= RANGE_OUTLIER_CM * 10) {
+      agree++;
+    }
+  }
+  s.confidence = agree * 100 / RANGE_WINDOW;
+
+  if (mm && abs((int)mm - (int)median) > RANGE_OUTLIER_CM * 10) {
+    s.flags |= RANGE_OUTLIER;
+    f.outliers++;
+  } else if (mm) {
+    const float cm = median / 10.0f;
+    if (!f.emaReady || fabsf(cm - f.ema) > RANGE_OUTLIER_CM) {
+      f.ema = cm;  // Moved, not jitter
+    } else {
+      f.ema += RANGE_EMA_ALPHA * (cm - f.ema);
+    }
+    f.emaReady = true;
+  }
+
+  if (f.emaReady && good > RANGE_WINDOW / 2) {
+    s.flags |= RANGE_VALID;
+    s.cm     = f.ema;
+  } else {
+    s.cm     = RANGE_MAX_CM;
+  }
+  return s;
+}
+
+// Function to tell whether a sample can be trusted to be closer than cm
+static inline
+bool range_sample_closer(const RangeSample& s, float cm, uint8_t confident = RANGE_CONFIDENT) {
+  return (s.flags & RANGE_VALID) && s.confidence >= confident && s.cm < cm;
+}
@@ -96,6 +96,10 @@
 #define BUTTON_HOLD_TIME_ACTION       10000    // Time in ms for button hold action
 #define BUTTON_PRESS_TIME_ACTION      50       // Time in ms for button press action
 
+#define GPIO_EVENT_QUEUE_SIZE         32       // GPIO edges queued between loop passes (power of 2)
+#define GPIO_WATCH_MAX                8        // Pins watched for edges
+#define GPIO_DEBOUNCE_MS              20       // A button must be stable this long for a change to count
+
 #define BOARD_PWM_MAX                 1023     // Maximum PWM value
 
 #define BOARD_LEDC_CHANNEL_1          1        // LEDC channel 1
@@ -117,13 +121,103 @@
 #if !defined(CONFIG_DEFAULT_PORT)
 #define CONFIG_DEFAULT_PORT           443      // Default port
 #endif
+#if !defined(CONFIG_WIFI_ALT_MAX)
+#define CONFIG_WIFI_ALT_MAX           3        // Fallback networks stored besides the provisioned one
+#endif
 
 #define WIFI_CLOUD_MAX_RETRIES        500      // Max retries for cloud connection
 #define WIFI_NET_CONNECT_TIMEOUT      50000    // Timeout for network connection in ms
 #define WIFI_CLOUD_CONNECT_TIMEOUT    50000    // Timeout for cloud connection in ms
+#define WIFI_FAST_CONNECT_TIMEOUT     5000     // Timeout for the cached BSSID/channel attempt in ms
+//#define WIFI_FAST_CONNECT_LEASE                // Reuse the last DHCP lease on the fast path (skips DHCP)
+#define WIFI_NET_FAILOVER_TIMEOUT     10000    // Per-AP timeout in ms when there are other APs to try
+#define WIFI_SCAN_MAX_AGE             60000    // Scan results older than this (ms) are not used to pick an AP
+#define WIFI_KNOWN_AP_MAX             8        // Known APs kept from a scan
+#define WIFI_SLOT_PENALTY_DB          5        // Each step down the network list costs this many dB
+#define WIFI_ROAM_CHECK_INTERVAL      10000    // Link quality check interval in ms
+#define WIFI_ROAM_RSSI_THRESHOLD      -75      // Look for a better AP below this RSSI (dBm)
+#define WIFI_ROAM_HYSTERESIS_DB       8        // Only move to an AP that is at least this much better
 #define WIFI_AP_IP                    IPAddress(192, 168, 4, 1)  // Default AP IP
 #define WIFI_AP_Subnet                IPAddress(255, 255, 255, 0)  // Default AP Subnet
 //#define WIFI_CAPTIVE_PORTAL_ENABLE
+#define PORTAL_SCAN_MAX               15       // Networks listed by the config portal
+#define PORTAL_SCAN_MAX_AGE           30000    // Rescan in the background when results are older (ms)
+#define PORTAL_STATS_MAX              12       // Config portal endpoints with timing statistics
+#define OTA_TASK_STACK                8192     // Stack of the background OTA task
+#define OTA_TASK_PRIORITY             1        // Priority of the OTA task (loop task is 1)
+#define OTA_TASK_CORE                 0        // Core of the OTA task (the Arduino loop runs on core 1)
+#define OTA_CHUNK_SIZE                1024     // Bytes read and written per step
+#define OTA_READ_TIMEOUT              5000     // A read stalled this long (ms) counts as a drop
+#define OTA_RESUME_MAX                10       // Give up after this many resumed requests
+#define OTA_RESUME_DELAY              1000     // Back-off before resuming in ms, times the attempt
+#define OTA_METRICS_INTERVAL          5000     // Interval of the progress reports in ms
+//#define OTA_PROGRESS_VPIN             V10      // Datastream for the OTA progress (%)
+//#define OTA_RATE_VPIN                 V11      // Datastream for the OTA download rate (KB/s)
+//#define OTA_REQUIRE_SHA256                     // Refuse images served without an x-SHA256 header
+
+#define PROFILER_ENABLE                        // Time the main loop and subsystems (see the "perf" command)
+//#define TRACE_ENABLE                           // Record trace events (see the "trace" command)
+#define TRACE_RING_SIZE               512      // Trace events kept per core (power of two)
+#define BENCH_TLS_BYTES               1024     // Bytes per write of the TLS benchmark
+#define LOOP_WD_BUDGET                200      // A loop pass longer than this (ms) is a stall
+#define LOOP_WD_CHECK_INTERVAL        50       // How often the loop watchdog looks at the pass (ms)
+#define LOOP_WD_WORST_MAX             4        // Longest stalls kept with their sections
+#define LOOP_WD_VPIN                  V9       // Datastream for the stall count (comment out if unused)
+#define HEAP_TRACE_RECORDS            200      // Allocations recorded by "heap start" (needs CONFIG_HEAP_TRACING_STANDALONE)
+#define HEAP_SITES_MAX                24       // Call sites shown by "heap sites"
+#define LOG_LEVEL                     3        // Application log level: 0 none, 1 error, 2 warn, 3 info, 4 debug
+#define LOG_RING_SIZE                 4096     // Bytes of log records buffered in RAM
+#define LOG_FLUSH_INTERVAL            20       // The log task drains the buffer this often (ms)
+#define LOG_TASK_STACK                3072     // Stack of the log task
+#define LOG_TASK_PRIORITY             1        // Priority of the log task
+#define LOG_TASK_CORE                 0        // Core of the log task (the Arduino loop runs on core 1)
+//#define LOG_OUTPUT_BINARY                      // Write raw records for tools/log_decode.py instead of text
+#define POWER_IDLE_CPU_MHZ            80       // CPU clock while no delivery is expected (80, 160 or 240)
+#define POWER_IDLE_TICK               100      // Longest sleep of a loop pass while idle (ms)
+#define POWER_MA_IDLE                 20       // Typical current while idle, for the charge estimate (mA)
+#define POWER_MA_NEARBY               120      // Typical current with a courier nearby (mA)
+#define POWER_MA_STREAMING            250      // Typical current while streaming the camera (mA)
+#define POWER_STREAM_CHECK            500      // Time between looks for a client on the camera stream (ms)
+#define CAMERA_STREAM_PORT            81       // Port of the stream server startCameraServer() runs (app_httpd.cpp)
+#define TIMER_MAX                     32       // Timers that can be pending at once (TimerWheel.h)
+#define LOCK_HISTORY                  16       // Lock state transitions kept for the "lock" command
+#define RANGE_NEAR_CM                 30       // Ping back to back while something is closer than this (cm)
+#define RANGE_BURST                   5        // Pings per burst while nothing is near
+#define RANGE_BURST_GAP               500      // Time from the last ping of a burst to the next burst (ms)
+#define RANGE_TRACE_MAX               256      // Raw echoes kept for "range trace"
+//#define LCD_I2C_ADDR                  0x27     // LCD on a PCF8574 I2C backpack at this address, instead of the 4-bit bus
+#define I2C_SDA_PIN                   13       // I2C bus of the LCD backpack and the locker-bank expanders, on pins the
+#define I2C_SCL_PIN                   15       //   AI-Thinker camera leaves free (the default 21/22 are camera pins)
+#define LCD_EXEC_US                   40       // Time the LCD takes for a character or command (37 us typical)
+#define LCD_CLEAR_US                  1600     // Time the LCD takes to clear or go home (1.52 ms typical)
+//#define TELEMETRY_ENABLE                       // Binary stream of every sensor and servo sample (Telemetry.h, tools/telemetry.py)
+#define TELEMETRY_PORT                7000     // TCP port the telemetry is served on; 0 sends it on Serial instead
+#define TELEMETRY_RING                512      // Records buffered between the loop and the telemetry task
+#define TELEMETRY_BATCH               1024     // Bytes sent at once by the telemetry task
+#define TELEMETRY_FLUSH_INTERVAL      10       // The telemetry task sends the queued records this often (ms)
+#define TELEMETRY_TASK_STACK          3072     // Stack of the telemetry task
+#define TELEMETRY_TASK_PRIORITY       1        // Priority of the telemetry task
+#define TELEMETRY_TASK_CORE           0        // Core of the telemetry task (the Arduino loop runs on core 1)
+//#define MOTION_ENABLE                          // Motion in the camera frames enables the box while the courier's phone has no GPS (MotionDetect.h)
+#define MOTION_INTERVAL               250      // Time between the frames the motion detector looks at (ms), at least
+#define MOTION_DUTY_PCT               20       // Share of its core (%) taking frames may use; costly frames come less often
+#define MOTION_HOLD                   30000    // Motion this recent enables the box and backs an unlock (ms)
+#define MOTION_TASK_STACK             4096     // Stack of the motion task (the JPEG decoder needs ~3 KB)
+#define MOTION_TASK_PRIORITY          1        // Priority of the motion task
+#define MOTION_TASK_CORE              0        // Core of the motion task
+//#define LOCKER_BANK                   4        // Locker-bank mode: compartments driven by this controller (LockerBank.h)
+#define BANK_ECHO_PIN                 2        // Echo outputs of all the compartment sensors, wired-OR through a diode each
+#define BANK_PCA9685_ADDR             0x40     // PCA9685 driving the compartment servos, one channel each
+#define BANK_PCF8574_ADDR             0x20     // First PCF8574 of the trig outputs and door switches, the next ones follow
+#define BOOT_PHASES_MAX               16       // Phases and milestones kept for the "boot" report
+#define BOOT_JOBS_MAX                 4        // Init steps that can run in the background at boot
+#define BOOT_TASK_STACK               4096     // Stack of a boot job task
+#define BOOT_TASK_PRIORITY            1        // Priority of the boot job tasks
+#define BOOT_CAMERA_TIMEOUT           3000     // Warn when the camera is not up this long after the cloud connects (ms)
+//#define ULP_RANGING                            // Battery units: deep sleep while idle, the ULP watches the sensor
+#define ULP_SLEEP_AFTER               30000    // Idle and locked this long (ms) before going to deep sleep
+#define ULP_PING_INTERVAL             250      // The ULP pings the ultrasonic sensor this often in deep sleep (ms)
+#define ULP_CHECKIN_INTERVAL          300      // Wake from deep sleep this often (s) to sync with the cloud
 
 //#define USE_TICKER
 //#define USE_TIMER_ONE
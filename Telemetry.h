@@ -0,0 +1,201 @@
+/*
+ * Binary telemetry of the sensor and actuator samples, for tuning.
+ *
+ * Every ultrasonic reading, servo step and lock transition can be sent as
+ * one 16-byte record: us timestamp, raw echo, filtered distance, servo angle,
+ * lock state. TELEMETRY(...) only copies the record into a RAM ring, without
+ * formatting or I/O, so the control loop is not slowed down; a low-priority
+ * task on the other core encodes and sends the records. When the ring is
+ * full a record is dropped and counted, never waited for.
+ *
+ * Record: u32 micros(), u16 sequence, u8 kind, u8 compartment, u16 raw echo
+ *         (us, 0 for none), u16 filtered distance (mm), u8 range flags,
+ *         u8 confidence, u8 servo angle, u8 lock state. All little-endian.
+ * Frame:  the record and a CRC-8 (poly 0x07) of it, COBS-encoded, then 0x00;
+ *         every batch of frames also starts with a 0x00.
+ *
+ * The frames go to the client connected to TCP port TELEMETRY_PORT, or to
+ * Serial if it is 0; frames interleaved with the text log fail their CRC and
+ * are skipped. tools/telemetry.py decodes and plots the stream; gaps in the
+ * sequence show dropped records. Without TELEMETRY_ENABLE all of this
+ * compiles to nothing.
+ */
+
+#ifdef TELEMETRY_ENABLE
+
+enum TelemetryKind : uint8_t {
+  TELEMETRY_RANGE,  // Ultrasonic reading
+  TELEMETRY_SERVO,  // Servo step
+  TELEMETRY_LOCK,   // Lock state transition
+};
+
+struct __attribute__((packed)) TelemetryRecord {
+  uint32_t us;
+  uint16_t seq;
+  uint8_t  kind;
+  uint8_t  box;
+  uint16_t echoUs;
+  uint16_t distanceMm;
+  uint8_t  flags;
+  uint8_t  confidence;
+  uint8_t  angle;
+  uint8_t  state;
+};
+static_assert(sizeof(TelemetryRecord) == 16, "The record layout is shared with tools/telemetry.py");
+
+#define TELEMETRY_FRAME_MAX  (sizeof(TelemetryRecord) + 3)  // COBS overhead, CRC and delimiter
+
+struct TelemetryQueue {
+  TelemetryRecord   records[TELEMETRY_RING];
+  volatile uint32_t head;     // Records pushed, written by the loop task only
+  volatile uint32_t tail;     // Records sent, written by the telemetry task only
+  uint32_t          dropped;  // Records lost because the ring was full
+  uint32_t          sent;
+  uint16_t          seq;
+};
+
+static TelemetryQueue telemetryQueue;
+static TaskHandle_t   telemetryTask = NULL;
+
+// Function to queue a record; called from the loop task only
+void telemetry_emit(uint8_t kind, uint8_t box, uint32_t echoUs, float distanceCm,
+                    uint8_t flags, uint8_t confidence, int angle, uint8_t state)
+{
+  TelemetryQueue& q = telemetryQueue;
+  const uint32_t head = q.head;
+  const uint16_t seq  = q.seq++;
+  if (head - __atomic_load_n(&q.tail, __ATOMIC_ACQUIRE) >= TELEMETRY_RING) {
+    q.dropped++;
+    return;
+  }
+  TelemetryRecord& r = q.records[head % TELEMETRY_RING];
+  r.us         = micros();
+  r.seq        = seq;
+  r.kind       = kind;
+  r.box        = box;
+  r.echoUs     = BlynkMin(echoUs, (uint32_t)UINT16_MAX);
+  r.distanceMm = distanceCm * 10;
+  r.flags      = flags;
+  r.confidence = confidence;
+  r.angle      = angle;
+  r.state      = state;
+  __atomic_store_n(&q.head, head + 1, __ATOMIC_RELEASE);  // Publish the record
+}
+
+// Function to get the CRC-8 (poly 0x07) of a record
+static
+uint8_t telemetry_crc8(const uint8_t* data, size_t len) {
+  uint8_t crc = 0;
+  for (size_t i = 0; i < len; i++) {
+    crc ^= data[i];
+    for (int b = 0; b < 8; b++) {
+      crc = (crc & 0x80) ? (crc << 1) ^ 0x07 : crc << 1;
+    }
+  }
+  return crc;
+}
+
+// Function to COBS-encode a record with its CRC into a frame, returns the frame size
+static
+size_t telemetry_frame(const TelemetryRecord& r, uint8_t* out) {
+  uint8_t in[sizeof(TelemetryRecord) + 1];
+  memcpy(in, &r, sizeof(r));
+  in[sizeof(r)] = telemetry_crc8(in, sizeof(r));
+
+  size_t code = 0, n = 1;  // out[code] holds the distance to the next zero
+  for (size_t i = 0; i < sizeof(in); i++) {
+    if (in[i]) {
+      out[n++] = in[i];
+    } else {
+      out[code] = n - code;
+      code = n++;
+    }
+  }
+  out[code] = n - code;
+  out[n++]  = 0;  // Delimiter
+  return n;
+}
+
+// Task encoding and sending the records, in the background
+static
+void telemetry_task(void*) {
+  static uint8_t batch[TELEMETRY_BATCH];
+#if TELEMETRY_PORT
+  WiFiServer server(TELEMETRY_PORT);
+  WiFiClient client;
+  bool listening = false;
+#endif
+
+  for (;;) {
+    vTaskDelay(pdMS_TO_TICKS(TELEMETRY_FLUSH_INTERVAL));
+
+#if TELEMETRY_PORT
+    if (!listening && WiFi.status() == WL_CONNECTED) {
+      server.begin();
+      server.setNoDelay(true);
+      listening = true;
+    }
+    if (listening && !client.connected()) {
+      client = server.available();
+    }
+    const bool connected = client.connected();
+#else
+    const bool connected = true;
+#endif
+
+    TelemetryQueue& q = telemetryQueue;
+    batch[0] = 0;  // Ends whatever came before on the line, e.g. a log message
+    size_t len = 1;
+    uint32_t tail = q.tail;
+    while (tail != __atomic_load_n(&q.head, __ATOMIC_ACQUIRE)) {
+      if (connected) {
+        if (len + TELEMETRY_FRAME_MAX > sizeof(batch)) {
+          break;  // The rest goes with the next batch
+        }
+        len += telemetry_frame(q.records[tail % TELEMETRY_RING], batch + len);
+        q.sent++;
+      }
+      tail++;  // With no client the records are let go
+    }
+    __atomic_store_n(&q.tail, tail, __ATOMIC_RELEASE);  // Free the slots
+
+    if (len > 1) {
+#if TELEMETRY_PORT
+      client.write(batch, len);
+#else
+      Serial.write(batch, len);
+#endif
+    }
+  }
+}
+
+// Function to start the telemetry task
+void telemetry_init() {
+  if (!telemetryTask) {
+    xTaskCreatePinnedToCore(telemetry_task, "telemetry", TELEMETRY_TASK_STACK, NULL,
+                            TELEMETRY_TASK_PRIORITY, &telemetryTask, TELEMETRY_TASK_CORE);
+  }
+}
+
+// Function to handle the "telemetry" console command
+void telemetry_command(int, const char**) {
+  const TelemetryQueue& q = telemetryQueue;
+  edgentConsole.printf(" Records:         %u sent, %u dropped, %u queued\n",
+                       q.sent, q.dropped, q.head - q.tail);
+#if TELEMETRY_PORT
+  edgentConsole.printf(" Output:          tcp://%s:%u\n", WiFi.localIP().toString().c_str(), TELEMETRY_PORT);
+#else
+  edgentConsole.printf(" Output:          Serial\n");
+#endif
+}
+
+  #define TELEMETRY(kind, box, echoUs, distanceCm, flags, confidence, angle, state) \
+    telemetry_emit(kind, box, echoUs, distanceCm, flags, confidence, angle, state)
+
+#else
+
+  #define TELEMETRY(kind, box, echoUs, distanceCm, flags, confidence, angle, state)
+
+  void telemetry_init() {}
+
+#endif
@@ -0,0 +1,291 @@
+#include "esp_timer.h"
+
+/*
+ * Hierarchical timing wheel: the one timer service for Edgent and the application.
+ *
+ * Time is kept in ms as a 64-bit count since boot (timer_now(), from
+ * esp_timer), so nothing wraps like millis() does after 49 days. The wheel
+ * has TIMER_LEVELS levels of 64 slots, level L holding the timers due in
+ * the L-th 6-bit digit of the time; a timer further out than the wheel
+ * (~4.6 hours) is parked in the top level and re-placed when it comes up.
+ * Adding and cancelling a timer are O(1), and timer_run() moves each timer
+ * down at most once per level before it fires.
+ *
+ * timer_next_deadline() tells how long nothing is due, so the loop can sleep
+ * instead of spinning. A bitmap of occupied slots per level makes it O(levels).
+ *
+ * All of it is for the loop task: timers are added, cancelled and run there.
+ */
+
+#define TIMER_LEVELS       4
+#define TIMER_SLOT_BITS    6
+#define TIMER_SLOTS        (1 << TIMER_SLOT_BITS)
+#define TIMER_SLOT_MASK    (TIMER_SLOTS - 1)
+#define TIMER_RANGE        (1ULL << (TIMER_LEVELS * TIMER_SLOT_BITS))  // ms the wheel spans
+#define TIMER_LIST_FIRING  (TIMER_LEVELS * TIMER_SLOTS)                // Due timers, being run
+#define TIMER_LIST_NONE    0xFFFF
+#define TIMER_NIL          0xFFFF
+
+typedef void (*TimerCallback)();
+typedef uint32_t TimerId;  // Generation << 16 | index; 0 is never a valid timer
+
+struct TimerNode {
+  uint64_t      deadline;  // timer_now() when it is due
+  uint32_t      period;    // 0 for a one-shot timer
+  TimerCallback cb;
+  uint16_t      next;
+  uint16_t      prev;
+  uint16_t      list;      // Slot list it is on, TIMER_LIST_FIRING, or TIMER_LIST_NONE
+  uint16_t      gen;       // Bumped on every reuse, so a stale id cannot cancel another timer
+};
+
+static TimerNode timerNodes[TIMER_MAX];
+static uint16_t  timerLists[TIMER_LEVELS * TIMER_SLOTS + 1];
+static uint64_t  timerOccupied[TIMER_LEVELS];  // Non-empty slots of each level
+static uint16_t  timerFree      = TIMER_NIL;
+static uint64_t  timerTick      = 0;           // Next tick to process, all earlier ones are done
+static bool      timerReady     = false;
+static uint16_t  timerRunning   = TIMER_NIL;   // Timer whose callback is running
+static bool      timerCancelled = false;       // It was cancelled from its own callback
+
+// Function to get the time in ms since boot; does not wrap
+static inline
+uint64_t timer_now() {
+  return esp_timer_get_time() / 1000;
+}
+
+// Function to set up the lists and the free pool, on first use
+static
+void timer_setup() {
+  if (timerReady) {
+    return;
+  }
+  for (uint16_t& head : timerLists) {
+    head = TIMER_NIL;
+  }
+  for (int i = 0; i < TIMER_MAX; i++) {
+    timerNodes[i].list = TIMER_LIST_NONE;
+    timerNodes[i].gen  = 1;
+    timerNodes[i].next = (i + 1 < TIMER_MAX) ? i + 1 : TIMER_NIL;
+  }
+  timerFree  = 0;
+  timerTick  = timer_now();
+  timerReady = true;
+}
+
+static
+void timer_link(uint16_t i, uint16_t list) {
+  TimerNode& n = timerNodes[i];
+  n.list = list;
+  n.prev = TIMER_NIL;
+  n.next = timerLists[list];
+  if (n.next != TIMER_NIL) {
+    timerNodes[n.next].prev = i;
+  }
+  timerLists[list] = i;
+  if (list < TIMER_LIST_FIRING) {
+    timerOccupied[list / TIMER_SLOTS] |= 1ULL << (list % TIMER_SLOTS);
+  }
+}
+
+static
+void timer_unlink(uint16_t i) {
+  TimerNode& n = timerNodes[i];
+  if (n.prev != TIMER_NIL) {
+    timerNodes[n.prev].next = n.next;
+  } else {
+    timerLists[n.list] = n.next;
+  }
+  if (n.next != TIMER_NIL) {
+    timerNodes[n.next].prev = n.prev;
+  }
+  if (n.list < TIMER_LIST_FIRING && timerLists[n.list] == TIMER_NIL) {
+    timerOccupied[n.list / TIMER_SLOTS] &= ~(1ULL << (n.list % TIMER_SLOTS));
+  }
+  n.list = TIMER_LIST_NONE;
+}
+
+// Function to put a timer in the slot of its deadline: the level is the highest digit it differs from the wheel in
+static
+void timer_place(uint16_t i) {
+  uint64_t when = timerNodes[i].deadline;
+  if (when < timerTick) {
+    when = timerTick;
+  }
+  const uint64_t last = timerTick | (TIMER_RANGE - 1);  // End of the span of the top level
+  if (when > last) {
+    when = last;  // Parked; it is placed again when this slot comes up
+  }
+  const uint64_t diff  = when ^ timerTick;
+  const int      level = diff ? (63 - __builtin_clzll(diff)) / TIMER_SLOT_BITS : 0;
+  const int      slot  = (when >> (level * TIMER_SLOT_BITS)) & TIMER_SLOT_MASK;
+  timer_link(i, level * TIMER_SLOTS + slot);
+}
+
+// Function to release a timer back to the pool
+static
+void timer_release(uint16_t i) {
+  timerNodes[i].gen = (timerNodes[i].gen + 1) ? timerNodes[i].gen + 1 : 1;
+  timerNodes[i].next = timerFree;
+  timerFree = i;
+}
+
+// Function to add a timer, returns 0 when the pool is exhausted
+static
+TimerId timer_add(uint32_t ms, uint32_t period, TimerCallback cb) {
+  timer_setup();
+  if (timerFree == TIMER_NIL) {
+    LOG_E("Out of timers (TIMER_MAX %d)", TIMER_MAX);
+    return 0;
+  }
+  const uint16_t i = timerFree;
+  timerFree = timerNodes[i].next;
+  TimerNode& n = timerNodes[i];
+  n.deadline = timer_now() + ms;
+  n.period   = period;
+  n.cb       = cb;
+  timer_place(i);
+  return ((TimerId)n.gen << 16) | i;
+}
+
+// Function to call cb once, ms from now
+TimerId timer_once(uint32_t ms, TimerCallback cb) {
+  return timer_add(ms, 0, cb);
+}
+
+// Function to call cb every ms, the first time ms from now
+TimerId timer_every(uint32_t ms, TimerCallback cb) {
+  return timer_add(ms, ms ? ms : 1, cb);
+}
+
+// Function to get the node of a timer id, or NULL if the timer is gone
+static
+TimerNode* timer_find(TimerId id) {
+  const uint16_t i = id & 0xFFFF;
+  if (!id || i >= TIMER_MAX || timerNodes[i].gen != (id >> 16)) {
+    return NULL;
+  }
+  if (timerNodes[i].list == TIMER_LIST_NONE && !(i == timerRunning && !timerCancelled)) {
+    return NULL;
+  }
+  return &timerNodes[i];
+}
+
+// Function to tell whether a timer is still due to run
+bool timer_pending(TimerId id) {
+  const TimerNode* n = timer_find(id);
+  return n && (n->list != TIMER_LIST_NONE || n->period);
+}
+
+// Function to cancel a timer, also from its own callback; clears the id
+void timer_cancel(TimerId& id) {
+  const uint16_t i = id & 0xFFFF;
+  if (timer_find(id)) {
+    if (i == timerRunning) {
+      timerCancelled = true;  // Released once the callback returns
+    } else {
+      timer_unlink(i);
+      timer_release(i);
+    }
+  }
+  id = 0;
+}
+
+// Function to run the timers that are due; called from the loop
+void timer_run() {
+  timer_setup();
+  const uint64_t now = timer_now();
+  while (timerTick <= now) {
+    const uint64_t t = timerTick;
+
+    // At the start of a slot of a higher level, move its timers down, highest level first
+    if (!(t & TIMER_SLOT_MASK)) {
+      int top = 1;
+      while (top < TIMER_LEVELS - 1 && !((t >> (top * TIMER_SLOT_BITS)) & TIMER_SLOT_MASK)) {
+        top++;
+      }
+      for (int level = top; level >= 1; level--) {
+        const uint16_t list = level * TIMER_SLOTS + ((t >> (level * TIMER_SLOT_BITS)) & TIMER_SLOT_MASK);
+        while (timerLists[list] != TIMER_NIL) {
+          const uint16_t i = timerLists[list];
+          timer_unlink(i);
+          timer_place(i);
+        }
+      }
+    }
+
+    // Take the due timers out of the wheel, so callbacks can add and cancel timers freely
+    const uint16_t slot = t & TIMER_SLOT_MASK;
+    while (timerLists[slot] != TIMER_NIL) {
+      const uint16_t i = timerLists[slot];
+      timer_unlink(i);
+      timer_link(i, TIMER_LIST_FIRING);
+    }
+    timerTick = t + 1;
+
+    while (timerLists[TIMER_LIST_FIRING] != TIMER_NIL) {
+      const uint16_t i = timerLists[TIMER_LIST_FIRING];
+      TimerNode& n = timerNodes[i];
+      timer_unlink(i);
+      if (n.deadline > t) {
+        timer_place(i);  // Was parked, not due yet
+        continue;
+      }
+      timerRunning   = i;
+      timerCancelled = false;
+      n.cb();
+      timerRunning = TIMER_NIL;
+      if (n.period && !timerCancelled) {
+        n.deadline += n.period;  // Keeps the phase
+        if (n.deadline <= t) {
+          n.deadline = t + n.period;  // Fell behind: skip the missed runs
+        }
+        timer_place(i);
+      } else {
+        timer_release(i);
+      }
+    }
+
+    // Skip the empty ticks, up to the next occupied slot or the next cascade
+    uint64_t next = (t | TIMER_SLOT_MASK) + 1;
+    const int from = slot + 1;
+    if (from < TIMER_SLOTS) {
+      const uint64_t bits = timerOccupied[0] >> from;
+      if (bits) {
+        next = (t & ~(uint64_t)TIMER_SLOT_MASK) + from + __builtin_ctzll(bits);
+      }
+    }
+    timerTick = (next <= now) ? next : now + 1;
+  }
+}
+
+// Function to get the earliest time a timer can be due; UINT64_MAX if there are none
+uint64_t timer_next_deadline() {
+  timer_setup();
+  for (int level = 0; level < TIMER_LEVELS; level++) {
+    const int shift = level * TIMER_SLOT_BITS;
+    // The slot of the current digit is already cascaded, unless its first tick is still to come
+    const bool cascaded = timerTick & ((1ULL << shift) - 1);
+    const int  from     = ((timerTick >> shift) & TIMER_SLOT_MASK) + (cascaded ? 1 : 0);
+    if (from >= TIMER_SLOTS) {
+      continue;
+    }
+    const uint64_t bits = timerOccupied[level] >> from;
+    if (bits) {
+      // Start of the first occupied slot: exact on level 0, a lower bound above
+      const uint64_t base = (timerTick >> (shift + TIMER_SLOT_BITS)) << (shift + TIMER_SLOT_BITS);
+      return base | ((uint64_t)(from + __builtin_ctzll(bits)) << shift);
+    }
+  }
+  return UINT64_MAX;
+}
+
+// Function to get how long nothing is due, in ms, up to limit
+uint32_t timer_idle_ms(uint32_t limit) {
+  const uint64_t next = timer_next_deadline();
+  const uint64_t now  = timer_now();
+  if (next <= now) {
+    return 0;
+  }
+  return (next - now < limit) ? next - now : limit;
+}
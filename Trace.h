@@ -0,0 +1,115 @@
+/*
+ * Event tracer: timestamped begin/end/instant events in a ring buffer per core.
+ *
+ * Writers claim a slot with one atomic increment, so tracing never takes a
+ * lock and works from any task. The "trace" console command dumps the
+ * buffers; tools/trace2chrome.py turns the dump into Chrome/Perfetto JSON.
+ * Without TRACE_ENABLE all of this compiles to nothing.
+ */
+
+#ifdef TRACE_ENABLE
+
+#include "esp_timer.h"
+
+// Names of the traced events
+enum TraceName {
+  TRACE_STATE,        // BlynkState::set(), arg = new state
+  TRACE_BLYNK_WRITE,  // BLYNK_WRITE handler, arg = virtual pin
+  TRACE_GEOFENCE,     // checkGeofence(), arg = inside the geofence at the end
+  TRACE_SERVO,        // moveToTargetAngle(), arg = target angle
+  TRACE_CAMERA,       // Camera frame capture, arg = frame size
+  TRACE_COMPONENTS,   // runElectronicComponents()
+  TRACE_OTA,          // OTA job progress, arg = percent
+  TRACE_LOCK,         // Lock state machine transition, arg = compartment << 16 | event << 8 | new state
+  TRACE_NAME_MAX
+};
+
+static const char* const traceNames[TRACE_NAME_MAX] = {
+  "state",
+  "blynk_write",
+  "geofence",
+  "servo",
+  "camera",
+  "components",
+  "ota",
+  "lock",
+};
+
+// Event phases, named as in the Chrome trace format
+#define TRACE_PH_BEGIN    'B'
+#define TRACE_PH_END      'E'
+#define TRACE_PH_INSTANT  'i'
+
+struct TraceEvent {
+  uint32_t ts;     // esp_timer time in us (wraps every ~71 minutes)
+  uint8_t  phase;
+  uint8_t  name;
+  uint16_t arg;
+};
+
+struct TraceRing {
+  volatile uint32_t head;  // Total events written; the slot is head % TRACE_RING_SIZE
+  TraceEvent events[TRACE_RING_SIZE];
+};
+
+static TraceRing traceRings[portNUM_PROCESSORS];
+
+// Function to add an event to the ring of the current core
+static inline
+void trace_event(uint8_t phase, uint8_t name, uint16_t arg) {
+  TraceRing& ring = traceRings[xPortGetCoreID()];
+  const uint32_t slot = __atomic_fetch_add(&ring.head, 1, __ATOMIC_RELAXED) % TRACE_RING_SIZE;
+  TraceEvent& ev = ring.events[slot];
+  ev.ts    = (uint32_t)esp_timer_get_time();
+  ev.phase = phase;
+  ev.name  = name;
+  ev.arg   = arg;
+}
+
+// Function to drop all recorded events
+void trace_clear() {
+  for (int core = 0; core < portNUM_PROCESSORS; core++) {
+    traceRings[core].head = 0;
+  }
+}
+
+// Function to print the recorded events, oldest first, one per line:
+//   <core> <ts> <phase> <name> <arg>
+template <typename Out>
+void trace_dump(Out& out) {
+  for (int core = 0; core < portNUM_PROCESSORS; core++) {
+    const TraceRing& ring = traceRings[core];
+    const uint32_t head  = ring.head;
+    const uint32_t first = (head > TRACE_RING_SIZE) ? head - TRACE_RING_SIZE : 0;
+    for (uint32_t i = first; i < head; i++) {
+      const TraceEvent& ev = ring.events[i % TRACE_RING_SIZE];
+      out.printf("%d %u %c %s %u\n", core, ev.ts, ev.phase,
+                 (ev.name < TRACE_NAME_MAX) ? traceNames[ev.name] : "?", ev.arg);
+    }
+  }
+}
+
+// Records a begin event now and the matching end event when the scope is left
+class TraceScope {
+public:
+  TraceScope(uint8_t name, uint16_t arg) : m_Name(name) { trace_event(TRACE_PH_BEGIN, name, arg); }
+  ~TraceScope() { trace_event(TRACE_PH_END, m_Name, 0); }
+private:
+  uint8_t m_Name;
+};
+
+  #define TRACE_CONCAT2(a, b)  a##b
+  #define TRACE_CONCAT(a, b)   TRACE_CONCAT2(a, b)
+  #define TRACE_BEGIN(name, arg)    trace_event(TRACE_PH_BEGIN, name, arg)
+  #define TRACE_END(name, arg)      trace_event(TRACE_PH_END, name, arg)
+  #define TRACE_INSTANT(name, arg)  trace_event(TRACE_PH_INSTANT, name, arg)
+  #define TRACE_SCOPE(name, arg)    TraceScope TRACE_CONCAT(traceScope, __LINE__)(name, arg)
+
+#else
+
+  #define TRACE_BEGIN(name, arg)
+  #define TRACE_END(name, arg)
+  #define TRACE_INSTANT(name, arg)
+  #define TRACE_SCOPE(name, arg)
+
+#endif
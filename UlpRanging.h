@@ -0,0 +1,295 @@
+/*
+ * Deep sleep with ultrasonic ranging on the ULP coprocessor, for battery units
+ * (ULP_RANGING in Settings.h).
+ *
+ * Once the box has been idle and locked for ULP_SLEEP_AFTER ms, the main cores
+ * go to deep sleep. Every ULP_PING_INTERVAL ms the ULP pulses trigPin, times
+ * the echo on echoPin by counting loop iterations, and wakes the main cores
+ * only when the echo is shorter than unlockDistance. The main cores also wake
+ * every ULP_CHECKIN_INTERVAL s, to pick up changes made in the app.
+ *
+ * Lock state, home location and the last Wi-Fi connection are kept in RTC
+ * memory, so after a wake the box reconnects to the cached AP directly and
+ * decides with the state it went to sleep with.
+ *
+ * trigPin and echoPin must be RTC GPIOs (2 and 15 are RTC_GPIO12 and 13).
+ *
+ * The distance conversions and a model of the echo loops are kept free of
+ * Arduino dependencies, so the "ulp" benchmark can check the timing on the
+ * host.
+ */
+
+#include <stdint.h>
+
+// ULP timing: RTC fast clock, 8.5 MHz nominal; instruction cycles include
+// the fetch of the next one
+#define ULP_CLOCK_HZ      8500000
+#define ULP_RD_CYCLES     8       // REG_RD
+#define ULP_LD_CYCLES     8       // LD
+#define ULP_ALU_CYCLES    6       // MOVI, SUBI
+#define ULP_JUMP_CYCLES   4       // JUMP, JUMPR
+#define ULP_LOOP_CYCLES   (ULP_RD_CYCLES + ULP_ALU_CYCLES + 3 * ULP_JUMP_CYCLES)  // REG_RD, JUMPR, SUBI, JUMP, JUMP
+#define ULP_TRIG_CYCLES   100     // Trigger pulse, >10 us
+#define ULP_RISE_LOOPS    2000    // The echo starts within ~6 ms, or there is no sensor
+
+// Function to get the echo loops the ULP counts for a distance
+static inline
+uint32_t ulp_echo_loops(float cm) {
+  const float echoUs = cm * 2 / 0.0343;
+  return echoUs * (ULP_CLOCK_HZ / 1000000.0) / ULP_LOOP_CYCLES;
+}
+
+// Function to get the distance for a number of echo loops
+static inline
+float ulp_echo_distance(uint32_t loops) {
+  const float echoUs = loops * ULP_LOOP_CYCLES / (ULP_CLOCK_HZ / 1000000.0);
+  return echoUs * 0.0343 / 2;
+}
+
+// What the ranging program does with one echo
+struct UlpEcho {
+  bool     rose;    // The echo started within ULP_RISE_LOOPS
+  bool     wake;    // It ended before the threshold ran out: the ULP wakes the main cores
+  uint16_t remain;  // R2 when it ended, as stored in ULP_VAR_REMAIN
+  uint32_t cycles;  // From the end of the trigger pulse to the decision
+};
+
+// Function to run the echo loops of the ranging program instruction by instruction, on an echo
+// from riseCycles to riseCycles + widthCycles after the trigger pulse; for the host benchmarks
+static
+UlpEcho ulp_echo_model(uint16_t threshold, uint32_t riseCycles, uint32_t widthCycles) {
+  UlpEcho e = { false, false, 0, ULP_ALU_CYCLES };  // MOVI R2, ULP_RISE_LOOPS
+  uint16_t r2 = ULP_RISE_LOOPS;
+  bool     high;
+  for (;;) {
+    high = e.cycles >= riseCycles && e.cycles - riseCycles < widthCycles;  // REG_RD samples the pin
+    e.cycles += ULP_RD_CYCLES + ULP_JUMP_CYCLES;                         // REG_RD, JUMPR
+    if (high) {
+      break;
+    }
+    r2--;
+    e.cycles += ULP_ALU_CYCLES + ULP_JUMP_CYCLES;                        // SUBI, JUMP if zero
+    if (!r2) {
+      return e;
+    }
+    e.cycles += ULP_JUMP_CYCLES;                                         // JUMP back
+  }
+
+  e.rose = true;
+  r2 = threshold;
+  e.cycles += ULP_LD_CYCLES;
+  for (;;) {
+    high = e.cycles >= riseCycles && e.cycles - riseCycles < widthCycles;
+    e.cycles += ULP_RD_CYCLES + ULP_JUMP_CYCLES;
+    if (!high) {
+      e.wake   = true;
+      e.remain = r2;
+      return e;
+    }
+    r2--;
+    e.cycles += ULP_ALU_CYCLES + ULP_JUMP_CYCLES;
+    if (!r2) {
+      return e;
+    }
+    e.cycles += ULP_JUMP_CYCLES;
+  }
+}
+
+#if defined(ARDUINO) && defined(ULP_RANGING)
+
+#include "esp_sleep.h"
+#include "esp32/ulp.h"
+#include "driver/rtc_io.h"
+#include "soc/rtc_io_reg.h"
+#include "soc/rtc_cntl_reg.h"
+
+// RTC slow memory layout, in 32-bit words (the ULP uses the low 16 bits)
+#define ULP_VAR_THRESHOLD 0       // Echo loops that make up unlockDistance
+#define ULP_VAR_REMAIN    1       // Loops left when the echo ended, written before a wake
+#define ULP_PROG_START    16
+
+#define ULP_RTC_MAGIC     0x554C5052  // "ULPR"
+
+struct UlpRtcState {
+  uint32_t magic;
+  uint32_t sleeps;          // Deep sleeps since power-up
+  bool     lockState;
+  double   latitudeHome;
+  double   longitudeHome;
+  uint8_t  netSlot;         // Last good connection, as in configStore
+  uint8_t  netBSSID[6];
+  uint8_t  netChannel;
+  uint32_t netIP;
+  uint32_t netMask;
+  uint32_t netGW;
+  uint32_t netDNS;
+};
+
+RTC_DATA_ATTR UlpRtcState ulpRtc;
+
+static esp_sleep_wakeup_cause_t ulpWakeCause = ESP_SLEEP_WAKEUP_UNDEFINED;
+static uint32_t                 ulpIdleStart = 0;  // millis() when the box was last busy
+
+// Function to load the ranging program into the ULP and start its timer
+static
+bool ulp_ranging_start() {
+  const int trig = rtc_io_number_get((gpio_num_t)trigPin);
+  const int echo = rtc_io_number_get((gpio_num_t)echoPin);
+  if (trig < 0 || echo < 0) {
+    LOG_E("ULP ranging needs RTC GPIOs for trig and echo");
+    return false;
+  }
+
+  rtc_gpio_init((gpio_num_t)trigPin);
+  rtc_gpio_set_direction((gpio_num_t)trigPin, RTC_GPIO_MODE_OUTPUT_ONLY);
+  rtc_gpio_set_level((gpio_num_t)trigPin, 0);
+  rtc_gpio_init((gpio_num_t)echoPin);
+  rtc_gpio_set_direction((gpio_num_t)echoPin, RTC_GPIO_MODE_INPUT_ONLY);
+
+  enum { L_WAIT_RISE, L_RISEN, L_COUNT, L_FELL, L_DONE };
+  const ulp_insn_t program[] = {
+    I_MOVI(R3, 0),                          // Base address of the variables
+
+    // Trigger pulse
+    I_WR_REG(RTC_GPIO_OUT_W1TS_REG, RTC_GPIO_OUT_DATA_W1TS_S + trig, RTC_GPIO_OUT_DATA_W1TS_S + trig, 1),
+    I_DELAY(ULP_TRIG_CYCLES),
+    I_WR_REG(RTC_GPIO_OUT_W1TC_REG, RTC_GPIO_OUT_DATA_W1TC_S + trig, RTC_GPIO_OUT_DATA_W1TC_S + trig, 1),
+
+    // Wait for the echo to start
+    I_MOVI(R2, ULP_RISE_LOOPS),
+    M_LABEL(L_WAIT_RISE),
+      I_RD_REG(RTC_GPIO_IN_REG, RTC_GPIO_IN_NEXT_S + echo, RTC_GPIO_IN_NEXT_S + echo),
+      M_BGE(L_RISEN, 1),
+      I_SUBI(R2, R2, 1),
+      M_BXZ(L_DONE),
+      M_BX(L_WAIT_RISE),
+
+    // Count down while the echo is high; running out means the parcel is too far
+    M_LABEL(L_RISEN),
+    I_LD(R2, R3, ULP_VAR_THRESHOLD),
+    M_LABEL(L_COUNT),
+      I_RD_REG(RTC_GPIO_IN_REG, RTC_GPIO_IN_NEXT_S + echo, RTC_GPIO_IN_NEXT_S + echo),
+      M_BL(L_FELL, 1),
+      I_SUBI(R2, R2, 1),
+      M_BXZ(L_DONE),
+      M_BX(L_COUNT),
+
+    // Close enough: wake the main cores, and stop the ULP timer
+    M_LABEL(L_FELL),
+    I_ST(R2, R3, ULP_VAR_REMAIN),
+    I_WAKE(),
+    I_END(),
+
+    M_LABEL(L_DONE),
+    I_HALT(),
+  };
+
+  RTC_SLOW_MEM[ULP_VAR_THRESHOLD] = ulp_echo_loops(unlockDistance);
+  RTC_SLOW_MEM[ULP_VAR_REMAIN]    = 0;
+
+  size_t size = sizeof(program) / sizeof(ulp_insn_t);
+  if (ESP_OK != ulp_process_macros_and_load(ULP_PROG_START, program, &size) ||
+      ESP_OK != ulp_set_wakeup_period(0, ULP_PING_INTERVAL * 1000) ||
+      ESP_OK != ulp_run(ULP_PROG_START))
+  {
+    LOG_E("Failed to start the ULP");
+    return false;
+  }
+  return true;
+}
+
+// Function to keep the state the box decides with in RTC memory, and go to deep sleep
+void ulp_ranging_sleep() {
+  ulpRtc.magic         = ULP_RTC_MAGIC;
+  ulpRtc.sleeps++;
+  ulpRtc.lockState     = lockState;
+  ulpRtc.latitudeHome  = latitude_home;
+  ulpRtc.longitudeHome = longitude_home;
+  if (configStore.getFlag(CONFIG_FLAG_NET_CACHE)) {
+    ulpRtc.netSlot    = configStore.netSlot;
+    memcpy(ulpRtc.netBSSID, configStore.netBSSID, sizeof(ulpRtc.netBSSID));
+    ulpRtc.netChannel = configStore.netChannel;
+    ulpRtc.netIP      = configStore.netIP;
+    ulpRtc.netMask    = configStore.netMask;
+    ulpRtc.netGW      = configStore.netGW;
+    ulpRtc.netDNS     = configStore.netDNS;
+  } else {
+    ulpRtc.netChannel = 0;
+  }
+
+  const bool ranging = ulp_ranging_start();
+  if (ranging) {
+    esp_sleep_enable_ulp_wakeup();
+    esp_sleep_pd_config(ESP_PD_DOMAIN_RTC_PERIPH, ESP_PD_OPTION_ON);  // Keeps the RTC GPIOs driven
+  }
+  esp_sleep_enable_timer_wakeup(ULP_CHECKIN_INTERVAL * 1000000ULL);
+
+  LOG_I("Deep sleep #%u, %s", ulpRtc.sleeps, ranging ? "ULP ranging" : "timer only");
+  log_flush(100);
+  Blynk.disconnect();
+  esp_deep_sleep_start();
+}
+
+// Function to restore the state kept across a deep sleep, call after BlynkEdgent.begin()
+void ulp_ranging_wake() {
+  ulpWakeCause = esp_sleep_get_wakeup_cause();
+  ulpIdleStart = millis();
+  if (ulpWakeCause != ESP_SLEEP_WAKEUP_ULP && ulpWakeCause != ESP_SLEEP_WAKEUP_TIMER) {
+    return;
+  }
+  CLEAR_PERI_REG_MASK(RTC_CNTL_STATE0_REG, RTC_CNTL_ULP_CP_SLP_TIMER_EN);  // A timer wake leaves the ULP pinging
+  rtc_gpio_deinit((gpio_num_t)trigPin);  // Back to the GPIO matrix
+  rtc_gpio_deinit((gpio_num_t)echoPin);
+  if (ulpRtc.magic != ULP_RTC_MAGIC) {
+    return;
+  }
+
+  lockState      = ulpRtc.lockState;
+  latitude_home  = ulpRtc.latitudeHome;
+  longitude_home = ulpRtc.longitudeHome;
+
+  // Connect straight to the AP of the last connection, without a scan
+  if (ulpRtc.netChannel && configStore.getFlag(CONFIG_FLAG_VALID)) {
+    configStore.netSlot    = ulpRtc.netSlot;
+    memcpy(configStore.netBSSID, ulpRtc.netBSSID, sizeof(configStore.netBSSID));
+    configStore.netChannel = ulpRtc.netChannel;
+    configStore.netIP      = ulpRtc.netIP;
+    configStore.netMask    = ulpRtc.netMask;
+    configStore.netGW      = ulpRtc.netGW;
+    configStore.netDNS     = ulpRtc.netDNS;
+    configStore.setFlag(CONFIG_FLAG_NET_CACHE, true);
+  }
+
+  if (ulpWakeCause == ESP_SLEEP_WAKEUP_ULP) {
+    const uint32_t loops = ulp_echo_loops(unlockDistance) - (RTC_SLOW_MEM[ULP_VAR_REMAIN] & 0xFFFF);
+    LOG_I("Woken by the ULP: parcel at ~%.1f cm", ulp_echo_distance(loops));
+  } else {
+    LOG_I("Woken for the check-in");
+  }
+}
+
+// Function to tell whether this boot is a wake from deep sleep
+bool ulp_ranging_woken() {
+  return ulpWakeCause == ESP_SLEEP_WAKEUP_ULP || ulpWakeCause == ESP_SLEEP_WAKEUP_TIMER;
+}
+
+// Function to go to deep sleep once the box has been idle and locked long enough; called once per loop pass
+void ulp_ranging_run() {
+  if (powerStats.profile != POWER_IDLE || !lockState || openState ||
+      BlynkState::get() != MODE_RUNNING)
+  {
+    ulpIdleStart = millis();
+    return;
+  }
+  if (millis() - ulpIdleStart >= ULP_SLEEP_AFTER) {
+    ulp_ranging_sleep();
+  }
+}
+
+#elif defined(ARDUINO)
+
+void ulp_ranging_wake() {}
+bool ulp_ranging_woken() { return false; }
+void ulp_ranging_run() {}
+
+#endif
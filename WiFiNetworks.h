@@ -0,0 +1,211 @@
+#include <algorithm>
+
+// Number of network slots: slot 0 is the provisioned network, the rest are fallbacks
+#define WIFI_SLOT_COUNT  (1 + CONFIG_WIFI_ALT_MAX)
+
+// Why wifi_slot_add() or wifi_slot_forget() refused a network
+#define WIFI_SLOT_ERR_PROVISIONED  -1  // The provisioned network, changed through provisioning only
+#define WIFI_SLOT_ERR_FULL         -2  // No free fallback slot
+#define WIFI_SLOT_ERR_UNKNOWN      -3  // Not in the list
+
+// Function to get the SSID of a network slot
+static
+const char* wifi_slot_ssid(int slot) {
+  return (slot == 0) ? configStore.wifiSSID : configStore.wifiAltSSID[slot-1];
+}
+
+// Function to get the password of a network slot
+static
+const char* wifi_slot_pass(int slot) {
+  return (slot == 0) ? configStore.wifiPass : configStore.wifiAltPass[slot-1];
+}
+
+// Function to count the configured network slots
+static
+int wifi_slot_count() {
+  int count = 0;
+  for (int slot = 0; slot < WIFI_SLOT_COUNT; slot++) {
+    if (wifi_slot_ssid(slot)[0]) {
+      count++;
+    }
+  }
+  return count;
+}
+
+// Function to find the slot of a network by SSID, or -1 if it is not known
+static
+int wifi_slot_find(const char* ssid) {
+  for (int slot = 0; slot < WIFI_SLOT_COUNT; slot++) {
+    if (wifi_slot_ssid(slot)[0] && 0 == strcmp(wifi_slot_ssid(slot), ssid)) {
+      return slot;
+    }
+  }
+  return -1;
+}
+
+// Function to add (or update) a fallback network, returns its slot or a WIFI_SLOT_ERR_ code
+int wifi_slot_add(const char* ssid, const char* pass) {
+  int slot = wifi_slot_find(ssid);
+  if (slot == 0) {
+    return WIFI_SLOT_ERR_PROVISIONED;
+  }
+  for (int i = 1; slot < 0 && i < WIFI_SLOT_COUNT; i++) {
+    if (!wifi_slot_ssid(i)[0]) {
+      slot = i;
+    }
+  }
+  if (slot < 0) {
+    return WIFI_SLOT_ERR_FULL;
+  }
+  CopyString(ssid, configStore.wifiAltSSID[slot-1]);
+  CopyString(pass, configStore.wifiAltPass[slot-1]);
+  return slot;
+}
+
+// Function to remove a fallback network, keeping the remaining ones in order; returns 0 or a WIFI_SLOT_ERR_ code
+int wifi_slot_forget(const char* ssid) {
+  int slot = wifi_slot_find(ssid);
+  if (slot < 0) {
+    return WIFI_SLOT_ERR_UNKNOWN;
+  }
+  if (slot == 0) {
+    return WIFI_SLOT_ERR_PROVISIONED;
+  }
+  for (int i = slot; i < CONFIG_WIFI_ALT_MAX; i++) {
+    memcpy(configStore.wifiAltSSID[i-1], configStore.wifiAltSSID[i], sizeof(configStore.wifiAltSSID[0]));
+    memcpy(configStore.wifiAltPass[i-1], configStore.wifiAltPass[i], sizeof(configStore.wifiAltPass[0]));
+  }
+  memset(configStore.wifiAltSSID[CONFIG_WIFI_ALT_MAX-1], 0, sizeof(configStore.wifiAltSSID[0]));
+  memset(configStore.wifiAltPass[CONFIG_WIFI_ALT_MAX-1], 0, sizeof(configStore.wifiAltPass[0]));
+  configStore.setFlag(CONFIG_FLAG_NET_CACHE, false);  // The cached AP may belong to a shifted slot
+  return 0;
+}
+
+// Function to describe a WIFI_SLOT_ERR_ code
+static
+const char* wifi_slot_error(int err) {
+  switch (err) {
+  case WIFI_SLOT_ERR_PROVISIONED: return "the provisioned network can only be changed by provisioning";
+  case WIFI_SLOT_ERR_FULL:        return "network list is full";
+  case WIFI_SLOT_ERR_UNKNOWN:     return "unknown network";
+  default:                        return "error";
+  }
+}
+
+/*
+ * Known APs seen by the last scan, best first
+ */
+
+struct KnownAP {
+  uint8_t bssid[6];
+  uint8_t channel;
+  int8_t  rssi;
+  uint8_t slot;
+};
+
+static KnownAP  knownAPs[WIFI_KNOWN_AP_MAX];
+static int      knownAPCount   = 0;
+static uint32_t knownAPTime    = 0;      // millis() when the scan completed, 0 = no results
+static bool     wifiScanActive = false;  // A background scan is in progress
+
+// Function to score an AP: stronger is better, and each step down the network list costs a few dB
+static inline
+int wifi_ap_score(int rssi, int slot) {
+  return rssi - slot * WIFI_SLOT_PENALTY_DB;
+}
+
+// Function to pick the known networks out of finished scan results
+static
+void wifi_scan_collect(int found) {
+  knownAPCount = 0;
+  for (int i = 0; i < found && knownAPCount < WIFI_KNOWN_AP_MAX; i++) {
+    int slot = wifi_slot_find(WiFi.SSID(i).c_str());
+    if (slot < 0) {
+      continue;
+    }
+    KnownAP& ap = knownAPs[knownAPCount++];
+    memcpy(ap.bssid, WiFi.BSSID(i), sizeof(ap.bssid));
+    ap.channel = WiFi.channel(i);
+    ap.rssi    = WiFi.RSSI(i);
+    ap.slot    = slot;
+  }
+  WiFi.scanDelete();
+
+  std::sort(knownAPs, knownAPs + knownAPCount, [](const KnownAP& a, const KnownAP& b) {
+    return wifi_ap_score(a.rssi, a.slot) > wifi_ap_score(b.rssi, b.slot);
+  });
+  knownAPTime = millis() | 1;
+}
+
+// Function to check if the scan results are recent enough to pick an AP
+static
+bool wifi_scan_fresh() {
+  return knownAPTime && (millis() - knownAPTime < WIFI_SCAN_MAX_AGE);
+}
+
+// Function to start a background scan, picked up later by wifi_scan_poll()
+void wifi_scan_start() {
+  if (!wifiScanActive && WiFi.scanNetworks(true) == WIFI_SCAN_RUNNING) {
+    wifiScanActive = true;
+  }
+}
+
+// Function to collect the background scan results, returns true when a scan has just finished
+bool wifi_scan_poll() {
+  if (!wifiScanActive) {
+    return false;
+  }
+  int found = WiFi.scanComplete();
+  if (found == WIFI_SCAN_RUNNING) {
+    return false;
+  }
+  wifiScanActive = false;
+  if (found < 0) {
+    return false;
+  }
+  wifi_scan_collect(found);
+  return true;
+}
+
+// Function to scan in the foreground (takes a couple of seconds)
+void wifi_scan_now() {
+  int found = WiFi.scanNetworks();
+  wifiScanActive = false;
+  if (found >= 0) {
+    wifi_scan_collect(found);
+  }
+}
+
+// Function to look for a better AP while the current one degrades
+void wifi_roam_check() {
+  if (!BlynkState::is(MODE_RUNNING) || WiFi.status() != WL_CONNECTED) {
+    return;
+  }
+
+  const int slot = BlynkMax(0, wifi_slot_find(WiFi.SSID().c_str()));
+  const int currentScore = wifi_ap_score(WiFi.RSSI(), slot);
+
+  if (wifi_scan_poll()) {
+    if (knownAPCount &&
+        memcmp(knownAPs[0].bssid, WiFi.BSSID(), sizeof(knownAPs[0].bssid)) &&
+        wifi_ap_score(knownAPs[0].rssi, knownAPs[0].slot) >= currentScore + WIFI_ROAM_HYSTERESIS_DB)
+    {
+      DEBUG_PRINTF("Roaming to %s (%d dBm, was %d dBm)",
+                   wifi_slot_ssid(knownAPs[0].slot), knownAPs[0].rssi, WiFi.RSSI());
+      configStore.setFlag(CONFIG_FLAG_NET_CACHE, false);  // Connect to the scan pick, not the cached AP
+      Blynk.disconnect();
+      WiFi.disconnect();
+      BlynkState::set(MODE_CONNECTING_NET);
+    }
+    return;
+  }
+
+  if (WiFi.RSSI() < WIFI_ROAM_RSSI_THRESHOLD) {
+    wifi_scan_start();
+  }
+}
+
+// Function to start the periodic link quality check
+void wifi_roam_init() {
+  timer_every(WIFI_ROAM_CHECK_INTERVAL, wifi_roam_check);
+}
@@ -0,0 +1,50 @@
+// Generated by tools/gen_config_form.py from tools/config_form.html, do not edit
+
+//File: config_form.html.gz, Size: 695
+#define config_form_html_gz_len 695
+const uint8_t config_form_html_gz[] = {
+ 0x1F, 0x8B, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x03, 0x9D, 0x54, 0x7F, 0x6B, 0xDB, 0x30,
+ 0x10, 0xFD, 0xBF, 0x9F, 0x42, 0xD3, 0x18, 0x6C, 0x50, 0xC7, 0x69, 0x93, 0x14, 0xE6, 0x38, 0x86,
+ 0xB2, 0x6E, 0x6C, 0xB0, 0xB1, 0xB2, 0x16, 0xC6, 0x56, 0x4A, 0x91, 0x2D, 0xD9, 0x16, 0x91, 0x2D,
+ 0x4F, 0x3A, 0x37, 0x49, 0x4B, 0xBF, 0xFB, 0x4E, 0x96, 0xF3, 0xA3, 0xEB, 0xD6, 0x6E, 0xC3, 0x20,
+ 0x9F, 0x75, 0xA7, 0xBB, 0xA7, 0xF7, 0xEE, 0x1C, 0x3F, 0x3B, 0xF9, 0xFC, 0xE6, 0xFC, 0xDB, 0xE9,
+ 0x5B, 0xF2, 0xFE, 0xFC, 0xD3, 0xC7, 0x64, 0x2F, 0x2E, 0xA1, 0x52, 0xEE, 0x25, 0x18, 0x4F, 0xF6,
+ 0x08, 0x89, 0x41, 0x82, 0x12, 0xC9, 0x57, 0xF9, 0x4E, 0x12, 0x2B, 0xA0, 0x6D, 0xE2, 0xD0, 0xEF,
+ 0x38, 0x9F, 0x85, 0x95, 0xB7, 0x52, 0xCD, 0x57, 0xE4, 0x16, 0x0D, 0x34, 0x59, 0x36, 0x2F, 0x8C,
+ 0x6E, 0x6B, 0x1E, 0x64, 0x5A, 0x69, 0x13, 0x91, 0xE7, 0x79, 0xE6, 0x9E, 0xA9, 0x77, 0xEB, 0x65,
+ 0x60, 0xE5, 0x8D, 0xAC, 0x8B, 0x08, 0x6D, 0xC3, 0x85, 0x09, 0x70, 0xCB, 0xF9, 0xEE, 0xFA, 0x3C,
+ 0xFB, 0x44, 0xD6, 0x4D, 0x0B, 0x7D, 0xBA, 0x5C, 0xD7, 0x10, 0xE4, 0xAC, 0x92, 0x6A, 0x15, 0x91,
+ 0x2F, 0x3A, 0xD5, 0xA0, 0xF7, 0x89, 0x65, 0xB5, 0x0D, 0xAC, 0x30, 0x32, 0x9F, 0x6E, 0x83, 0x16,
+ 0x42, 0x16, 0x25, 0x44, 0x64, 0x3C, 0x1C, 0xEE, 0xEC, 0x62, 0x2D, 0x11, 0x91, 0x83, 0xA3, 0x66,
+ 0x53, 0x63, 0x90, 0x89, 0x1A, 0x84, 0x11, 0xBC, 0xAF, 0xD0, 0x68, 0x2B, 0x41, 0xEA, 0x3A, 0x22,
+ 0xB9, 0x5C, 0x0A, 0xEE, 0xCF, 0x82, 0x6E, 0x22, 0x32, 0x19, 0xBE, 0xF0, 0x5F, 0x4A, 0xE4, 0xB0,
+ 0xF3, 0x09, 0x06, 0xEB, 0xE7, 0xDA, 0x54, 0x91, 0x37, 0x15, 0x03, 0xF1, 0x32, 0x40, 0xF7, 0x3E,
+ 0x71, 0xEB, 0x2B, 0x1F, 0xD5, 0x30, 0xCE, 0xBB, 0x6B, 0x1E, 0x0E, 0x7D, 0xF1, 0xDF, 0x72, 0x93,
+ 0x65, 0x1B, 0x62, 0x3A, 0x32, 0x0C, 0xE3, 0xB2, 0xB5, 0x78, 0x8B, 0x2D, 0x60, 0x40, 0xA4, 0x9B,
+ 0x6C, 0x43, 0xE2, 0x9E, 0x09, 0x7A, 0x3B, 0x9F, 0x62, 0xA9, 0x50, 0xE8, 0x5E, 0x94, 0x12, 0x44,
+ 0x60, 0x1B, 0x96, 0x89, 0xA8, 0xD6, 0x0B, 0xC3, 0x1A, 0xEF, 0xEF, 0xA9, 0x24, 0x0B, 0xC9, 0xA1,
+ 0x74, 0x50, 0x44, 0xB5, 0xE3, 0xB8, 0xA8, 0x59, 0x25, 0x66, 0xB4, 0xD1, 0x06, 0xE8, 0xE5, 0x36,
+ 0x6A, 0x72, 0x3F, 0x08, 0x56, 0x0D, 0x06, 0xD9, 0x36, 0xAD, 0x24, 0x86, 0xA1, 0x3C, 0x55, 0x81,
+ 0xB1, 0x15, 0x33, 0x85, 0x44, 0xD2, 0x58, 0x0B, 0x7A, 0x4A, 0xB8, 0xB4, 0x8D, 0x62, 0x28, 0x51,
+ 0xAA, 0x74, 0x36, 0x9F, 0xAE, 0x33, 0x8D, 0x90, 0xB2, 0x2E, 0x53, 0x1C, 0xF6, 0xBD, 0x12, 0x87,
+ 0x5D, 0x67, 0x91, 0xBD, 0xD8, 0x69, 0x8D, 0xDF, 0x5C, 0x5E, 0x93, 0x4C, 0x31, 0x6B, 0x67, 0x74,
+ 0x2D, 0x0C, 0xED, 0x9A, 0xCB, 0x11, 0x4C, 0x2A, 0x01, 0xA5, 0xE6, 0x33, 0x5A, 0x08, 0xA0, 0x84,
+ 0x65, 0x4E, 0x27, 0x8C, 0xD3, 0x75, 0x2E, 0x8B, 0x2E, 0xCA, 0x35, 0x28, 0x4B, 0x7D, 0x13, 0x3A,
+ 0xDB, 0x24, 0x31, 0xF0, 0x24, 0xF6, 0xB4, 0x60, 0x06, 0xC4, 0x6D, 0x25, 0x26, 0xEC, 0xFA, 0xF7,
+ 0xEC, 0xEC, 0xC3, 0x49, 0x14, 0x87, 0x9D, 0x33, 0xC1, 0x3E, 0x46, 0x18, 0xA4, 0x0B, 0xF7, 0x2C,
+ 0xF9, 0x7B, 0x82, 0x58, 0x62, 0x29, 0x4F, 0x4C, 0x77, 0x16, 0xD5, 0xAF, 0x0B, 0x28, 0x67, 0x47,
+ 0x63, 0x62, 0xC4, 0x8F, 0x56, 0x22, 0xC0, 0x19, 0x5D, 0x5B, 0xD4, 0xE7, 0xC1, 0xC5, 0xFC, 0x19,
+ 0x42, 0x83, 0xB7, 0xA3, 0xC9, 0x29, 0xAE, 0x0B, 0x14, 0xF9, 0x57, 0x04, 0x8F, 0x43, 0xE8, 0xCE,
+ 0x6E, 0x21, 0xFC, 0x4D, 0xB9, 0x54, 0xAD, 0xEA, 0x39, 0x4D, 0x8E, 0x5B, 0x28, 0xB1, 0x8F, 0xE7,
+ 0xA2, 0xBE, 0x5F, 0xF1, 0xD1, 0x72, 0xFE, 0x2C, 0x41, 0x2D, 0x33, 0x51, 0x6A, 0x85, 0x1D, 0x39,
+ 0xA3, 0x6C, 0x98, 0x1E, 0x64, 0x87, 0x7C, 0x30, 0x18, 0xA0, 0x83, 0x01, 0x4A, 0x84, 0x1A, 0x5C,
+ 0x04, 0x57, 0x2C, 0xB8, 0x39, 0x0E, 0xBE, 0x0F, 0x83, 0xD7, 0x97, 0xB7, 0xA3, 0xC3, 0x3B, 0x8A,
+ 0x1D, 0xB1, 0xEC, 0x71, 0xD2, 0xD1, 0x21, 0xFD, 0x5F, 0xB2, 0x4A, 0x6D, 0x81, 0x26, 0xEF, 0x71,
+ 0x7D, 0x40, 0x14, 0x79, 0x8A, 0xAC, 0xEE, 0x2C, 0xB9, 0x66, 0xAA, 0x5D, 0x5F, 0x65, 0x90, 0x29,
+ 0xDD, 0xF2, 0x7F, 0x24, 0xD0, 0xCD, 0xC3, 0x95, 0xB5, 0x0A, 0x35, 0x43, 0xEB, 0x69, 0xBD, 0xEA,
+ 0xB6, 0x4A, 0x85, 0xD9, 0x28, 0xB6, 0x3E, 0xBD, 0x06, 0x32, 0x1E, 0x8F, 0x90, 0x1C, 0x89, 0xA4,
+ 0x1D, 0x74, 0x24, 0xCD, 0xE8, 0xD1, 0x64, 0x32, 0x9A, 0x3C, 0x64, 0x23, 0xF4, 0xAD, 0x1C, 0xA7,
+ 0x26, 0xEC, 0x77, 0x76, 0xAB, 0xF4, 0x03, 0xB8, 0xCE, 0x7A, 0xDC, 0x34, 0x6A, 0xE5, 0x27, 0x25,
+ 0x74, 0xA3, 0xE2, 0x46, 0x0B, 0x67, 0xC9, 0xBD, 0xFA, 0xC9, 0x0A, 0xFD, 0xAF, 0xFC, 0x27, 0xED,
+ 0xFE, 0x27, 0x1F, 0xE2, 0x05, 0x00, 0x00
+};
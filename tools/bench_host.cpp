@@ -0,0 +1,101 @@
+// Host build of the portable microbenchmarks in Bench.h, for comparing with
+// the numbers the "bench" console command reports on the board.
+//
+//   g++ -O2 -std=gnu++11 -o bench_host tools/bench_host.cpp
+//   ./bench_host [name prefix] [trace | frames.gray [WxH]]
+//
+// A trace is the output of the "range trace" console command, one raw echo
+// (us, 0 for none) per line; the "range" case replays it instead of its
+// built-in one.
+//
+// A .gray file is a sequence of raw 8-bit grayscale frames, 160x120 unless
+// given; the "motion" cases replay it instead of their built-in one. A camera
+// recording converts with e.g.
+//   ffmpeg -i stream.mjpeg -vf scale=160:120,format=gray -f rawvideo frames.gray
+
+#include <stdio.h>
+#include <string.h>
+
+#include "../JsonWriter.h"
+#include "../GeoMath.h"
+#include "../RangeFilter.h"
+#include "../MotionDetect.h"
+#include "../UlpRanging.h"
+#include "../Bench.h"
+
+// Function to print a JSON chunk to stdout
+static
+void stdout_sink(void*, const char* data, size_t len) {
+  fwrite(data, 1, len, stdout);
+}
+
+static uint16_t trace[65536];
+
+// Function to load a recorded trace, returns the readings read
+static
+size_t load_trace(const char* path) {
+  FILE* f = fopen(path, "r");
+  if (!f) {
+    perror(path);
+    return 0;
+  }
+  size_t len = 0;
+  unsigned us;
+  while (len < sizeof(trace) / sizeof(trace[0]) && 1 == fscanf(f, "%u", &us)) {
+    trace[len++] = us;
+  }
+  fclose(f);
+  return len;
+}
+
+// Function to load a recorded frame sequence, returns the frames read
+static
+size_t load_frames(const char* path, uint16_t width, uint16_t height, uint8_t** frames) {
+  *frames = NULL;
+  FILE* f = fopen(path, "rb");
+  if (!f) {
+    perror(path);
+    return 0;
+  }
+  const size_t size = (size_t)width * height;
+  size_t count = 0, cap = 0;
+  for (;;) {
+    if (count == cap) {
+      cap = cap ? cap * 2 : 64;
+      *frames = (uint8_t*)realloc(*frames, cap * size);
+    }
+    if (fread(*frames + count * size, 1, size, f) != size) {
+      break;  // A partial frame at the end is dropped
+    }
+    count++;
+  }
+  fclose(f);
+  return count;
+}
+
+static
+bool ends_with(const char* s, const char* suffix) {
+  const size_t n = strlen(s), m = strlen(suffix);
+  return n >= m && 0 == strcmp(s + n - m, suffix);
+}
+
+int main(int argc, char** argv) {
+  bench_add_portable();
+  if (argc > 2 && ends_with(argv[2], ".gray")) {
+    unsigned width = BENCH_MOTION_W, height = BENCH_MOTION_H;
+    if (argc > 3 && 2 != sscanf(argv[3], "%ux%u", &width, &height)) {
+      fprintf(stderr, "%s: not a frame size\n", argv[3]);
+      return 1;
+    }
+    uint8_t* frames;
+    const size_t count = load_frames(argv[2], width, height, &frames);
+    bench_set_motion_frames(frames, count, width, height);
+  } else if (argc > 2) {
+    bench_set_range_trace(trace, load_trace(argv[2]));
+  }
+
+  char buff[128];
+  JsonWriter json(buff, sizeof(buff), stdout_sink);
+  bench_run(argc > 1 ? argv[1] : NULL, "host", json);
+  return 0;
+}
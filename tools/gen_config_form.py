@@ -0,0 +1,39 @@
+#!/usr/bin/env python3
+"""Compress tools/config_form.html into config_form.h for the config portal.
+
+Usage: python3 tools/gen_config_form.py
+"""
+import gzip
+import os
+
+ROOT = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+SRC = os.path.join(ROOT, "tools", "config_form.html")
+DST = os.path.join(ROOT, "config_form.h")
+
+
+def main():
+    with open(SRC, "rb") as f:
+        html = f.read()
+    # mtime=0 keeps the output stable between runs
+    data = gzip.compress(html, compresslevel=9, mtime=0)
+
+    lines = [
+        "// Generated by tools/gen_config_form.py from tools/config_form.html, do not edit",
+        "",
+        "//File: config_form.html.gz, Size: %d" % len(data),
+        "#define config_form_html_gz_len %d" % len(data),
+        "const uint8_t config_form_html_gz[] = {",
+    ]
+    for i in range(0, len(data), 16):
+        lines.append(" " + ", ".join("0x%02X" % b for b in data[i:i + 16]) + ",")
+    lines[-1] = lines[-1].rstrip(",")
+    lines.append("};")
+    lines.append("")
+
+    with open(DST, "w") as f:
+        f.write("\n".join(lines))
+    print("%s: %d -> %d bytes" % (os.path.basename(DST), len(html), len(data)))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,134 @@
+#!/usr/bin/env python3
+"""Decode the binary log stream written with LOG_OUTPUT_BINARY (see Log.h).
+
+Usage:
+  python3 tools/log_decode.py firmware.elf capture.bin
+  python3 tools/log_decode.py firmware.elf /dev/ttyUSB0 [baud]   (needs pyserial)
+
+Records carry the address of their format string instead of the text; the
+strings are looked up in the loadable sections of the ELF the device runs, so
+it must be the exact build. Bytes outside of records (boot messages, console
+output) are skipped.
+"""
+import re
+import struct
+import sys
+
+SYNC = 0xA5
+HEADER = 11
+RECORD_MAX = 128
+LEVELS = "-EWID"
+SPEC = re.compile(r"%([-+ #0]*)(\d*|\*)(?:\.(\d*))?(hh|h|ll|l|z|j|t)?([diouxXcspfFeEgGaA%])")
+
+
+class Elf:
+    """Minimal ELF32 little-endian reader: maps addresses to section contents."""
+
+    def __init__(self, path):
+        with open(path, "rb") as f:
+            data = f.read()
+        if data[:4] != b"\x7fELF" or data[4] != 1 or data[5] != 1:
+            raise ValueError("%s: not a little-endian ELF32 file" % path)
+        shoff, = struct.unpack_from("<I", data, 0x20)
+        shentsize, shnum = struct.unpack_from("<HH", data, 0x2E)
+        self.sections = []
+        for i in range(shnum):
+            _, sh_type, _, addr, off, size = struct.unpack_from("<IIIIII", data, shoff + i * shentsize)
+            if addr and sh_type == 1:  # SHT_PROGBITS with an address: flash or RAM contents
+                self.sections.append((addr, data[off:off + size]))
+
+    def string(self, addr):
+        for base, blob in self.sections:
+            if base <= addr < base + len(blob):
+                end = blob.find(b"\0", addr - base)
+                return blob[addr - base:end if end >= 0 else len(blob)].decode("utf-8", "replace")
+        return None
+
+
+def format_record(fmt, args):
+    """Apply the format to the packed arguments, taking their sizes from the specs."""
+    out, pos, last = [], 0, 0
+    for m in SPEC.finditer(fmt):
+        out.append(fmt[last:m.start()])
+        last = m.end()
+        flags, width, prec, length, conv = m.groups()
+        if conv == "%":
+            out.append("%")
+            continue
+        spec = "%" + flags + width + ("." + prec if prec is not None else "")
+        if conv == "s":
+            n = args[pos] if pos < len(args) else 0
+            value = args[pos + 1:pos + 1 + n].decode("utf-8", "replace")
+            pos += 1 + n
+        elif conv in "fFeEgGaA":
+            value, = struct.unpack_from("<d", args.ljust(pos + 8, b"\0"), pos)
+            pos += 8
+            conv = "f" if conv in "aA" else conv
+        elif length == "ll":
+            value, = struct.unpack_from("<q" if conv in "di" else "<Q", args.ljust(pos + 8, b"\0"), pos)
+            pos += 8
+        else:
+            value, = struct.unpack_from("<i" if conv in "dic" else "<I", args.ljust(pos + 4, b"\0"), pos)
+            pos += 4
+            if conv == "p":
+                conv = "x"
+            elif conv == "u":
+                conv = "d"
+        out.append((spec + conv) % value)
+    out.append(fmt[last:])
+    return "".join(out)
+
+
+def records(read):
+    """Yield (timestamp, level, format address, argument bytes) from a byte source."""
+    buf = bytearray()
+    while True:
+        chunk = read(4096)
+        if not chunk:
+            return
+        buf += chunk
+        while True:
+            start = buf.find(SYNC)
+            if start < 0:
+                buf.clear()
+                break
+            del buf[:start]
+            if len(buf) < 2:
+                break
+            size = buf[1] + 2
+            if size < HEADER or size > RECORD_MAX:
+                del buf[:1]  # A stray sync byte
+                continue
+            if len(buf) < size:
+                break
+            ts, addr, level = struct.unpack_from("<IIB", buf, 2)
+            yield ts, level, addr, bytes(buf[HEADER:size])
+            del buf[:size]
+
+
+def main(argv):
+    if len(argv) not in (3, 4):
+        print(__doc__.strip())
+        return 1
+    elf = Elf(argv[1])
+    if argv[2].startswith("/dev/"):
+        import serial
+        src = serial.Serial(argv[2], int(argv[3]) if len(argv) == 4 else 115200)
+        read = lambda n: src.read(max(1, min(n, src.in_waiting)))  # Blocks for the next byte
+    else:
+        src = open(argv[2], "rb")
+        read = src.read
+
+    with src:
+        for ts, level, addr, args in records(read):
+            fmt = elf.string(addr)
+            if fmt is None:
+                text = "<unknown format 0x%08x> %s" % (addr, args.hex())
+            else:
+                text = format_record(fmt, args)
+            print("[%u] %s: %s" % (ts, LEVELS[min(level, 4)], text), flush=True)
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main(sys.argv))
@@ -0,0 +1,201 @@
+#!/usr/bin/env python3
+"""Make (and check) delta OTA patches for OTADecoder.h.
+
+Usage:
+  python3 tools/ota_delta.py make  <old.bin> <new.bin> <patch.dlt> [--gzip]
+  python3 tools/ota_delta.py apply <old.bin> <patch.dlt[.gz]> <out.bin>
+
+The patch is served like a normal OTA image. The device picks the decoder
+from the x-OTA-Encoding header ("delta", "gzip", "delta+gzip") or from the
+URL suffix (.dlt, .gz, .dlt.gz). A plain compressed image is just
+"gzip -9 firmware.bin"; for that one also send x-OTA-Size with the size of
+the uncompressed image so flash space is checked before writing (delta
+patches carry the size in their header).
+"""
+import gzip
+import hashlib
+import struct
+import sys
+
+OP_END, OP_COPY, OP_DATA, OP_ADD = 0, 1, 2, 3
+
+BLOCK = 16         # Size of the blocks indexed in the old image
+MIN_COPY = 24      # Shorter matches are cheaper as DATA
+ADD_MIN_SAME = 8   # ADD is kept going while at least this many of every 16 bytes match
+
+
+def varint(n):
+    out = bytearray()
+    while True:
+        b = n & 0x7F
+        n >>= 7
+        if n:
+            out.append(b | 0x80)
+        else:
+            out.append(b)
+            return bytes(out)
+
+
+def read_varint(data, pos):
+    n = shift = 0
+    while True:
+        b = data[pos]
+        pos += 1
+        n |= (b & 0x7F) << shift
+        shift += 7
+        if not b & 0x80:
+            return n, pos
+
+
+def match_len(old, new, o, n):
+    end = min(len(old) - o, len(new) - n)
+    i = 0
+    while i < end and old[o + i] == new[n + i]:
+        i += 1
+    return i
+
+
+def make(old, new):
+    # Index the old image by 16 byte blocks at 4 byte aligned offsets (code is mostly aligned)
+    index = {}
+    for o in range(0, len(old) - BLOCK + 1, 4):
+        index.setdefault(old[o:o + BLOCK], o)
+
+    ops = []
+    literal = bytearray()
+    last = 0  # Where the previous match ended in the old image
+
+    def flush_literal():
+        if literal:
+            ops.append((OP_DATA, bytes(literal)))
+            literal.clear()
+
+    n = 0
+    while n < len(new):
+        # Prefer continuing along the diagonal of the previous match: small edits
+        # shift nothing, so the bytes after them usually line up again
+        best_o, best_len = -1, 0
+        if last < len(old):
+            length = match_len(old, new, last, n)
+            if length >= MIN_COPY:
+                best_o, best_len = last, length
+        if best_len == 0:
+            o = index.get(new[n:n + BLOCK])
+            if o is not None:
+                length = match_len(old, new, o, n)
+                if length >= MIN_COPY:
+                    best_o, best_len = o, length
+
+        if best_len:
+            flush_literal()
+            ops.append((OP_COPY, best_o, best_len))
+            n += best_len
+            last = best_o + best_len
+            continue
+
+        # No exact match: try an ADD along the diagonal (relocated addresses and
+        # constants change a few bytes but keep the rest in place)
+        if last < len(old):
+            end = n
+            while end < len(new) and last + (end - n) < len(old):
+                window = min(16, len(new) - end, len(old) - last - (end - n))
+                o = last + (end - n)
+                same = sum(1 for i in range(window) if old[o + i] == new[end + i])
+                if same < min(ADD_MIN_SAME, window) or match_len(old, new, o, end) >= MIN_COPY:
+                    break
+                end += window
+            if end - n >= BLOCK:
+                flush_literal()
+                diff = bytes((new[n + i] - old[last + i]) & 0xFF for i in range(end - n))
+                ops.append((OP_ADD, last, diff))
+                last += end - n
+                n = end
+                continue
+
+        literal.append(new[n])
+        n += 1
+        last += 1
+    flush_literal()
+
+    out = bytearray(b"DLT1")
+    out += struct.pack("<II", len(old), len(new))
+    out += hashlib.md5(old).digest()
+    for op in ops:
+        out.append(op[0])
+        if op[0] == OP_COPY:
+            out += varint(op[1]) + varint(op[2])
+        elif op[0] == OP_DATA:
+            out += varint(len(op[1])) + op[1]
+        else:
+            out += varint(op[1]) + varint(len(op[2])) + op[2]
+    out.append(OP_END)
+    return bytes(out)
+
+
+def apply(old, patch):
+    if patch[:2] == b"\x1f\x8b":
+        patch = gzip.decompress(patch)
+    if patch[:4] != b"DLT1":
+        raise ValueError("not a delta patch")
+    src_size, dst_size = struct.unpack("<II", patch[4:12])
+    if src_size != len(old) or patch[12:28] != hashlib.md5(old).digest():
+        raise ValueError("patch does not match the old image")
+
+    out = bytearray()
+    pos = 28
+    while True:
+        op = patch[pos]
+        pos += 1
+        if op == OP_END:
+            break
+        if op == OP_COPY:
+            o, pos = read_varint(patch, pos)
+            length, pos = read_varint(patch, pos)
+            out += old[o:o + length]
+        elif op == OP_DATA:
+            length, pos = read_varint(patch, pos)
+            out += patch[pos:pos + length]
+            pos += length
+        elif op == OP_ADD:
+            o, pos = read_varint(patch, pos)
+            length, pos = read_varint(patch, pos)
+            out += bytes((old[o + i] + patch[pos + i]) & 0xFF for i in range(length))
+            pos += length
+        else:
+            raise ValueError("invalid op 0x%02x" % op)
+    if len(out) != dst_size:
+        raise ValueError("patch produced %d bytes, expected %d" % (len(out), dst_size))
+    return bytes(out)
+
+
+def main(argv):
+    if len(argv) >= 5 and argv[1] == "make":
+        with open(argv[2], "rb") as f:
+            old = f.read()
+        with open(argv[3], "rb") as f:
+            new = f.read()
+        patch = make(old, new)
+        # Check the round trip before anything is published
+        assert apply(old, patch) == new
+        if "--gzip" in argv[5:]:
+            # mtime=0 keeps the output stable between runs
+            patch = gzip.compress(patch, compresslevel=9, mtime=0)
+        with open(argv[4], "wb") as f:
+            f.write(patch)
+        print("%s: %d bytes (%.1f%% of %d)"
+              % (argv[4], len(patch), 100.0 * len(patch) / len(new), len(new)))
+    elif len(argv) == 5 and argv[1] == "apply":
+        with open(argv[2], "rb") as f:
+            old = f.read()
+        with open(argv[3], "rb") as f:
+            patch = f.read()
+        with open(argv[4], "wb") as f:
+            f.write(apply(old, patch))
+    else:
+        print(__doc__.strip())
+        return 1
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main(sys.argv))
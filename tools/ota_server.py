@@ -0,0 +1,133 @@
+#!/usr/bin/env python3
+"""Local stand-in for the OTA download server, for testing updates on the bench.
+
+Usage:
+  python3 tools/ota_server.py <dir> [--port 8080] [--base old.bin] [--drop-after N]
+                              [--stall-after N] [--no-range]
+
+Serves the files of <dir> with the headers the device uses: Content-Length,
+ETag, x-MD5 and x-SHA256 (of the decoded image), x-OTA-Encoding and
+x-OTA-Size, and honours "Range: bytes=N-" requests with 206 responses.
+
+Fault injection, to exercise the resume logic:
+  --drop-after N   close the connection after sending N bytes of each response
+  --stall-after N  stop sending (but keep the connection) after N bytes
+  --no-range       ignore Range requests, like a server that cannot resume
+
+Then start the update from the device console:
+  ota start http://<host>:8080/firmware.bin
+"""
+import argparse
+import gzip
+import hashlib
+import http.server
+import os
+import re
+import socketserver
+import sys
+import time
+
+sys.path.insert(0, os.path.dirname(os.path.abspath(__file__)))
+import ota_delta  # noqa: E402
+
+ARGS = None
+
+
+def encoding_of(name):
+    enc = []
+    if name.endswith(".gz"):
+        name = name[:-3]
+        enc.append("gzip")
+    if name.endswith(".dlt"):
+        enc.insert(0, "delta")
+    return "+".join(enc) or "raw"
+
+
+def decoded_image(name, data):
+    """The image the device ends up with, for the digest headers."""
+    if name.endswith(".gz"):
+        data = gzip.decompress(data)
+        name = name[:-3]
+    if name.endswith(".dlt"):
+        base = os.path.join(ARGS.dir, ARGS.base) if ARGS.base else None
+        if not base or not os.path.exists(base):
+            return None
+        with open(base, "rb") as f:
+            data = ota_delta.apply(f.read(), data)
+    return data
+
+
+class Handler(http.server.BaseHTTPRequestHandler):
+    protocol_version = "HTTP/1.1"
+
+    def do_GET(self):
+        name = os.path.basename(self.path.split("?")[0])
+        path = os.path.join(ARGS.dir, name)
+        if not name or not os.path.isfile(path):
+            self.send_error(404)
+            return
+        with open(path, "rb") as f:
+            data = f.read()
+
+        etag = '"%s"' % hashlib.md5(data).hexdigest()
+        start = 0
+        m = re.match(r"bytes=(\d+)-$", self.headers.get("Range", ""))
+        if m and not ARGS.no_range:
+            if_range = self.headers.get("If-Range")
+            if not if_range or if_range == etag:
+                start = int(m.group(1))
+        if start >= len(data) and start:
+            self.send_error(416)
+            return
+
+        self.send_response(206 if start else 200)
+        self.send_header("Content-Type", "application/octet-stream")
+        self.send_header("Content-Length", str(len(data) - start))
+        self.send_header("ETag", etag)
+        self.send_header("Accept-Ranges", "none" if ARGS.no_range else "bytes")
+        if start:
+            self.send_header("Content-Range", "bytes %d-%d/%d" % (start, len(data) - 1, len(data)))
+        self.send_header("x-OTA-Encoding", encoding_of(name))
+        image = decoded_image(name, data)
+        if image is not None:
+            self.send_header("x-OTA-Size", str(len(image)))
+            self.send_header("x-MD5", hashlib.md5(image).hexdigest())
+            self.send_header("x-SHA256", hashlib.sha256(image).hexdigest())
+        self.end_headers()
+
+        body = data[start:]
+        limit = ARGS.drop_after or ARGS.stall_after or len(body)
+        self.wfile.write(body[:limit])
+        self.wfile.flush()
+        if limit < len(body):
+            self.log_message("fault injected after %d bytes", limit)
+            if ARGS.stall_after:
+                time.sleep(60)
+            self.close_connection = True
+
+
+class Server(socketserver.ThreadingMixIn, http.server.HTTPServer):
+    daemon_threads = True
+
+
+def main():
+    global ARGS
+    parser = argparse.ArgumentParser(description="Local OTA test server")
+    parser.add_argument("dir", help="directory with the images")
+    parser.add_argument("--port", type=int, default=8080)
+    parser.add_argument("--base", help="image running on the device, to compute the digests of .dlt patches")
+    parser.add_argument("--drop-after", type=int, default=0)
+    parser.add_argument("--stall-after", type=int, default=0)
+    parser.add_argument("--no-range", action="store_true")
+    ARGS = parser.parse_args()
+
+    server = Server(("", ARGS.port), Handler)
+    print("Serving %s on port %d" % (ARGS.dir, ARGS.port))
+    try:
+        server.serve_forever()
+    except KeyboardInterrupt:
+        pass
+
+
+if __name__ == "__main__":
+    main()
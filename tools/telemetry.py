@@ -0,0 +1,192 @@
+#!/usr/bin/env python3
+"""Decode and plot the binary telemetry stream (see Telemetry.h).
+
+Usage:
+  python3 tools/telemetry.py tcp://192.168.1.50:7000 [--csv | --plot]
+  python3 tools/telemetry.py /dev/ttyUSB0 [baud] [--csv | --plot]   (needs pyserial)
+  python3 tools/telemetry.py capture.bin [--csv | --plot]
+
+Frames are COBS-encoded records with a CRC-8, each ended by a 0x00 byte.
+Frames that fail the CRC (text log on the same serial port, a partial frame
+at the start) are skipped. Gaps in the sequence numbers are reported as
+dropped records. --csv prints one line per record, --plot shows distance,
+raw echo and servo angle live (needs matplotlib); the default is a summary.
+"""
+import socket
+import struct
+import sys
+
+RECORD = struct.Struct("<IHBBHHBBBB")
+FIELDS = ("us", "seq", "kind", "box", "echo_us", "distance_mm", "flags", "confidence", "angle", "state")
+KINDS = ("range", "servo", "lock")
+STATES = ("disabled", "locked", "unlocking", "unlocked", "open", "relocking")
+FLAGS = ((1, "valid"), (2, "no-echo"), (4, "out-of-range"), (8, "outlier"))
+
+
+def crc8(data):
+    crc = 0
+    for b in data:
+        crc ^= b
+        for _ in range(8):
+            crc = ((crc << 1) ^ 0x07) & 0xFF if crc & 0x80 else (crc << 1) & 0xFF
+    return crc
+
+
+def cobs_decode(frame):
+    """Undo the COBS encoding of one frame (without its 0x00 delimiter), None if malformed."""
+    out, i = bytearray(), 0
+    while i < len(frame):
+        code = frame[i]
+        if code == 0 or i + code > len(frame):
+            return None
+        out += frame[i + 1:i + code]
+        i += code
+        if code < 0xFF and i < len(frame):
+            out.append(0)
+    return bytes(out)
+
+
+class Decoder:
+    """Turns a byte stream into records, counting bad frames and dropped records."""
+
+    def __init__(self):
+        self.buf = bytearray()
+        self.bad = 0
+        self.dropped = 0
+        self.records = 0
+        self.last_seq = None
+
+    def feed(self, data):
+        self.buf += data
+        while True:
+            end = self.buf.find(0)
+            if end < 0:
+                return
+            frame, self.buf = bytes(self.buf[:end]), self.buf[end + 1:]
+            if not frame:
+                continue  # Delimiter starting a batch
+            raw = cobs_decode(frame)
+            if raw is None or len(raw) != RECORD.size + 1 or crc8(raw[:-1]) != raw[-1]:
+                self.bad += 1
+                continue
+            rec = dict(zip(FIELDS, RECORD.unpack(raw[:-1])))
+            if self.last_seq is not None:
+                self.dropped += (rec["seq"] - self.last_seq - 1) & 0xFFFF
+            self.last_seq = rec["seq"]
+            self.records += 1
+            yield rec
+
+
+def open_source(args):
+    """Return a function reading the next chunk of the stream (b"" at the end)."""
+    src = args[0]
+    if src.startswith("tcp://"):
+        host, _, port = src[6:].partition(":")
+        sock = socket.create_connection((host, int(port or 7000)))
+        return lambda: sock.recv(4096)
+    if src.startswith("/dev/") or src.upper().startswith("COM"):
+        import serial  # pyserial
+        baud = int(args[1]) if len(args) > 1 else 115200
+        port = serial.Serial(src, baud, timeout=0.1)
+
+        def read():
+            while True:
+                data = port.read(4096)
+                if data:
+                    return data
+        return read
+    f = open(src, "rb")
+    return lambda: f.read(4096)
+
+
+def describe_flags(flags):
+    return "|".join(name for bit, name in FLAGS if flags & bit) or "-"
+
+
+def run_csv(read, dec):
+    print(",".join(FIELDS))
+    while True:
+        data = read()
+        if not data:
+            break
+        for r in dec.feed(data):
+            r = dict(r, kind=KINDS[r["kind"]] if r["kind"] < len(KINDS) else r["kind"],
+                     state=STATES[r["state"]] if r["state"] < len(STATES) else r["state"],
+                     flags=describe_flags(r["flags"]))
+            print(",".join(str(r[k]) for k in FIELDS))
+
+
+def run_summary(read, dec):
+    first = last = None
+    kinds = [0] * len(KINDS)
+    try:
+        while True:
+            data = read()
+            if not data:
+                break
+            for r in dec.feed(data):
+                first = r["us"] if first is None else first
+                last = r["us"]
+                if r["kind"] < len(KINDS):
+                    kinds[r["kind"]] += 1
+    except KeyboardInterrupt:
+        pass
+    secs = ((last - first) & 0xFFFFFFFF) / 1e6 if first is not None else 0
+    print("%d records in %.2f s (%.0f/s), %d dropped, %d bad frames"
+          % (dec.records, secs, dec.records / secs if secs else 0, dec.dropped, dec.bad))
+    for name, n in zip(KINDS, kinds):
+        print("  %-6s %d" % (name, n))
+
+
+def run_plot(read, dec, window=2000):
+    import collections
+    import matplotlib.pyplot as plt
+
+    t, dist, echo, angle = (collections.deque(maxlen=window) for _ in range(4))
+    fig, (ax_d, ax_a) = plt.subplots(2, 1, sharex=True)
+    line_d, = ax_d.plot([], [], label="filtered (cm)")
+    line_e, = ax_d.plot([], [], ".", markersize=2, label="raw (cm)")
+    line_a, = ax_a.plot([], [], label="servo angle")
+    ax_d.legend(loc="upper right")
+    ax_a.legend(loc="upper right")
+    plt.ion()
+    plt.show()
+    while plt.fignum_exists(fig.number):
+        data = read()
+        if not data:
+            break
+        for r in dec.feed(data):
+            t.append(r["us"] / 1e6)
+            dist.append(r["distance_mm"] / 10)
+            echo.append(r["echo_us"] * 0.0343 / 2 if r["kind"] == 0 and r["echo_us"] else float("nan"))
+            angle.append(r["angle"])
+        line_d.set_data(t, dist)
+        line_e.set_data(t, echo)
+        line_a.set_data(t, angle)
+        for ax in (ax_d, ax_a):
+            ax.relim()
+            ax.autoscale_view()
+        plt.pause(0.05)
+
+
+def main(argv):
+    args = [a for a in argv[1:] if not a.startswith("--")]
+    if not args:
+        sys.exit(__doc__)
+    read = open_source(args)
+    dec = Decoder()
+    try:
+        if "--csv" in argv:
+            run_csv(read, dec)
+        elif "--plot" in argv:
+            run_plot(read, dec)
+        else:
+            run_summary(read, dec)
+    except KeyboardInterrupt:
+        pass
+    if "--csv" in argv or "--plot" in argv:
+        sys.stderr.write("%d records, %d dropped, %d bad frames\n" % (dec.records, dec.dropped, dec.bad))
+
+
+if __name__ == "__main__":
+    main(sys.argv)
@@ -0,0 +1,64 @@
+#!/usr/bin/env python3
+"""Convert the output of the "trace" console command to Chrome trace JSON.
+
+Usage:
+  python3 tools/trace2chrome.py trace.txt > trace.json
+
+Open the result in chrome://tracing or https://ui.perfetto.dev. Each core is
+shown as a thread; state transitions are instant events named after the state.
+Lines that are not trace events (prompts, log output) are skipped.
+"""
+import json
+import re
+import sys
+
+# Must follow the State enum in BlynkState.h
+STATES = [
+    "WAIT_CONFIG", "CONFIGURING", "CONNECTING_NET", "CONNECTING_CLOUD", "RUNNING",
+    "OTA_UPGRADE", "SWITCH_TO_STA", "RESET_CONFIG", "ERROR",
+]
+
+LINE = re.compile(r"^\s*(\d+) (\d+) ([BEi]) (\S+) (\d+)\s*$")
+
+
+def convert(lines):
+    events = []
+    last = {}   # Last raw timestamp per core, to undo the 32-bit wrap
+    base = {}
+    for line in lines:
+        m = LINE.match(line)
+        if not m:
+            continue
+        core, ts, phase, name, arg = int(m.group(1)), int(m.group(2)), m.group(3), m.group(4), int(m.group(5))
+        # Events of different tasks may land slightly out of order, so only a big step back is a wrap
+        if core in last and last[core] - ts > (1 << 31):
+            base[core] = base.get(core, 0) + (1 << 32)
+        last[core] = ts
+        ts += base.get(core, 0)
+
+        ev = {"name": name, "ph": phase, "ts": ts, "pid": 0, "tid": core}
+        if name == "state":
+            ev["name"] = "state:" + (STATES[arg] if arg < len(STATES) else str(arg))
+        if phase == "i":
+            ev["s"] = "g" if name == "state" else "t"
+        ev["args"] = {"arg": arg}
+        events.append(ev)
+
+    events.sort(key=lambda e: e["ts"])
+    meta = [{"name": "thread_name", "ph": "M", "pid": 0, "tid": core, "args": {"name": "core %d" % core}}
+            for core in sorted(last)]
+    return {"traceEvents": meta + events, "displayTimeUnit": "ms"}
+
+
+def main(argv):
+    if len(argv) > 2:
+        print(__doc__.strip())
+        return 1
+    with (open(argv[1]) if len(argv) == 2 else sys.stdin) as f:
+        json.dump(convert(f), sys.stdout, indent=1)
+    sys.stdout.write("\n")
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main(sys.argv))